@@ -45,11 +45,11 @@ namespace cpl
 		{
 			auto& tm = get();
 
+			std::lock_guard<std::mutex> lock(globalMutex);
+
 			if (tm.beingDestroyed)
 				throw std::runtime_error("cannot start threads at destruction");
 
-			std::lock_guard<std::mutex> lock(globalMutex);
-
 			auto id = thread.get_id();
 
 			tm.threads[id] = std::move(thread);
@@ -63,7 +63,8 @@ namespace cpl
 				{
 					std::lock_guard<std::mutex> lock(globalMutex);
 
-					if (tm.threads.find(id) != tm.threads.end())
+					// the destructor owns (and joins) every thread once it has taken the map.
+					if (tm.beingDestroyed || tm.threads.find(id) != tm.threads.end())
 						return;
 				}
 
@@ -99,11 +100,19 @@ namespace cpl
 
 		~ThreadManager() noexcept(false)
 		{
-			beingDestroyed = true;
-
 			janitorThreads();
 
-			for (auto it = threads.begin(); it != threads.end(); ++it)
+			// take the remaining threads out of the map first, so a thread ending meanwhile
+			// can't have the janitor join it a second time below.
+			std::map<std::thread::id, std::thread> remaining;
+
+			{
+				std::lock_guard<std::mutex> lock(globalMutex);
+				beingDestroyed = true;
+				remaining.swap(threads);
+			}
+
+			for (auto it = remaining.begin(); it != remaining.end(); ++it)
 			{
 				if (it->second.joinable())
 					it->second.join();
@@ -39,14 +39,25 @@
 #include "AtomicCompability.h"
 #include "ConcurrentServices.h"
 #include "lib/BlockingLockFreeQueue.h"
+#include "lib/LockFreeSlabRing.h"
 #include "lib/CLIFOStream.h"
+#include "lib/LatencyHistogram.h"
+#include "simd/simd_interleave.h"
 #include "CProcessorTimer.h"
+#include "JobSystem.h"
+#include "RealtimeGuard.h"
 #include <deque>
 #include <algorithm>
 #include <numeric>
 #include "Protected.h"
 #include <variant>
 #include <functional>
+#include <limits>
+#include <array>
+#include <atomic>
+#include <utility>
+#include <ostream>
+#include <sstream>
 
 namespace cpl
 {
@@ -91,13 +102,13 @@ namespace cpl
 			static_assert(PacketSize > data_alignment + sizeof(T), "Audio packet cannot hold a single element");
 
 			AudioPacket(PackingType channelConfiguration, std::uint8_t numChannels, std::uint16_t elementsUsed)
-				: size(elementsUsed), channels(numChannels), packing(channelConfiguration)
+				: size(elementsUsed), channels(numChannels), packing(channelConfiguration), stamp()
 			{
 				static_assert(sizeof(AudioPacket) == PacketSize, "Wrong packing");
 			}
 
 			AudioPacket(AudioPacket&& other)
-				: size(other.size), channels(other.channels), packing(other.packing)
+				: size(other.size), channels(other.channels), packing(other.packing), stamp(other.stamp)
 			{
 				std::memcpy(buffer, other.buffer, getTotalSamples() * sizeof(T));
 			}
@@ -120,6 +131,12 @@ namespace cpl
 			constexpr const T* end() const noexcept { return buffer + size; }
 			constexpr PackingType packingType() const noexcept { return packing; }
 
+			/// <summary>
+			/// See <see cref="AudioStream::currentStamp()"/>
+			/// </summary>
+			std::uint32_t getStamp() const noexcept { return stamp; }
+			void setStamp(std::uint32_t newStamp) noexcept { stamp = newStamp; }
+
 		private:
 
 			static constexpr std::uint32_t capacity = (PacketSize - data_alignment) / element_size;
@@ -130,10 +147,27 @@ namespace cpl
 			std::uint16_t size;
 			std::uint8_t channels;
 			PackingType packing;
+			// fits in the padding before the buffer.
+			std::uint32_t stamp;
 
 			alignas(data_alignment) T buffer[capacity];
 		};
 
+		typedef CLockFreeSlabRing<T, 32> SlabRing;
+
+		/// <summary>
+		/// A variable-sized block of audio living in the stream's slab ring,
+		/// read in place by the consumer and then released back to the producer.
+		/// Always laid out as AudioPacketSeparate.
+		/// </summary>
+		struct AudioSlab
+		{
+			typename SlabRing::Slab slab;
+			std::uint32_t frames;
+			std::uint8_t channels;
+			std::uint32_t stamp;
+		};
+
 		struct ArrangementData
 		{
 #ifdef CPL_JUCE
@@ -229,7 +263,13 @@ namespace cpl
 				/// If not, samples will instead get queued up for insertion into the history
 				/// buffers
 				/// </summary>
-				blockOnHistoryBuffer {};
+				blockOnHistoryBuffer {},
+				/// <summary>
+				/// If set, each processed block of audio is published once as an immutable <see cref="AudioEpoch"/>,
+				/// and listeners receive it concurrently on the shared JobSystem through <see cref="Listener::onStreamEpoch"/>.
+				/// Property changes are still delivered serially.
+				/// </summary>
+				concurrentListeners {};
 		};
 
 		/// <summary>
@@ -244,7 +284,7 @@ namespace cpl
 
 	private:
 
-		typedef std::variant<ProducerInfo, AudioPacket, ArrangementData, TransportData, ChannelNameData> ProducerFrame;
+		typedef std::variant<ProducerInfo, AudioPacket, AudioSlab, ArrangementData, TransportData, ChannelNameData> ProducerFrame;
 		static_assert(std::is_move_constructible_v<ProducerFrame> && std::is_move_assignable_v<ProducerFrame>);
 
 		struct ChannelMatrix
@@ -275,20 +315,79 @@ namespace cpl
 
 			void insertFrameIntoBuffer(const AudioPacket & frame)
 			{
-				const auto numSamples = frame.getNumFrames();
-				const auto numChannels = frame.getChannelCount();
+				insertFrameIntoBuffer(frame.begin(), frame.getChannelCount(), frame.getNumFrames(), frame.packingType());
+			}
+
+			void insertFrameIntoBuffer(const AudioSlab& frame)
+			{
+				insertFrameIntoBuffer(frame.slab.data, frame.channels, frame.frames, AudioPacket::PackingType::AudioPacketSeparate);
+			}
+
+			void insertFrameIntoBuffer(const T* source, std::size_t numChannels, std::size_t numSamples, typename AudioPacket::PackingType packing)
+			{
+				ensureSize(numChannels, numSamples + containedSamples);
+				appendFrame(source, numChannels, numSamples, packing);
+			}
+
+			/// <summary>
+			/// If the frame holds audio, returns true and its layout.
+			/// </summary>
+			static bool getAudioLayout(const ProducerFrame& frame, std::size_t& numChannels, std::size_t& numSamples) noexcept
+			{
+				if (const auto* audio = std::get_if<AudioPacket>(&frame))
+				{
+					numChannels = audio->getChannelCount();
+					numSamples = audio->getNumFrames();
+					return true;
+				}
+				else if (const auto* slab = std::get_if<AudioSlab>(&frame))
+				{
+					numChannels = slab->channels;
+					numSamples = slab->frames;
+					return true;
+				}
 
+				return false;
+			}
+
+			/// <summary>
+			/// Appends a run of audio frames sharing numChannels, together holding numSamples,
+			/// sizing the buffers only once for the whole run.
+			/// </summary>
+			void insertFramesIntoBuffer(const ProducerFrame* frames, std::size_t numFrames, std::size_t numChannels, std::size_t numSamples)
+			{
 				ensureSize(numChannels, numSamples + containedSamples);
 
-				switch (frame.packingType())
+				for (std::size_t f = 0; f < numFrames; ++f)
+				{
+					if (const auto* audio = std::get_if<AudioPacket>(frames + f))
+						appendFrame(audio->begin(), numChannels, audio->getNumFrames(), audio->packingType());
+					else if (const auto* slab = std::get_if<AudioSlab>(frames + f))
+						appendFrame(slab->slab.data, numChannels, slab->frames, AudioPacket::PackingType::AudioPacketSeparate);
+				}
+			}
+
+			std::vector<T*> pointer;
+			std::size_t containedSamples = 0;
+			// TODO: Linearize
+			std::vector<std::vector<T>> buffer;
+
+		private:
+
+			/// <summary>
+			/// Copies the frame in after the contained samples, which must already have room.
+			/// </summary>
+			void appendFrame(const T* source, std::size_t numChannels, std::size_t numSamples, typename AudioPacket::PackingType packing)
+			{
+				switch (packing)
 				{
 				case AudioPacket::PackingType::AudioPacketSeparate:
 				{
 					for (std::size_t c = 0; c < numChannels; ++c)
 					{
 						std::memcpy(
-							buffer[c].data() + containedSamples,
-							frame.begin() + c * numSamples,
+							pointer[c] + containedSamples,
+							source + c * numSamples,
 							numSamples * sizeof(T)
 						);
 					}
@@ -298,25 +397,13 @@ namespace cpl
 
 				case AudioPacket::PackingType::AudioPacketInterleaved:
 				{
-					for (std::size_t c = 0; c < numChannels; ++c)
-					{
-						for (std::size_t n = 0; n < numSamples; ++n)
-						{
-							buffer[c][n + containedSamples] = *(frame.begin() + n * numChannels + c);
-						}
-					}
-
+					simd::deinterleave(source, numChannels, numSamples, pointer.data(), containedSamples);
 					break;
 				}
 				}
 
 				containedSamples += numSamples;
 			}
-
-			std::vector<T*> pointer;
-			std::size_t containedSamples = 0;
-			// TODO: Linearize
-			std::vector<std::vector<T>> buffer;
 		};
 
 	public:
@@ -336,6 +423,61 @@ namespace cpl
 			std::uint64_t droppedFrames;
 		};
 
+		typedef CLatencyHistogram<> LatencyHistogram;
+
+		/// <summary>
+		/// Latency distributions of the stream, in processor clocks.
+		/// Recorded wait-free, and can be snapshotted from any thread.
+		/// </summary>
+		struct Telemetry
+		{
+			/// <summary>
+			/// Time spent in Input::processIncomingRTAudio()
+			/// </summary>
+			typename LatencyHistogram::Snapshot producerCost;
+			/// <summary>
+			/// Time audio frames spend in the fifo of an async stream.
+			/// </summary>
+			typename LatencyHistogram::Snapshot queueResidency;
+			/// <summary>
+			/// Time the consumer spends merging and publishing a block, excluding listeners.
+			/// </summary>
+			typename LatencyHistogram::Snapshot consumerMerge;
+			/// <summary>
+			/// Time spent in each audio callback of every listener.
+			/// </summary>
+			typename LatencyHistogram::Snapshot listenerCallback;
+			std::uint64_t droppedFrames;
+
+			/// <summary>
+			/// Writes the telemetry as a JSON object, with times converted to microseconds
+			/// (or left as clocks, if the processor frequency is unknown).
+			/// </summary>
+			void writeJson(std::ostream& stream) const
+			{
+				const double mhz = cpl::system::CProcessor::getMHz();
+				const bool knownFrequency = std::isnormal(mhz);
+				const double microsecondsPerClock = knownFrequency ? 1.0 / mhz : 1.0;
+
+				stream << "{\"unit\":" << (knownFrequency ? "\"us\"" : "\"clocks\"") << ",\"producerCost\":";
+				producerCost.writeJson(stream, microsecondsPerClock);
+				stream << ",\"queueResidency\":";
+				queueResidency.writeJson(stream, microsecondsPerClock);
+				stream << ",\"consumerMerge\":";
+				consumerMerge.writeJson(stream, microsecondsPerClock);
+				stream << ",\"listenerCallback\":";
+				listenerCallback.writeJson(stream, microsecondsPerClock);
+				stream << ",\"droppedFrames\":" << droppedFrames << "}";
+			}
+
+			std::string toJson() const
+			{
+				std::ostringstream stream;
+				writeJson(stream);
+				return stream.str();
+			}
+		};
+
 		static const std::size_t packetSize = PacketSize;
 		static const std::size_t storageAlignment = 32;
 
@@ -374,6 +516,26 @@ namespace cpl
 
 			static Playhead empty() { return{}; }
 
+			/// <summary>
+			/// Setters for producing playheads without a host, e.g. when replaying a recorded session.
+			/// </summary>
+			void setSampleRate(double newSampleRate) noexcept { sampleRate = newSampleRate; }
+
+			void setTransport(std::int64_t positionInSamples, bool playing, bool looping = false, bool recording = false) noexcept
+			{
+				transport.samplePosition = positionInSamples;
+				transport.isPlaying = playing;
+				transport.isLooping = looping;
+				transport.isRecording = recording;
+			}
+
+			void setArrangement(double beatsPerMinute, std::pair<int, int> signature) noexcept
+			{
+				arrangement.beatsPerMinute = beatsPerMinute;
+				arrangement.signatureNumerator = static_cast<std::uint16_t>(signature.first);
+				arrangement.signatureDenominator = static_cast<std::uint16_t>(signature.second);
+			}
+
 			void copyVolatileData(const Playhead& other)
 			{
 				sampleRate = other.sampleRate;
@@ -390,15 +552,101 @@ namespace cpl
 			std::uint64_t steadyClock = 0;
 		};
 
+		/// <summary>
+		/// An immutable, reference counted block of processed audio shared by all listeners.
+		/// Listeners are free to retain it after the callback; the stream reuses it once every reference is gone.
+		/// </summary>
+		class AudioEpoch
+		{
+			friend class AudioStream<T, PacketSize>;
+		public:
+
+			const T* const* getChannels() const noexcept { return pointers.data(); }
+			const T* getChannel(std::size_t channel) const { return pointers.at(channel); }
+			std::size_t getNumChannels() const noexcept { return pointers.size(); }
+			std::size_t getNumSamples() const noexcept { return samples; }
+			/// <summary>
+			/// The playhead at the start of this block.
+			/// </summary>
+			const Playhead& getPlayhead() const noexcept { return playhead; }
+			const AudioStreamInfo& getInfo() const noexcept { return info; }
+			/// <summary>
+			/// Monotonically increasing for every epoch published by a stream.
+			/// </summary>
+			std::uint64_t getSequence() const noexcept { return sequence; }
+
+		private:
+
+			void assign(const ChannelMatrix& matrix, const Playhead& ph, const AudioStreamInfo& streamInfo, std::uint64_t sequenceNumber)
+			{
+				const auto channels = matrix.buffer.size();
+
+				samples = matrix.containedSamples;
+				buffer.resize(channels);
+				pointers.resize(channels);
+
+				for (std::size_t c = 0; c < channels; ++c)
+				{
+					buffer[c].assign(matrix.buffer[c].begin(), matrix.buffer[c].begin() + samples);
+					pointers[c] = buffer[c].data();
+				}
+
+				playhead = ph;
+				info = streamInfo;
+				sequence = sequenceNumber;
+			}
+
+			std::vector<std::vector<T>> buffer;
+			std::vector<const T*> pointers;
+			std::size_t samples = 0;
+			Playhead playhead;
+			AudioStreamInfo info;
+			std::uint64_t sequence = 0;
+		};
+
 		/// <summary>
 		/// When you iterate over a audio buffer using ended iterators,
 		/// there will be this number of iterator iterations.
 		/// </summary>
 		static const std::size_t bufferIndices = AudioBuffer::IteratorBase::iterator_indices;
 		/// <summary>
-		/// Provides a constant view of the internal audio buffers, synchronized.
+		/// Keeps a history snapshot from being reused by the writer, while alive.
+		/// Adopts an already incremented reader count.
+		/// </summary>
+		class HistoryPin
+		{
+		public:
+			explicit HistoryPin(std::atomic<int>& pinnedReaders) noexcept : readers(&pinnedReaders) {}
+			HistoryPin(HistoryPin&& other) noexcept : readers(std::exchange(other.readers, nullptr)) {}
+
+			HistoryPin& operator = (HistoryPin&& other) noexcept
+			{
+				release();
+				readers = std::exchange(other.readers, nullptr);
+				return *this;
+			}
+
+			~HistoryPin() { release(); }
+
+		private:
+
+			void release() noexcept
+			{
+				if (readers)
+					readers->fetch_sub(1, std::memory_order_release);
+
+				readers = nullptr;
+			}
+
+			std::atomic<int>* readers;
+		};
+
+		/// <summary>
+		/// Provides a constant view of a consistent snapshot of the internal audio buffers.
 		/// The interface is built on RAII, the data is valid as long as this struct is in scope.
 		/// Same principle for AudioBufferViews.
+		/// Holding it never blocks the stream, but holding on to several at once may cause it to defer
+		/// history updates (see <see cref="ConsumerInfo::blockOnHistoryBuffer"/>).
 		/// </summary>
 		struct AudioBufferAccess
 		{
@@ -407,8 +655,8 @@ namespace cpl
 			typedef typename AudioBuffer::IteratorBase::iterator iterator;
 			typedef typename AudioBuffer::IteratorBase::const_iterator const_iterator;
 
-			AudioBufferAccess(std::unique_lock<std::mutex>&& l, const std::vector<AudioBuffer>& audioChannels, const Playhead& ph, const AudioStreamInfo& info)
-				: lock(std::move(l)), audioChannels(audioChannels), playhead(ph), info(info)
+			AudioBufferAccess(HistoryPin&& p, const std::vector<AudioBuffer>& audioChannels, const Playhead& ph, const AudioStreamInfo& info)
+				: pin(std::move(p)), audioChannels(audioChannels), playhead(ph), info(info)
 			{
 
 			}
@@ -469,7 +717,7 @@ namespace cpl
 			const Playhead& playhead;
 			const AudioStreamInfo& info;
 			const std::vector<AudioBuffer>& audioChannels;
-			std::unique_lock<std::mutex> lock;
+			HistoryPin pin;
 		};
 
 		using BufferAccess = AudioBufferAccess;
@@ -522,6 +770,16 @@ namespace cpl
 			/// </summary>
 			virtual void onStreamAudio(ListenerContext& source, T ** buffer, std::size_t numChannels, std::size_t numSamples) { }
 			/// <summary>
+			/// Called instead of onStreamAudio if <see cref="ConsumerInfo::concurrentListeners"/> is set,
+			/// possibly on another thread and concurrently with other listeners. Only const members of
+			/// the context, and getAudioBufferViews(), are safe to use here.
+			/// The default implementation forwards to onStreamAudio, which then must not modify the buffers.
+			/// </summary>
+			virtual void onStreamEpoch(ListenerContext& source, const std::shared_ptr<const AudioEpoch>& epoch)
+			{
+				onStreamAudio(source, const_cast<T**>(epoch->getChannels()), epoch->getNumChannels(), epoch->getNumSamples());
+			}
+			/// <summary>
 			/// Called when the current source being listened to died.
 			/// You're not required to remove yourself as a listener.
 			/// While you can obtain buffer views here, it's undefined behaviour to let them escape this callback.
@@ -607,13 +865,11 @@ namespace cpl
 			/// <summary>
 			/// Returns a view of the audio history for all channels the last N samples (see setAudioHistorySize)
 			/// References are only guaranteed to be valid while AudioBufferAccess is in scope.
-			/// May acquire a lock in the returned class, so don't call it from real-time threads.
-			///
-			/// Ensures exclusive access while it is hold.
+			/// Lock-free, the view is a snapshot that isn't modified while it is held.
 			/// </summary>
 			AudioBufferAccess getAudioBufferViews()
 			{
-				return { std::unique_lock<std::mutex>(aBufferMutex), audioHistoryBuffers, bufferPlayhead, bufferInfo };
+				return accessLatestHistory();
 			}
 
 			/// <summary>
@@ -629,6 +885,23 @@ namespace cpl
 				consumerInfoChange = true;
 			}
 
+			/// <summary>
+			/// Safe to call from any thread, doesn't interrupt the stream.
+			/// </summary>
+			Telemetry getTelemetry() const
+			{
+				auto& histograms = this->stream->histograms;
+
+				Telemetry ret;
+				ret.producerCost = histograms.producerCost.snapshot();
+				ret.queueResidency = histograms.queueResidency.snapshot();
+				ret.consumerMerge = histograms.consumerMerge.snapshot();
+				ret.listenerCallback = histograms.listenerCallback.snapshot();
+				ret.droppedFrames = this->stream->droppedFrames;
+
+				return ret;
+			}
+
 			PerformanceMeasurements getPerfMeasures() const noexcept
 			{
 				PerformanceMeasurements measures;
@@ -671,9 +944,37 @@ namespace cpl
 
 			void beginFrameProcessing();
 			void handleFrame(ProducerFrame&& frame);
+			void handleFrames(ProducerFrame* frames, std::size_t count);
 			void endFrameProcessing();
-			void ensureAudioHistoryStorage(std::size_t channels, std::size_t pSize, std::size_t pCapacity, const std::lock_guard<std::mutex>&);
-			void mergeInputToBuffer(const std::unique_lock<std::mutex>&, ChannelMatrix* realInputs, const Playhead& playheadToAssign, const AudioStreamInfo& infoToAssign);
+			/// <summary>
+			/// A complete copy of the audio history. Readers pin the latest one, while the writer
+			/// only ever modifies an unpinned, unpublished one, that is first brought up to date.
+			/// This costs historySnapshotCount times the memory of one history, and every publish copies
+			/// the samples the target is missing, on top of the new ones. A single reader never stalls
+			/// the writer, but readers holding on to both older snapshots do, if blockOnHistoryBuffer is set.
+			/// </summary>
+			struct HistorySnapshot
+			{
+				std::vector<AudioBuffer> buffers;
+				Playhead playhead;
+				AudioStreamInfo info;
+				/// <summary>
+				/// Total amount of samples written into this snapshot, used to catch up with the latest one.
+				/// </summary>
+				std::uint64_t clock = 0;
+				std::atomic<int> readers{ 0 };
+			};
+
+			static constexpr std::size_t historySnapshotCount = 3;
+
+			AudioBufferAccess accessLatestHistory();
+			HistorySnapshot* acquireWritableHistory(const std::unique_lock<std::mutex>&, bool waitForReaders);
+			void synchronizeHistory(HistorySnapshot& target, const HistorySnapshot& latest);
+			void publishHistory(HistorySnapshot& snapshot);
+
+			void ensureAudioHistoryStorage(std::size_t channels, std::size_t pSize, std::size_t pCapacity, const std::unique_lock<std::mutex>&);
+			void mergeInputToBuffer(const std::unique_lock<std::mutex>&, HistorySnapshot& target, ChannelMatrix* realInputs, const Playhead& playheadToAssign, const AudioStreamInfo& infoToAssign);
+			void publishEpoch(ListenerContext& ctx);
 
 			struct ListenerCommand
 			{
@@ -681,16 +982,26 @@ namespace cpl
 				bool wasAdded;
 			};
 
-			Playhead playhead, bufferPlayhead, deferredCheckpointPlayhead;
-			AudioStreamInfo info, oldInfo, bufferInfo, deferredCheckpointBufferInfo;
+			Playhead playhead, deferredCheckpointPlayhead;
+			AudioStreamInfo info, oldInfo, deferredCheckpointBufferInfo;
 			ChannelMatrix audioInput;
 			std::vector<std::vector<T>> deferredAudioInput;
-			std::vector<AudioBuffer> audioHistoryBuffers;
+			std::array<HistorySnapshot, historySnapshotCount> history;
+			std::atomic<std::size_t> latestHistory{ 0 };
+			/// <summary>
+			/// The layout of the latest history snapshot, only accessed by writers.
+			/// </summary>
+			std::size_t historyChannels = 0, historySize = 0, historyCapacity = 0;
 			relaxed_atomic<double> consumerOverhead, consumerUsage;
 			CProcessorTimer overhead, all;
 
 			std::vector<ListenerCommand> inputListeners;
 			std::vector<std::shared_ptr<Listener>> listeners;
+			/// <summary>
+			/// Recycled once only this holds a reference.
+			/// </summary>
+			std::vector<std::shared_ptr<AudioEpoch>> epochs;
+			std::uint64_t epochSequence = 0;
 			std::mutex inputCommandMutex;
 			ConsumerInfo inputInfo;
 			weak_atomic<bool> inputChanges;
@@ -699,7 +1010,11 @@ namespace cpl
 
 			weak_atomic<std::size_t> numDeferredAsyncSamples;
 			std::vector<std::string> channelNames;
-			std::mutex aBufferMutex;
+			/// <summary>
+			/// Serializes writers of the history (the async thread, and listeners consuming deferred data).
+			/// Never taken by readers.
+			/// </summary>
+			std::mutex historyWriterMutex;
 		};
 
 		struct FrameBatch
@@ -711,7 +1026,7 @@ namespace cpl
 			}
 
 			FrameBatch(AudioStream& audioStream)
-				: stream(&audioStream)
+				: stream(&audioStream), slabs(audioStream.audioSlabs.get())
 			{
 				if (hasContents(audioStream.output))
 				{
@@ -724,8 +1039,8 @@ namespace cpl
 				}
 			}
 
-			FrameBatch(std::shared_ptr<Output>&& out)
-				: output(std::move(out)), stream(nullptr)
+			FrameBatch(std::shared_ptr<Output>&& out, SlabRing* slabRing)
+				: stream(nullptr), output(std::move(out)), slabs(slabRing)
 			{
 				if (output)
 					output->beginFrameProcessing();
@@ -737,6 +1052,31 @@ namespace cpl
 					output->handleFrame(std::move(frame));
 				else if(stream)
 					return stream->publishFrame(std::move(frame));
+				else if (auto slab = std::get_if<AudioSlab>(&frame))
+				{
+					// nobody is listening, but the space must still be handed back.
+					slabs->release(slab->slab);
+				}
+
+				return true;
+			}
+
+			/// <summary>
+			/// Submits a drained run of frames, letting the output coalesce contiguous audio.
+			/// </summary>
+			bool submitFrames(ProducerFrame* frames, std::size_t count)
+			{
+				if (output)
+				{
+					output->handleFrames(frames, count);
+					return true;
+				}
+
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					if (!submitFrame(std::move(frames[i])))
+						return false;
+				}
 
 				return true;
 			}
@@ -749,6 +1089,7 @@ namespace cpl
 
 			AudioStream* stream;
 			std::shared_ptr<Output> output;
+			SlabRing* slabs;
 		};
 
 		class Input final : public Reference
@@ -765,6 +1106,12 @@ namespace cpl
 #endif
 			void processIncomingRTAudio(const T* const * buffer, std::size_t numChannels, std::size_t numSamples, const Playhead& ph);
 
+		private:
+
+			bool publishSlab(FrameBatch& batch, const T* const * buffer, std::size_t numChannels, std::size_t numSamples, bool& didDropFrames);
+
+		public:
+
 			/// <summary>
 			/// Returns the playhead for the system.
 			/// Only valid to call and read, while you're inside a
@@ -821,6 +1168,21 @@ namespace cpl
 				return !haltedDueToNoListeners;
 			}
 
+			/// <summary>
+			/// ANY THREAD.
+			/// Returns the approximate number of frames waiting in the fifo of an async stream,
+			/// and its current capacity. Both are zero for synchronous streams.
+			/// Frames are dropped when the fifo is full, so producers not bound to real time
+			/// can use this to throttle themselves.
+			/// </summary>
+			std::pair<std::size_t, std::size_t> getFifoUsage() const noexcept
+			{
+				if (auto& fifo = this->stream->audioFifo)
+					return { fifo->enqueuededElements(), fifo->size() };
+
+				return { 0, 0 };
+			}
+
 			~Input()
 			{
 				if (this->stream)
@@ -887,27 +1249,26 @@ namespace cpl
 			/// <summary>
 			/// Returns a view of the audio history for all channels the last N samples (see setAudioHistorySize)
 			/// References are only guaranteed to be valid while AudioBufferAccess is in scope.
-			/// May acquire a lock in the returned class, so don't call it from real-time threads.
-			///
-			/// Ensures exclusive access while it is hold.
+			/// The view is a snapshot that isn't modified while it is held.
 			/// </summary>
 			/// <param name="consumeDeferredData">
 			/// If set, the playhead and circular audio data of the returned audio buffer is spooled to include
-			/// any input that is been deferred. This has no effect if <see cref="ConsumerInfo::blockOnHistoryBuffer"/> is set.
+			/// any input that is been deferred. This may wait for other writers, and for readers to release old snapshots.
 			/// </param>
 			AudioBufferAccess getAudioBufferViews(bool consumeDeferredData)
 			{
-				std::unique_lock<std::mutex> lock(parent.aBufferMutex);
-
-				if (consumeDeferredData)
-				{
-					parent.mergeInputToBuffer(lock, nullptr, parent.deferredCheckpointPlayhead, parent.deferredCheckpointBufferInfo);
-					return { std::move(lock), parent.audioHistoryBuffers, parent.bufferPlayhead, parent.bufferInfo};
-				}
-				else
+				if (consumeDeferredData && parent.numDeferredAsyncSamples)
 				{
-					return { std::move(lock), parent.audioHistoryBuffers, parent.bufferPlayhead, parent.bufferInfo };
+					std::unique_lock<std::mutex> lock(parent.historyWriterMutex);
+
+					if (auto snapshot = parent.acquireWritableHistory(lock, true))
+					{
+						parent.mergeInputToBuffer(lock, *snapshot, nullptr, parent.deferredCheckpointPlayhead, parent.deferredCheckpointBufferInfo);
+						parent.publishHistory(*snapshot);
+					}
 				}
+
+				return parent.accessLatestHistory();
 			}
 
 			const AudioStreamInfo& getInfo() const noexcept
@@ -934,7 +1295,12 @@ namespace cpl
 		/// Fifo sizes refer to the buffer size of the lock free fifo. The fifo stores AudioFrames.
 		/// </summary>
 		/// <param name="enableAsyncSubsystem"></param>
-		static IO create(bool async = false, size_t initialFifoSize = 20, std::size_t maxFifoSize = 1000)
+		/// <param name="slabCapacity">
+		/// If non-zero (and async is set), incoming audio is written into a pre-allocated ring of this many samples
+		/// as one variable-sized slab per host block, instead of being split into fixed-size packets.
+		/// The consumer reads the slabs in place. If the ring is full, the stream falls back to packets.
+		/// </param>
+		static IO create(bool async = false, size_t initialFifoSize = 20, std::size_t maxFifoSize = 1000, std::size_t slabCapacity = 0)
 		{
 			auto output = Output::makeOutput();
 			std::weak_ptr<Output> weakOutput = output;
@@ -944,6 +1310,10 @@ namespace cpl
 			if (async)
 			{
 				stream = std::shared_ptr<AudioStream>(new AudioStream(initialFifoSize, maxFifoSize));
+
+				if (slabCapacity)
+					stream->audioSlabs = std::make_unique<SlabRing>(slabCapacity);
+
 				detail::launchThread([stream, weakOutput]() { asyncAudioSystem(stream, weakOutput); });
 			}
 			else
@@ -981,9 +1351,32 @@ namespace cpl
 			old = newTime + coeff * (old - newTime);
 		}
 		
+		static constexpr int stampShift = 10;
+
+		/// <summary>
+		/// A truncated processor clock, stamped on audio frames as they enter the fifo.
+		/// Wraps around every 2^42 clocks.
+		/// </summary>
+		static std::uint32_t currentStamp() noexcept
+		{
+			return static_cast<std::uint32_t>(cpl::Misc::ClockCounter() >> stampShift);
+		}
+
+		static std::uint64_t stampToClocks(std::uint32_t elapsedStamps) noexcept
+		{
+			return static_cast<std::uint64_t>(elapsedStamps) << stampShift;
+		}
+
 		// use FrameBatch unless internally calling.
 		bool publishFrame(ProducerFrame&& frame)
 		{
+			const auto stamp = currentStamp();
+
+			if (auto packet = std::get_if<AudioPacket>(&frame))
+				packet->setStamp(stamp);
+			else if (auto slab = std::get_if<AudioSlab>(&frame))
+				slab->stamp = stamp;
+
 			if (!audioFifo->pushElement(std::move(frame)))
 			{
 				droppedFrames.fetch_add(1);
@@ -1007,8 +1400,14 @@ namespace cpl
 		relaxed_atomic<std::size_t> droppedFrames{};
 		relaxed_atomic<int> outputListenerCount;
 
+		struct Histograms
+		{
+			LatencyHistogram producerCost, queueResidency, consumerMerge, listenerCallback;
+		} histograms;
+
 		std::weak_ptr<Output> output;
 		std::unique_ptr<FrameQueue> audioFifo;
+		std::unique_ptr<SlabRing> audioSlabs;
 	};
 
 };
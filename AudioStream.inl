@@ -34,9 +34,11 @@ namespace cpl
 	template<typename T, std::size_t PacketSize>
 	inline AudioStream<T, PacketSize>::Output::~Output()
 	{
+		// synchronize against any rogue buffer accesses being held.
+		for (auto& snapshot : history)
 		{
-			// synchronize against any rogue buffer locks being held.
-			std::lock_guard<std::mutex> lock(aBufferMutex);
+			while (snapshot.readers.load(std::memory_order_acquire))
+				std::this_thread::yield();
 		}
 
 		ListenerContext ctx(*this);
@@ -58,10 +60,24 @@ namespace cpl
 	template<typename T, std::size_t PacketSize>
 	inline void AudioStream<T, PacketSize>::Output::handleFrame(AudioStream<T, PacketSize>::ProducerFrame&& frame)
 	{
+		// only frames passing through the fifo are stamped
+		const bool isAsync = this->stream->audioFifo != nullptr;
+
 		if (const auto * audio = std::get_if<AudioPacket>(&frame))
 		{
+			if (isAsync)
+				this->stream->histograms.queueResidency.record(stampToClocks(currentStamp() - audio->getStamp()));
+
 			audioInput.insertFrameIntoBuffer(*audio);
 		}
+		else if (const auto * slab = std::get_if<AudioSlab>(&frame))
+		{
+			if (isAsync)
+				this->stream->histograms.queueResidency.record(stampToClocks(currentStamp() - slab->stamp));
+
+			audioInput.insertFrameIntoBuffer(*slab);
+			this->stream->audioSlabs->release(slab->slab);
+		}
 		else
 		{
 			if (!audioInput.isEmpty())
@@ -130,6 +146,52 @@ namespace cpl
 		}
 	}
 
+	template<typename T, std::size_t PacketSize>
+	inline void AudioStream<T, PacketSize>::Output::handleFrames(AudioStream<T, PacketSize>::ProducerFrame* frames, std::size_t count)
+	{
+		const bool isAsync = this->stream->audioFifo != nullptr;
+
+		for (std::size_t i = 0; i < count;)
+		{
+			std::size_t channels, samples;
+
+			if (!ChannelMatrix::getAudioLayout(frames[i], channels, samples))
+			{
+				handleFrame(std::move(frames[i++]));
+				continue;
+			}
+
+			// find the run of contiguous audio with the same layout
+			std::size_t end = i + 1, runChannels, runSamples;
+
+			while (end < count && ChannelMatrix::getAudioLayout(frames[end], runChannels, runSamples) && runChannels == channels)
+			{
+				samples += runSamples;
+				end++;
+			}
+
+			audioInput.insertFramesIntoBuffer(frames + i, end - i, channels, samples);
+
+			const auto now = currentStamp();
+
+			for (; i < end; ++i)
+			{
+				if (const auto* audio = std::get_if<AudioPacket>(frames + i))
+				{
+					if (isAsync)
+						this->stream->histograms.queueResidency.record(stampToClocks(now - audio->getStamp()));
+				}
+				else if (const auto* slab = std::get_if<AudioSlab>(frames + i))
+				{
+					if (isAsync)
+						this->stream->histograms.queueResidency.record(stampToClocks(now - slab->stamp));
+
+					this->stream->audioSlabs->release(slab->slab);
+				}
+			}
+		}
+	}
+
 	template<typename T, std::size_t PacketSize>
 	inline void AudioStream<T, PacketSize>::Output::endFrameProcessing()
 	{
@@ -142,7 +204,7 @@ namespace cpl
 
 		if (!inputChanges)
 		{
-			signalChange = signalChange || (info.storeAudioHistory && audioHistoryBuffers.size() != channels);
+			signalChange = signalChange || (info.storeAudioHistory && historyChannels != channels);
 		}
 		else
 		{
@@ -155,7 +217,7 @@ namespace cpl
 				consumerInfoChange = false;
 			}
 
-			signalChange = signalChange || (info.storeAudioHistory && audioHistoryBuffers.size() != channels);
+			signalChange = signalChange || (info.storeAudioHistory && historyChannels != channels);
 
 			for (auto& listenerCommand : inputListeners)
 			{
@@ -181,36 +243,41 @@ namespace cpl
 		deferredAudioInput.resize(channels);
 
 		{
-			bool audioHistoryDifferent = channels != audioHistoryBuffers.size();
+			bool audioHistoryDifferent = channels != historyChannels;
 
 			if (channels)
 			{
-				// while this may be concurrently read from, noone can mutate them
-				audioHistoryDifferent = audioHistoryDifferent || info.audioHistorySize != audioHistoryBuffers[0].getSize();
-				audioHistoryDifferent = audioHistoryDifferent || info.audioHistoryCapacity != audioHistoryBuffers[0].getCapacity();
+				audioHistoryDifferent = audioHistoryDifferent || info.audioHistorySize != historySize;
+				audioHistoryDifferent = audioHistoryDifferent || info.audioHistoryCapacity != historyCapacity;
 			}
 
 			// resize audio history buffer here, so it takes effect,
 			// before any async callers are notified.
 			if (signalChange && info.storeAudioHistory && audioHistoryDifferent)
 			{
+				std::unique_lock<std::mutex> writerLock(historyWriterMutex);
+
 				ensureAudioHistoryStorage(
 					channels,
 					info.audioHistorySize,
 					info.audioHistoryCapacity,
-					std::lock_guard<std::mutex>(aBufferMutex)
+					writerLock
 				);
 			}
 
 			overhead.pause();
 
+			const bool concurrentListeners = info.concurrentListeners && audioInput.containedSamples > 0;
+
 			for (auto& listener : listeners)
 			{
 				if (signalChange)
 					listener->onStreamPropertiesChanged(ctx, oldInfo);
 
-				if (audioInput.containedSamples > 0)
+				if (audioInput.containedSamples > 0 && !concurrentListeners)
 				{
+					const auto begin = cpl::Misc::ClockCounter();
+
 					listener->onStreamAudio
 					(
 						ctx,
@@ -218,9 +285,14 @@ namespace cpl
 						channels,
 						audioInput.containedSamples
 					);
+
+					this->stream->histograms.listenerCallback.record(cpl::Misc::ClockCounter() - begin);
 				}
 			}
 
+			if (concurrentListeners && !listeners.empty())
+				publishEpoch(ctx);
+
 			playhead.advance(audioInput.containedSamples);
 			overhead.resume();
 		}
@@ -228,14 +300,13 @@ namespace cpl
 		// Publish into circular buffer here.
 		if (info.storeAudioHistory && info.audioHistorySize && channels)
 		{
-			std::unique_lock<std::mutex> bufferLock(aBufferMutex, std::try_to_lock);
-			// decide whether to wait on the buffers
-			if (!bufferLock.owns_lock() && info.blockOnHistoryBuffer)
-				bufferLock.lock();
+			std::unique_lock<std::mutex> writerLock(historyWriterMutex);
 
-			if (bufferLock.owns_lock())
+			// decide whether to wait on readers holding on to old snapshots
+			if (auto snapshot = acquireWritableHistory(writerLock, info.blockOnHistoryBuffer))
 			{
-				mergeInputToBuffer(bufferLock, &audioInput, playhead, info);
+				mergeInputToBuffer(writerLock, *snapshot, &audioInput, playhead, info);
+				publishHistory(*snapshot);
 			}
 			else
 			{
@@ -262,6 +333,8 @@ namespace cpl
 		double timeFraction = (double)audioInput.containedSamples;
 		if (std::isnormal(timeFraction))
 		{
+			this->stream->histograms.consumerMerge.record(overhead.getTime());
+
 			timeFraction /= info.sampleRate;
 			lpFilterTimeToMeasurement(consumerOverhead, overhead.clocksToCoreUsage(overhead.getTime()), timeFraction);
 			lpFilterTimeToMeasurement(consumerUsage, all.clocksToCoreUsage(all.getTime()), timeFraction);
@@ -269,17 +342,150 @@ namespace cpl
 	}
 
 	template<typename T, std::size_t PacketSize>
-	inline void AudioStream<T, PacketSize>::Output::mergeInputToBuffer(const std::unique_lock<std::mutex>& lock, ChannelMatrix* realInputs, const Playhead& playheadToAssign, const AudioStreamInfo& infoToAssign)
+	inline void AudioStream<T, PacketSize>::Output::publishEpoch(ListenerContext& ctx)
+	{
+		std::shared_ptr<AudioEpoch>* epoch = nullptr;
+
+		for (auto& candidate : epochs)
+		{
+			// only we can hand out new references, so this can't increase concurrently.
+			if (candidate.use_count() == 1)
+			{
+				// use_count() is a relaxed load. listeners drop their references with a release decrement,
+				// so this makes their last reads of the epoch happen before we overwrite it below.
+				std::atomic_thread_fence(std::memory_order_acquire);
+				epoch = &candidate;
+				break;
+			}
+		}
+
+		if (!epoch)
+			epoch = &epochs.emplace_back(std::make_shared<AudioEpoch>());
+
+		(*epoch)->assign(audioInput, playhead, info, epochSequence++);
+
+		const std::shared_ptr<const AudioEpoch> shared = *epoch;
+
+		cpl::jobs::parallel_for(
+			listeners.size(),
+			[&](std::size_t i)
+			{
+				const auto begin = cpl::Misc::ClockCounter();
+				listeners[i]->onStreamEpoch(ctx, shared);
+				this->stream->histograms.listenerCallback.record(cpl::Misc::ClockCounter() - begin);
+			},
+			1
+		);
+	}
+
+	template<typename T, std::size_t PacketSize>
+	inline typename AudioStream<T, PacketSize>::AudioBufferAccess AudioStream<T, PacketSize>::Output::accessLatestHistory()
+	{
+		while (true)
+		{
+			const auto index = latestHistory.load(std::memory_order_seq_cst);
+			auto& snapshot = history[index];
+
+			snapshot.readers.fetch_add(1, std::memory_order_seq_cst);
+
+			// if it's still the latest, the writer can't have picked it after this point.
+			// otherwise, the writer may be modifying it: retry.
+			if (latestHistory.load(std::memory_order_seq_cst) == index)
+				return { HistoryPin(snapshot.readers), snapshot.buffers, snapshot.playhead, snapshot.info };
+
+			snapshot.readers.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+	template<typename T, std::size_t PacketSize>
+	inline typename AudioStream<T, PacketSize>::Output::HistorySnapshot* AudioStream<T, PacketSize>::Output::acquireWritableHistory(const std::unique_lock<std::mutex>& lock, bool waitForReaders)
+	{
+		CPL_RUNTIME_ASSERTION(lock.owns_lock());
+
+		const auto latest = latestHistory.load(std::memory_order_relaxed);
+
+		while (true)
+		{
+			for (std::size_t i = 0; i < historySnapshotCount; ++i)
+			{
+				if (i != latest && history[i].readers.load(std::memory_order_seq_cst) == 0)
+				{
+					synchronizeHistory(history[i], history[latest]);
+					return &history[i];
+				}
+			}
+
+			if (!waitForReaders)
+				return nullptr;
+
+			std::this_thread::yield();
+		}
+	}
+
+	template<typename T, std::size_t PacketSize>
+	inline void AudioStream<T, PacketSize>::Output::synchronizeHistory(HistorySnapshot& target, const HistorySnapshot& latest)
+	{
+		const auto channels = latest.buffers.size();
+		const auto size = channels ? latest.buffers[0].getSize() : 0;
+		const auto capacity = channels ? latest.buffers[0].getCapacity() : 0;
+		const auto missing = latest.clock - target.clock;
+
+		bool sameLayout = target.buffers.size() == channels;
+
+		if (sameLayout && channels)
+			sameLayout = target.buffers[0].getSize() == size && target.buffers[0].getCapacity() == capacity;
+
+		std::size_t samplesToCopy = static_cast<std::size_t>(std::min<std::uint64_t>(missing, size));
+
+		if (!sameLayout)
+		{
+			target.buffers.resize(channels);
+
+			for (auto& buffer : target.buffers)
+			{
+				buffer.setStorageRequirements(size, capacity, false, T());
+				buffer.setCursor(0);
+			}
+
+			samplesToCopy = size;
+		}
+
+		if (samplesToCopy)
+		{
+			for (std::size_t c = 0; c < channels; ++c)
+			{
+				auto&& view = latest.buffers[c].createProxyView();
+				auto&& w = target.buffers[c].createWriter();
+				// the newest samples of the latest snapshot
+				w.copyIntoHead(view, samplesToCopy, static_cast<typename AudioBuffer::ssize_t>(size - samplesToCopy));
+			}
+		}
+
+		target.clock = latest.clock;
+		target.playhead = latest.playhead;
+		target.info = latest.info;
+	}
+
+	template<typename T, std::size_t PacketSize>
+	inline void AudioStream<T, PacketSize>::Output::publishHistory(HistorySnapshot& snapshot)
+	{
+		latestHistory.store(static_cast<std::size_t>(&snapshot - history.data()), std::memory_order_seq_cst);
+	}
+
+	template<typename T, std::size_t PacketSize>
+	inline void AudioStream<T, PacketSize>::Output::mergeInputToBuffer(const std::unique_lock<std::mutex>& lock, HistorySnapshot& target, ChannelMatrix* realInputs, const Playhead& playheadToAssign, const AudioStreamInfo& infoToAssign)
 	{
 		const auto channels = deferredAudioInput.size();
 
-		CPL_RUNTIME_ASSERTION(channels == audioHistoryBuffers.size());
+		CPL_RUNTIME_ASSERTION(channels == target.buffers.size());
 		CPL_RUNTIME_ASSERTION(lock.owns_lock());
 
+		std::uint64_t written = 0;
+
 		for (std::size_t i = 0; i < channels; ++i)
 		{
 			{
-				auto&& w = audioHistoryBuffers[i].createWriter();
+				auto&& w = target.buffers[i].createWriter();
 
 				// first, insert all the old stuff that happened while this buffer was blocked
 				if (numDeferredAsyncSamples)
@@ -299,39 +505,54 @@ namespace cpl
 					w.copyIntoHead(realInputs->buffer[i].data(), realInputs->containedSamples);
 			}
 
+			written = deferredAudioInput[i].size() + (realInputs ? realInputs->containedSamples : 0);
+
 			// clear up temporary deferred stuff
 			deferredAudioInput[i].clear();
 		}
 
+		target.clock += written;
+
 		// bit redundant, but ensures it will be called.
 		numDeferredAsyncSamples = 0;
 
-		deferredCheckpointPlayhead = bufferPlayhead = playheadToAssign;
-		deferredCheckpointBufferInfo = bufferInfo = infoToAssign;
+		deferredCheckpointPlayhead = target.playhead = playheadToAssign;
+		deferredCheckpointBufferInfo = target.info = infoToAssign;
 	}
 
 	template<typename T, std::size_t PacketSize>
-	inline void AudioStream<T, PacketSize>::Output::ensureAudioHistoryStorage(std::size_t channels, std::size_t pSize, std::size_t pCapacity, const std::lock_guard<std::mutex>&)
+	inline void AudioStream<T, PacketSize>::Output::ensureAudioHistoryStorage(std::size_t channels, std::size_t pSize, std::size_t pCapacity, const std::unique_lock<std::mutex>& lock)
 	{
-		if (audioHistoryBuffers.size() != channels)
+		// resized in a fresh snapshot, the others follow when they're next written to.
+		auto& snapshot = *acquireWritableHistory(lock, true);
+		auto& buffers = snapshot.buffers;
+
+		if (buffers.size() != channels)
 		{
-			audioHistoryBuffers.resize(channels);
+			buffers.resize(channels);
 			channelNames.resize(std::max(channelNames.size(), channels));
 		}
 
-		auto cursor = channels > 0 ? audioHistoryBuffers[0].getCursor() : 0;
+		auto cursor = channels > 0 ? buffers[0].getCursor() : 0;
 
 		for (std::size_t i = 0; i < channels; ++i)
 		{
-			audioHistoryBuffers[i].setStorageRequirements(pSize, pCapacity, true, T());
-			audioHistoryBuffers[i].setCursor(cursor);
+			buffers[i].setStorageRequirements(pSize, pCapacity, true, T());
+			buffers[i].setCursor(cursor);
 		}
+
+		historyChannels = channels;
+		historySize = pSize;
+		historyCapacity = pCapacity;
+
+		publishHistory(snapshot);
 	}
 
 	template<typename T, std::size_t PacketSize>
 	inline void AudioStream<T, PacketSize>::Input::processIncomingRTAudio(const T* const* buffer, std::size_t numChannels, std::size_t numSamples, const AudioStream<T, PacketSize>::Playhead& ph)
 	{
 		ExclusiveDebugScope scope(reentrancy);
+		Realtime::ScopedThread realtime;
 
 		if (internalInfo.isSuspended)
 			return;
@@ -381,7 +602,11 @@ namespace cpl
 		bool didDropAnyFrames = false;
 
 		// publish all data to audio consumer thread
-		if (numChannels == 1)
+		if (this->stream->audioSlabs && publishSlab(batch, buffer, numChannels, numSamples, didDropAnyFrames))
+		{
+			n = 0;
+		}
+		else if (numChannels == 1)
 		{
 			constexpr std::int64_t singleChannelCapacity = static_cast<std::int64_t>(AudioPacket::getCapacityForChannels(1));
 
@@ -438,22 +663,59 @@ namespace cpl
 			framesWereDropped = true;
 
 		// post new measures
+		this->stream->histograms.producerCost.record(all.getTime());
 		lpFilterTimeToMeasurement(this->stream->producerOverhead, overhead.clocksToCoreUsage(overhead.getTime()), timeFraction);
 		lpFilterTimeToMeasurement(this->stream->producerUsage, all.clocksToCoreUsage(all.getTime()), timeFraction);
 	}
 
+	template<typename T, std::size_t PacketSize>
+	inline bool AudioStream<T, PacketSize>::Input::publishSlab(FrameBatch& batch, const T* const* buffer, std::size_t numChannels, std::size_t numSamples, bool& didDropFrames)
+	{
+		auto& ring = *this->stream->audioSlabs;
+
+		if (numSamples == 0 || numSamples > std::numeric_limits<std::uint32_t>::max())
+			return false;
+
+		auto slab = ring.acquire(numSamples * numChannels);
+
+		if (!slab.isValid())
+			return false;
+
+		for (std::size_t c = 0; c < numChannels; ++c)
+		{
+			std::memcpy(slab.data + c * numSamples, buffer[c], numSamples * sizeof(T));
+		}
+
+		ProducerFrame frame;
+		frame.template emplace<AudioSlab>(AudioSlab{ slab, static_cast<std::uint32_t>(numSamples), static_cast<std::uint8_t>(numChannels), 0 });
+
+		if (!batch.submitFrame(std::move(frame)))
+		{
+			// the consumer never saw it, so the space can be reused.
+			ring.revert(slab);
+			didDropFrames = true;
+			this->stream->droppedFrames.fetch_add(numSamples);
+		}
+
+		return true;
+	}
+
 	template<typename T, std::size_t PacketSize>
 	inline void AudioStream<T, PacketSize>::asyncAudioSystem(std::shared_ptr<AudioStream<T, PacketSize>> stream, std::weak_ptr<Output> output)
 	{
 		_MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
 
-		ProducerFrame recv;
+		// frames drained per wake-up, coalesced into a single batch for the listeners
+		constexpr std::size_t maxDrainedFrames = 128;
+
+		std::vector<ProducerFrame> frames(maxDrainedFrames);
 		int pops(20);
+		std::size_t received;
 
-		// when it returns false, its time to quit this thread.
-		while (stream->audioFifo->popElementBlocking(recv))
+		// when it returns zero, its time to quit this thread.
+		while ((received = stream->audioFifo->popElementsBlocking(frames.data(), frames.size())) != 0)
 		{
-			FrameBatch batch(output.lock());
+			FrameBatch batch(output.lock(), stream->audioSlabs.get());
 
 			// always resize queue before emptying
 			if (pops++ > 10)
@@ -462,27 +724,22 @@ namespace cpl
 				pops = 0;
 			}
 
-			batch.submitFrame(std::move(recv));
+			batch.submitFrames(frames.data(), received);
 
-			std::size_t numExtraEntries = 0;
-			do
+			// each time we get into here, it's very likely there's a bunch of messages waiting.
+			while (stream->audioFifo->enqueuededElements() != 0)
 			{
-				// each time we get into here, it's very likely there's a bunch of messages waiting.
-				numExtraEntries = stream->audioFifo->enqueuededElements();
+				if ((received = stream->audioFifo->popElementsBlocking(frames.data(), frames.size())) == 0)
+					return;
 
-				for (size_t i = 0; i < numExtraEntries; i++)
-				{
-					if (!stream->audioFifo->popElementBlocking(recv))
-						return;
-					batch.submitFrame(std::move(recv));
-				}
-			} while (numExtraEntries != 0);
+				batch.submitFrames(frames.data(), received);
+			}
 		}
 
 		if (auto sh = output.lock())
 		{
 			// one final batch to trigger non-frame processing
-			FrameBatch batch(std::move(sh));
+			FrameBatch batch(std::move(sh), stream->audioSlabs.get());
 
 		}
 	}
@@ -0,0 +1,435 @@
+/*************************************************************************************
+
+	cpl - cross-platform library - v. 0.1.0.
+
+	Copyright (C) 2023 Janus Lynggaard Thorborg (www.jthorborg.com)
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	See \licenses\ for additional details on licenses associated with this program.
+
+**************************************************************************************
+
+	file:AudioStreamReplay.h
+
+		Drives an AudioStream::Input from a file or a generator instead of a host,
+		either paced in real time or as fast as the consumer keeps up.
+
+*************************************************************************************/
+
+#ifndef CPL_AUDIOSTREAMREPLAY_H
+#define CPL_AUDIOSTREAMREPLAY_H
+
+#include "AudioStream.h"
+#include "simd/simd_interleave.h"
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <limits>
+#include <algorithm>
+
+namespace cpl
+{
+	template<typename T, std::size_t PacketSize>
+	class AudioStreamReplay
+	{
+	public:
+
+		typedef AudioStream<T, PacketSize> Stream;
+		typedef typename Stream::Input Input;
+		typedef typename Stream::Playhead Playhead;
+
+		enum class Pacing
+		{
+			/// <summary>
+			/// Blocks are delivered at the rate a host at the sample rate would.
+			/// </summary>
+			Realtime,
+			/// <summary>
+			/// Blocks are delivered as soon as the consumer has drained the async fifo.
+			/// Frames are only dropped while the fifo is too small to hold a block, until it has grown.
+			/// </summary>
+			AsFastAsPossible
+		};
+
+		struct Format
+		{
+			std::size_t channels = 0;
+			double sampleRate = 0;
+		};
+
+		/// <summary>
+		/// Fills up to numSamples of every channel, returning the number of samples produced.
+		/// Returning zero ends the replay.
+		/// </summary>
+		typedef std::function<std::size_t(T* const* channels, std::size_t numChannels, std::size_t numSamples)> Source;
+
+		/// <summary>
+		/// A host playhead taking effect from a sample position of the replay, and advancing along with it.
+		/// Transport and arrangement changes are pushed through the stream exactly as from a host.
+		/// </summary>
+		struct PlayheadEvent
+		{
+			std::uint64_t position;
+			Playhead playhead;
+		};
+
+		AudioStreamReplay(Input&& streamInput, const Format& streamFormat, Source streamSource, std::size_t maxBlockSize = 512)
+			: input(std::move(streamInput))
+			, format(streamFormat)
+			, source(std::move(streamSource))
+			, blockSize(maxBlockSize)
+		{
+			CPL_RUNTIME_ASSERTION(format.channels > 0 && format.sampleRate > 0 && blockSize > 0);
+		}
+
+		void setPacing(Pacing newPacing) noexcept { pacing = newPacing; }
+
+		/// <summary>
+		/// Events must be sorted by position. Blocks are split so events land on block boundaries.
+		/// </summary>
+		void setPlayheadEvents(std::vector<PlayheadEvent> newEvents) { events = std::move(newEvents); }
+
+		/// <summary>
+		/// Feeds the stream from the calling thread until the source is exhausted or stop() is called.
+		/// Returns the number of samples delivered.
+		/// </summary>
+		std::uint64_t run()
+		{
+			input.initializeInfo(
+				[this](auto& info)
+				{
+					info.sampleRate = format.sampleRate;
+					info.channels = static_cast<std::uint8_t>(format.channels);
+					info.anticipatedSize = static_cast<std::uint32_t>(blockSize);
+				}
+			);
+
+			std::vector<std::vector<T>> buffers(format.channels, std::vector<T>(blockSize));
+			std::vector<T*> pointers(format.channels);
+
+			for (std::size_t c = 0; c < format.channels; ++c)
+				pointers[c] = buffers[c].data();
+
+			auto playhead = Playhead::empty();
+			playhead.setSampleRate(format.sampleRate);
+
+			const auto start = std::chrono::steady_clock::now();
+			std::uint64_t position = 0;
+			std::size_t nextEvent = 0;
+
+			while (!stopped.load(std::memory_order_relaxed))
+			{
+				while (nextEvent < events.size() && events[nextEvent].position <= position)
+				{
+					playhead = events[nextEvent++].playhead;
+					playhead.setSampleRate(format.sampleRate);
+				}
+
+				std::size_t size = blockSize;
+
+				if (nextEvent < events.size())
+					size = static_cast<std::size_t>(std::min<std::uint64_t>(size, events[nextEvent].position - position));
+
+				const auto produced = source(pointers.data(), format.channels, size);
+
+				if (!produced)
+					break;
+
+				if (pacing == Pacing::Realtime)
+				{
+					std::this_thread::sleep_until(start + std::chrono::duration<double>(position / format.sampleRate));
+				}
+				else
+				{
+					// leave as much room as possible for the frames of this block
+					while (input.getFifoUsage().first)
+					{
+						if (stopped.load(std::memory_order_relaxed))
+							return position;
+
+						std::this_thread::yield();
+					}
+				}
+
+				input.processIncomingRTAudio(pointers.data(), format.channels, produced, playhead);
+				playhead.advance(static_cast<cpl::ssize_t>(produced));
+				position += produced;
+			}
+
+			return position;
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// </summary>
+		void stop() noexcept
+		{
+			stopped.store(true, std::memory_order_relaxed);
+		}
+
+		Input& getInput() noexcept { return input; }
+
+		/// <summary>
+		/// A source of length samples (or endless, if zero), computed in blocks by
+		/// generator(T* const* channels, std::size_t numChannels, std::size_t numSamples, std::uint64_t position)
+		/// </summary>
+		template<typename Generator>
+		static Source generate(Generator&& generator, std::uint64_t length = 0)
+		{
+			return
+				[generator = std::forward<Generator>(generator), length, position = std::uint64_t(0)]
+				(T* const* channels, std::size_t numChannels, std::size_t numSamples) mutable -> std::size_t
+				{
+					if (length)
+						numSamples = static_cast<std::size_t>(std::min<std::uint64_t>(numSamples, length - position));
+
+					if (numSamples)
+						generator(channels, numChannels, numSamples, position);
+
+					position += numSamples;
+					return numSamples;
+				};
+		}
+
+		/// <summary>
+		/// A source reading headerless, interleaved samples of type T with format.channels.
+		/// </summary>
+		static Source rawFile(const std::string& path, const Format& format)
+		{
+			auto file = openFile(path);
+			return makeFileSource(std::move(file), format.channels, sizeof(T), SampleEncoding::Native, std::numeric_limits<std::uint64_t>::max());
+		}
+
+		/// <summary>
+		/// A source reading a RIFF WAVE file of 16, 24 or 32 bit integer, or 32 / 64 bit float samples.
+		/// Fills out the format of the file.
+		/// </summary>
+		static Source wavFile(const std::string& path, Format& format)
+		{
+			auto file = openFile(path);
+
+			char riff[12];
+
+			if (std::fread(riff, 1, sizeof(riff), file.get()) != sizeof(riff) || std::memcmp(riff, "RIFF", 4) || std::memcmp(riff + 8, "WAVE", 4))
+				CPL_RUNTIME_EXCEPTION("Not a RIFF WAVE file: " + path);
+
+			std::uint16_t tag = 0, channels = 0, bits = 0;
+			std::uint32_t sampleRate = 0, dataSize = 0;
+			bool hasFormat = false;
+
+			for (;;)
+			{
+				char id[4];
+				std::uint32_t size;
+
+				if (std::fread(id, 1, 4, file.get()) != 4 || !readLittleEndian(file.get(), size))
+					CPL_RUNTIME_EXCEPTION("No data chunk in WAVE file: " + path);
+
+				if (!std::memcmp(id, "fmt ", 4))
+				{
+					std::uint32_t byteRate;
+					std::uint16_t blockAlign;
+
+					if (size < 16 || !readLittleEndian(file.get(), tag) || !readLittleEndian(file.get(), channels) || !readLittleEndian(file.get(), sampleRate)
+						|| !readLittleEndian(file.get(), byteRate) || !readLittleEndian(file.get(), blockAlign) || !readLittleEndian(file.get(), bits))
+						CPL_RUNTIME_EXCEPTION("Corrupt format chunk in WAVE file: " + path);
+
+					size -= 16;
+
+					// WAVE_FORMAT_EXTENSIBLE: the real tag leads the sub format guid
+					if (tag == 0xFFFE && size >= 10)
+					{
+						std::uint16_t extensionSize, validBits;
+						std::uint32_t channelMask;
+
+						if (!readLittleEndian(file.get(), extensionSize) || !readLittleEndian(file.get(), validBits)
+							|| !readLittleEndian(file.get(), channelMask) || !readLittleEndian(file.get(), tag))
+							CPL_RUNTIME_EXCEPTION("Corrupt format chunk in WAVE file: " + path);
+
+						size -= 10;
+					}
+
+					hasFormat = true;
+				}
+				else if (!std::memcmp(id, "data", 4))
+				{
+					if (!hasFormat)
+						CPL_RUNTIME_EXCEPTION("Data before format in WAVE file: " + path);
+
+					dataSize = size;
+					break;
+				}
+
+				// chunks are word aligned
+				if (std::fseek(file.get(), static_cast<long>(size + (size & 1)), SEEK_CUR))
+					CPL_RUNTIME_EXCEPTION("Truncated WAVE file: " + path);
+			}
+
+			SampleEncoding encoding;
+
+			if (tag == 1 && bits == 16)
+				encoding = SampleEncoding::Int16;
+			else if (tag == 1 && bits == 24)
+				encoding = SampleEncoding::Int24;
+			else if (tag == 1 && bits == 32)
+				encoding = SampleEncoding::Int32;
+			else if (tag == 3 && bits == 32)
+				encoding = SampleEncoding::Float32;
+			else if (tag == 3 && bits == 64)
+				encoding = SampleEncoding::Float64;
+			else
+				CPL_RUNTIME_EXCEPTION("Unsupported sample format in WAVE file: " + path);
+
+			if (!channels)
+				CPL_RUNTIME_EXCEPTION("No channels in WAVE file: " + path);
+
+			format.channels = channels;
+			format.sampleRate = sampleRate;
+
+			// streamed recordings leave the size unset, in which case the data runs until the end.
+			const std::uint64_t length = dataSize && dataSize != 0xFFFFFFFF
+				? dataSize / (channels * (bits / 8))
+				: std::numeric_limits<std::uint64_t>::max();
+
+			return makeFileSource(std::move(file), channels, bits / 8, encoding, length);
+		}
+
+	private:
+
+		enum class SampleEncoding
+		{
+			Native, Int16, Int24, Int32, Float32, Float64
+		};
+
+		typedef std::shared_ptr<FILE> File;
+
+		static File openFile(const std::string& path)
+		{
+			File file(std::fopen(path.c_str(), "rb"), [](FILE* f) { if (f) std::fclose(f); });
+
+			if (!file)
+				CPL_RUNTIME_EXCEPTION("Unable to open replay file: " + path);
+
+			return file;
+		}
+
+		/// <remarks>
+		/// Assumes a little endian host.
+		/// </remarks>
+		template<typename Integer>
+		static bool readLittleEndian(FILE* file, Integer& value)
+		{
+			return std::fread(&value, sizeof(Integer), 1, file) == 1;
+		}
+
+		static T decode(const unsigned char* bytes, SampleEncoding encoding) noexcept
+		{
+			switch (encoding)
+			{
+			case SampleEncoding::Int16:
+			{
+				std::int16_t v; std::memcpy(&v, bytes, sizeof(v));
+				return static_cast<T>(v * (1.0 / 32768));
+			}
+			case SampleEncoding::Int24:
+			{
+				const std::int32_t v = static_cast<std::int32_t>((std::uint32_t(bytes[0]) << 8) | (std::uint32_t(bytes[1]) << 16) | (std::uint32_t(bytes[2]) << 24)) >> 8;
+				return static_cast<T>(v * (1.0 / 8388608));
+			}
+			case SampleEncoding::Int32:
+			{
+				std::int32_t v; std::memcpy(&v, bytes, sizeof(v));
+				return static_cast<T>(v * (1.0 / 2147483648.0));
+			}
+			case SampleEncoding::Float32:
+			{
+				float v; std::memcpy(&v, bytes, sizeof(v));
+				return static_cast<T>(v);
+			}
+			case SampleEncoding::Float64:
+			{
+				double v; std::memcpy(&v, bytes, sizeof(v));
+				return static_cast<T>(v);
+			}
+			default:
+			{
+				T v; std::memcpy(&v, bytes, sizeof(v));
+				return v;
+			}
+			}
+		}
+
+		static Source makeFileSource(File file, std::size_t fileChannels, std::size_t sampleBytes, SampleEncoding encoding, std::uint64_t length)
+		{
+			struct State
+			{
+				std::vector<unsigned char> raw;
+				std::vector<T> interleaved;
+				std::uint64_t remaining;
+			};
+
+			auto state = std::make_shared<State>();
+			state->remaining = length;
+
+			return
+				[file, state, fileChannels, sampleBytes, encoding]
+				(T* const* channels, std::size_t numChannels, std::size_t numSamples) -> std::size_t
+				{
+					CPL_RUNTIME_ASSERTION(numChannels == fileChannels);
+
+					const auto frameBytes = fileChannels * sampleBytes;
+					numSamples = static_cast<std::size_t>(std::min<std::uint64_t>(numSamples, state->remaining));
+					state->interleaved.resize(numSamples * fileChannels);
+
+					std::size_t frames;
+
+					if (encoding == SampleEncoding::Native)
+					{
+						frames = std::fread(state->interleaved.data(), frameBytes, numSamples, file.get());
+					}
+					else
+					{
+						state->raw.resize(numSamples * frameBytes);
+						frames = std::fread(state->raw.data(), frameBytes, numSamples, file.get());
+
+						for (std::size_t i = 0; i < frames * fileChannels; ++i)
+							state->interleaved[i] = decode(state->raw.data() + i * sampleBytes, encoding);
+					}
+
+					simd::deinterleave(state->interleaved.data(), fileChannels, frames, channels);
+					state->remaining -= frames;
+
+					return frames;
+				};
+		}
+
+		Input input;
+		Format format;
+		Source source;
+		std::size_t blockSize;
+		Pacing pacing = Pacing::Realtime;
+		std::vector<PlayheadEvent> events;
+		std::atomic<bool> stopped{ false };
+	};
+};
+
+#endif
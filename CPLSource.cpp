@@ -67,6 +67,7 @@
 #include "Exceptions.cpp"
 #include "AudioStream.cpp"
 #include "JobSystem.cpp"
+#include "RealtimeGuard.cpp"
 #include "ffts/pffft/pffft.c"
 #include "ffts/pffft/pffft_common.c"
 
@@ -76,8 +77,6 @@
 #include "FreeType/FreeTypeAmalgam.cpp"
 #endif
 
-/*
 #if !defined(CPL_LEAN)
 #include "CPLTests.cpp"
-#endif
-*/
\ No newline at end of file
+#endif
\ No newline at end of file
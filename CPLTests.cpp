@@ -22,7 +22,7 @@
 *************************************************************************************/
 
 #include "CPLTests.h"
-#include "CAudioStream.h"
+#include "AudioStream.h"
 #include <stdio.h>
 #include "lib/AlignedAllocator.h"
 #include "dsp.h"
@@ -31,7 +31,27 @@
 #include <numeric>
 #include <iostream>
 #include <map>
+#include <functional>
+#include <thread>
+#include <atomic>
 #include "AtomicCompability.h"
+#include "JobSystem.h"
+#include "lib/SegmentedQueue.h"
+#include "lib/BlockingLockFreeQueue.h"
+#include "lib/CFIFOEventSystem.h"
+#include "lib/LockFreeMPMCQueue.h"
+#include "lib/polystack_ptr.h"
+#include "lib/CLIFOStream.h"
+#include "AudioStreamReplay.h"
+#include "RealtimeGuard.h"
+#include "dsp/CComplexResonator.h"
+#include "dsp/IIRResonator.h"
+#include <random>
+#include <limits>
+#include <complex>
+#include <deque>
+#include <fstream>
+#include <string>
 namespace cpl
 {
 	const auto warn = DiagnosticLevel::Warnings;
@@ -99,81 +119,2056 @@ namespace cpl
 			va_end(args);
 		}
 	}
-	bool CAudioStreamTest(std::size_t emulatedBufferSize, double sampleRate, DiagnosticLevel lvl)
+	bool JobSystemAllocationTest(std::size_t rounds, DiagnosticLevel lvl)
+	{
+#ifndef CPL_TRAP_REALTIME_ALLOCATIONS
+		dout(warn, lvl, "JST: skipped, CPL_TRAP_REALTIME_ALLOCATIONS isn't defined so allocations can't be counted\n");
+		(void)rounds;
+		return true;
+#else
+		const std::size_t workers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+		JobSystem system(workers);
+		std::atomic_int sink{ 0 };
+
+		// diamonds, with a nested schedule so workers acquire as well
+		auto round = [&]
+		{
+			auto a = system.schedule([&] { return 1; });
+			auto b = system.schedule([&] { sink += 2; }, a);
+			auto c = system.schedule([&] { return system.schedule([] { return 3; }).complete(); }, a);
+			auto d = system.schedule([&] { sink += 4; }, b, c);
+			d.complete();
+			sink += a.complete() + c.complete();
+		};
+
+		// grow the pools and deques to their working set
+		for (std::size_t i = 0; i < rounds; ++i)
+			round();
+
+		// guard every worker for the rest of its life. the jobs can only pass the barrier
+		// once all of them run at the same time, so every worker gets exactly one.
+		std::atomic_size_t arrived{ 0 };
+		std::vector<JobSystem::Result<void>> pins;
+		pins.reserve(workers);
+
+		for (std::size_t i = 0; i < workers; ++i)
+		{
+			pins.emplace_back(system.schedule([&] {
+				static thread_local Realtime::ScopedThread guard;
+				arrived++;
+				while (arrived.load() < workers)
+					std::this_thread::yield();
+			}));
+		}
+
+		for (auto& pin : pins)
+			pin.complete();
+
+		const auto before = Realtime::allocationCount();
+
+		{
+			Realtime::ScopedThread guard;
+
+			for (std::size_t i = 0; i < rounds; ++i)
+				round();
+		}
+
+		const auto allocations = Realtime::allocationCount() - before;
+
+		dout(allocations ? warn : info, lvl, "JST: " CPL_FMT_SZT " allocations in " CPL_FMT_SZT " steady state rounds on " CPL_FMT_SZT " workers\n",
+			allocations, rounds, workers);
+
+		return allocations == 0;
+#endif
+	}
+
+	bool CSegmentedQueueTest(std::size_t elements, DiagnosticLevel lvl)
+	{
+		const std::size_t maxSize = 1 << 14;
+		CSegmentedQueue<std::uint64_t> queue(16, maxSize);
+
+		std::atomic_bool done{ false };
+		std::size_t drops = 0;
+
+		// the producer never allocates, so it drops whenever the consumer hasn't grown the queue in time
+		std::thread producer([&] {
+			for (std::uint64_t i = 0; i < elements; ++i)
+			{
+				if (!queue.pushElement(i))
+					drops++;
+			}
+
+			done.store(true, std::memory_order_release);
+		});
+
+		std::size_t received = 0, errors = 0, grows = 0;
+		std::uint64_t expected = 0;
+		std::uint64_t batch[64];
+
+		while (true)
+		{
+			const bool finished = done.load(std::memory_order_acquire);
+			const auto count = queue.popElements(batch, std::rand() % 64 + 1);
+
+			// drops leave gaps, but elements must never be reordered or duplicated
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				if (batch[i] < expected)
+					errors++;
+
+				expected = batch[i] + 1;
+			}
+
+			received += count;
+
+			if (queue.grow(0, true, 0.5f))
+				grows++;
+
+			// stall now and then, so the producer fills the queue and drops
+			if (std::rand() % 1024 == 0)
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+			if (finished && !count)
+				break;
+		}
+
+		producer.join();
+
+		const bool lost = received + drops != elements;
+
+		dout(errors || lost ? warn : info, lvl, "SQT: received " CPL_FMT_SZT ", dropped " CPL_FMT_SZT " of " CPL_FMT_SZT " elements, "
+			CPL_FMT_SZT " reorders, grew " CPL_FMT_SZT " times to " CPL_FMT_SZT "\n",
+			received, drops, elements, errors, grows, queue.size());
+
+		return !errors && !lost && queue.size() <= maxSize;
+	}
+
+	bool AudioStreamHistoryStallTest(std::size_t slowReaders, double holdMs, DiagnosticLevel lvl)
+	{
+		typedef AudioStream<float, 64> Stream;
+
+		auto io = Stream::create(true, 64, 4096);
+		auto& output = std::get<1>(io);
+
+		output->modifyConsumerInfo([](auto& info) {
+			info.storeAudioHistory = true;
+			info.blockOnHistoryBuffer = true;
+			info.audioHistorySize = 1 << 14;
+			info.audioHistoryCapacity = 1 << 15;
+		});
+
+		AudioStreamReplay<float, 64> replay(
+			std::move(std::get<0>(io)),
+			{ 2, 48000 },
+			AudioStreamReplay<float, 64>::generate(
+				[](float* const* channels, std::size_t numChannels, std::size_t numSamples, std::uint64_t position) {
+					for (std::size_t c = 0; c < numChannels; ++c)
+						for (std::size_t i = 0; i < numSamples; ++i)
+							channels[c][i] = static_cast<float>(std::sin(0.01 * (position + i)));
+				},
+				48000 * 2
+			),
+			256
+		);
+
+		// the histogram is in processor clocks, so calibrate against the hold time
+		const auto hold = std::chrono::duration<double, std::milli>(holdMs);
+		const auto calibrationStart = Misc::ClockCounter();
+		std::this_thread::sleep_for(hold);
+		const double clocksPerMs = (Misc::ClockCounter() - calibrationStart) / holdMs;
+
+		std::atomic_bool quit{ false };
+		std::vector<std::thread> readers;
+
+		// readers pin the latest history and sit on it, staggered so they hold different snapshots
+		for (std::size_t r = 0; r < slowReaders; ++r)
+		{
+			readers.emplace_back([&, r] {
+				std::this_thread::sleep_for(hold * r / slowReaders);
+
+				while (!quit.load(std::memory_order_relaxed))
+				{
+					auto access = output->getAudioBufferViews();
+					std::this_thread::sleep_for(hold);
+				}
+			});
+		}
+
+		replay.run();
+		quit.store(true);
+
+		for (auto& reader : readers)
+			reader.join();
+
+		const auto merge = output->getTelemetry().consumerMerge;
+		const double maxMs = merge.max() / clocksPerMs;
+		const double p99Ms = merge.percentile(99) / clocksPerMs;
+
+		// with three snapshots, a single reader can never stall the writer. more than one can, for up to the hold time.
+		const bool stalled = slowReaders < 2 && maxMs > holdMs * 0.5;
+
+		dout(stalled ? warn : info, lvl, "HST: " CPL_FMT_SZT " readers holding history for %.2f ms, writer merge p99 %.3f ms, max %.3f ms\n",
+			slowReaders, holdMs, p99Ms, maxMs);
+
+		return !stalled;
+	}
+
+	/// <summary>
+	/// Every channel carries the sample index, offset by the channel, so listeners can tell exactly what arrived.
+	/// </summary>
+	struct CountingSignal
+	{
+		typedef AudioStream<float, 64> Stream;
+
+		static float at(std::uint64_t position, std::size_t channel)
+		{
+			return static_cast<float>(position % 65536 + channel);
+		}
+
+		static void fill(std::vector<std::vector<float>>& data, std::vector<const float*>& pointers, std::uint64_t position)
+		{
+			for (std::size_t c = 0; c < data.size(); ++c)
+			{
+				for (std::size_t i = 0; i < data[c].size(); ++i)
+					data[c][i] = at(position + i, c);
+
+				pointers[c] = data[c].data();
+			}
+		}
+
+		class Checker : public Stream::Listener
+		{
+		public:
+			virtual void onStreamAudio(Stream::ListenerContext&, float ** buffer, std::size_t channels, std::size_t numSamples) override
+			{
+				for (std::size_t c = 0; c < channels; ++c)
+				{
+					for (std::size_t i = 0; i < numSamples; ++i)
+					{
+						if (buffer[c][i] != at(position + i, c))
+							errors++;
+					}
+				}
+
+				position += numSamples;
+				received.store(position, std::memory_order_release);
+			}
+
+			std::uint64_t position = 0;
+			std::size_t errors = 0;
+			std::atomic<std::uint64_t> received{ 0 };
+		};
+	};
+
+	bool AudioStreamSlabTest(std::size_t numChannels, std::size_t blockSize, std::size_t blocks, DiagnosticLevel lvl)
+	{
+		typedef CountingSignal::Stream Stream;
+		typedef CountingSignal::Checker Checker;
+
+		std::vector<std::vector<float>> data(numChannels, std::vector<float>(blockSize));
+		std::vector<const float*> pointers(numChannels);
+		std::uint64_t cycles[2] = {};
+		bool success = true;
+
+		for (std::size_t mode = 0; mode < 2; ++mode)
+		{
+			const bool slabs = mode == 1;
+			// room for the eight blocks in flight below, even when every packet holds a single sample
+			auto io = Stream::create(true, 16 * blockSize, 16 * blockSize, slabs ? 16 * blockSize * numChannels : 0);
+			auto& input = std::get<0>(io);
+			auto& output = std::get<1>(io);
+			auto checker = std::make_shared<Checker>();
+
+			output->addListener(checker);
+
+			input.initializeInfo(
+				[&](auto& info)
+				{
+					info.channels = static_cast<std::uint32_t>(numChannels);
+					info.anticipatedSize = static_cast<std::uint32_t>(blockSize);
+					info.sampleRate = 192000;
+				}
+			);
+
+			auto playhead = Stream::Playhead::empty();
+			std::uint64_t sent = 0;
+
+			for (std::size_t b = 0; b < blocks; ++b)
+			{
+				CountingSignal::fill(data, pointers, sent);
+
+				const auto start = Misc::ClockCounter();
+				input.processIncomingRTAudio(pointers.data(), numChannels, blockSize, playhead);
+				cycles[mode] += Misc::ClockCounter() - start;
+
+				sent += blockSize;
+
+				// keep the consumer a few blocks behind, so neither the fifo nor the ring overflows
+				while (sent - checker->received.load(std::memory_order_acquire) > 8 * blockSize && output->getPerfMeasures().droppedFrames == 0)
+					std::this_thread::yield();
+			}
+
+			while (checker->received.load(std::memory_order_acquire) < sent && output->getPerfMeasures().droppedFrames == 0)
+				std::this_thread::yield();
+
+			const auto drops = output->getPerfMeasures().droppedFrames;
+			output->removeListener(checker);
+
+			const bool failed = checker->errors || drops || checker->position != sent;
+			success = success && !failed;
+
+			dout(failed ? warn : info, lvl, "SLT: %s: " CPL_FMT_SZT " channels x " CPL_FMT_SZT " samples, %.0f producer cycles per block, "
+				CPL_FMT_SZT " wrong samples, " CPL_FMT_SZT " dropped\n",
+				slabs ? "slabs  " : "packets", numChannels, blockSize, double(cycles[mode]) / blocks, checker->errors, static_cast<std::size_t>(drops));
+		}
+
+		// a slab is one copy and one queue operation per block, instead of one per packet
+		const bool slower = cycles[1] >= cycles[0];
+
+		dout(slower ? warn : info, lvl, "SLT: slabs take %.2fx the producer cycles of packets\n", double(cycles[1]) / cycles[0]);
+
+		return success && !slower;
+	}
+
+	template<typename T>
+	struct ResonatorTestInput
+	{
+		std::vector<T> channels[2];
+		const T* offset[2];
+
+		const T* operator[](std::size_t c) const { return offset[c]; }
+	};
+
+	/// <summary>
+	/// Runs a per-sample and a blocked instance of both resonators side by side, and returns the largest
+	/// difference between them relative to the peak magnitude of the per-sample results.
+	/// </summary>
+	template<typename T, typename V>
+	double ResonatorBlockRecurrenceError(double seconds, double sampleRate, bool complexResonator)
+	{
+		const std::size_t filters = 200, total = static_cast<std::size_t>(seconds * sampleRate);
+
+		ResonatorTestInput<T> input;
+		std::mt19937 rng(1);
+		std::normal_distribution<T> noise;
+
+		for (std::size_t c = 0; c < 2; ++c)
+		{
+			input.channels[c].resize(total);
+
+			for (std::size_t i = 0; i < total; ++i)
+				input.channels[c][i] = static_cast<T>(0.5 * std::sin(0.0123 * i * (c + 1)) + 0.5 * noise(rng));
+		}
+
+		std::vector<T> hz(filters);
+
+		for (std::size_t i = 0; i < filters; ++i)
+			hz[i] = static_cast<T>(20 * std::pow(1000.0, double(i) / filters));
+
+		typedef dsp::CComplexResonator<T, 2> Complex;
+		typename Complex::Constant serialConstant, blockConstant;
+		Complex serialComplex, blockComplex;
+		IIRResonator<T, 3> serialIIR, blockIIR;
+
+		if (complexResonator)
+		{
+			serialConstant.mapSystemHz(hz, filters, 3, static_cast<T>(sampleRate), false, 64, 8192);
+			blockConstant.mapSystemHz(hz, filters, 3, static_cast<T>(sampleRate), false, 64, 8192);
+			blockConstant.setBlockRecurrence(true);
+		}
+		else
+		{
+			for (auto resonator : { &serialIIR, &blockIIR })
+			{
+				resonator->setWindowSize(64, 8192);
+				resonator->mapSystemHz(hz, static_cast<int>(filters), sampleRate);
+			}
+
+			blockIIR.setBlockRecurrence(true);
+		}
+
+		double maxError = 0, peak = 0;
+		std::size_t position = 0, block = 509;
+
+		// odd block sizes leave remainders, so the per-sample tail of the blocked path is covered as well
+		while (position + block <= total)
+		{
+			input.offset[0] = input.channels[0].data() + position;
+			input.offset[1] = input.channels[1].data() + position;
+
+			if (complexResonator)
+			{
+				serialComplex.resonateRealDispatched(serialConstant, input, 2, block);
+				blockComplex.resonateRealDispatched(blockConstant, input, 2, block);
+
+				for (std::size_t c = 0; c < 2; ++c)
+				{
+					for (std::size_t i = 0; i < filters; ++i)
+					{
+						const auto
+							serial = serialComplex.template getWindowedResonanceAt<dsp::WindowTypes::Hann>(serialConstant, i, c),
+							blocked = blockComplex.template getWindowedResonanceAt<dsp::WindowTypes::Hann>(blockConstant, i, c);
+
+						maxError = std::max<double>(maxError, std::abs(serial - blocked));
+						peak = std::max<double>(peak, std::abs(serial));
+					}
+				}
+			}
+			else
+			{
+				serialIIR.template wresonate<V>(input, 1, block);
+				blockIIR.template wresonate<V>(input, 1, block);
+
+				for (std::size_t z = 0; z < 3; ++z)
+				{
+					for (std::size_t i = 0; i < filters; ++i)
+					{
+						const std::complex<double>
+							serial(serialIIR.real[z][i], serialIIR.imag[z][i]),
+							blocked(blockIIR.real[z][i], blockIIR.imag[z][i]);
+
+						maxError = std::max(maxError, std::abs(serial - blocked));
+						peak = std::max(peak, std::abs(serial));
+					}
+				}
+			}
+
+			position += block;
+			block = block == 509 ? 512 : 509;
+		}
+
+		return peak > 0 ? maxError / peak : maxError;
+	}
+
+	bool ResonatorBlockRecurrenceTest(double seconds, DiagnosticLevel lvl)
+	{
+		struct Case
+		{
+			const char* name;
+			double error, bound;
+		};
+
+		const double sampleRate = 48000, samples = seconds * sampleRate;
+
+		// the complex resonator poles are inside the unit circle, so rounding differences decay and the bounds hold for any length.
+		// the oscillators of the IIR resonator are undamped, and rotating by a rounded p or a rounded p^K makes the phases
+		// drift apart by up to an epsilon per sample, so those bounds grow with the length.
+		const Case cases[] =
+		{
+			{ "CComplexResonator<float>", ResonatorBlockRecurrenceError<float, Types::v4sf>(seconds, sampleRate, true), 5e-4 },
+			{ "CComplexResonator<double>", ResonatorBlockRecurrenceError<double, Types::v2sd>(seconds, sampleRate, true), 1e-12 },
+			{ "IIRResonator<float>", ResonatorBlockRecurrenceError<float, Types::v4sf>(seconds, sampleRate, false), samples * std::numeric_limits<float>::epsilon() },
+			{ "IIRResonator<double>", ResonatorBlockRecurrenceError<double, Types::v2sd>(seconds, sampleRate, false), samples * std::numeric_limits<double>::epsilon() },
+		};
+
+		bool success = true;
+
+		for (auto& c : cases)
+		{
+			const bool failed = !(c.error <= c.bound);
+			success = success && !failed;
+
+			dout(failed ? warn : info, lvl, "RBT: %s, %.1f s: blocked vs per-sample max error / peak %.3e (bound %.1e)\n",
+				c.name, seconds, c.error, c.bound);
+		}
+
+		return success;
+	}
+
+	bool CBlockingQueueTest(std::size_t elements, DiagnosticLevel lvl)
+	{
+		typedef CBlockingLockFreeQueueMovable<std::uint64_t> Queue;
+
+		std::uint64_t batch[64];
+		std::size_t errors = 0;
+
+		// pops everything until the queue is released, checking the order
+		auto drain = [&](Queue& queue, std::uint64_t& expected)
+		{
+			while (const auto count = queue.popElementsBlocking(batch, 64))
+			{
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					if (batch[i] != expected++)
+						errors++;
+				}
+			}
+		};
+
+		// a producer that is ahead of its consumer never enters the kernel
+		Queue ahead(elements, elements);
+
+		for (std::uint64_t i = 0; i < elements; ++i)
+			ahead.pushElement(std::uint64_t(i));
+
+		const auto aheadSignals = ahead.kernelSignals();
+		std::uint64_t aheadExpected = 0;
+		ahead.releaseConsumer();
+		drain(ahead, aheadExpected);
+
+		// concurrently, the consumer parks whenever it catches up
+		Queue queue(1024, 1024);
+		std::uint64_t expected = 0;
+
+		std::thread producer([&] {
+			for (std::uint64_t i = 0; i < elements; ++i)
+			{
+				while (!queue.pushElement(std::uint64_t(i)))
+					std::this_thread::yield();
+			}
+
+			queue.releaseConsumer();
+		});
+
+		drain(queue, expected);
+		producer.join();
+
+		// every release is reported once, after which the queue works as before
+		std::uint64_t tail = expected;
+		queue.pushElement(std::uint64_t(tail + 0));
+		queue.pushElement(std::uint64_t(tail + 1));
+		queue.releaseConsumer();
+		const auto beforeRelease = queue.popElementsBlocking(batch, 64);
+		const auto release = queue.popElementsBlocking(batch, 64);
+		queue.pushElement(std::uint64_t(tail + 2));
+		const auto afterRelease = queue.popElementsBlocking(batch, 64);
+
+		const bool releases = beforeRelease == 2 && release == 0 && afterRelease == 1 && batch[0] == tail + 2;
+		const bool lost = aheadExpected != elements || expected != elements;
+
+		dout(errors || lost || aheadSignals || !releases ? warn : info, lvl, "BQT: " CPL_FMT_SZT " kernel signals per million pushes to a parking consumer, "
+			CPL_FMT_SZT " ahead of it, " CPL_FMT_SZT " reorders, releases %s\n",
+			static_cast<std::size_t>(queue.kernelSignals() * 1000000.0 / elements), aheadSignals, errors, releases ? "reported once" : "broken");
+
+		return !errors && !lost && !aheadSignals && releases;
+	}
+
+	bool CFIFOEventSystemTest(std::size_t messages, DiagnosticLevel lvl)
+	{
+		struct Update
+		{
+			std::uint32_t key;
+			std::uint64_t value;
+		};
+
+		struct KeyOf
+		{
+			std::uint32_t operator()(const Update& u) const { return u.key; }
+		};
+
+		const std::uint32_t keys = 16;
+		bool success = true;
+
+		// posts every message and destroys the system right away, which must still deliver all of them.
+		auto run = [&](const char* name, std::size_t batchSize, bool coalesce)
+		{
+			struct Listener : CFIFOEventSystem<Update, KeyOf>::AsyncEventListener, CFIFOEventSystem<Update>::AsyncEventListener
+			{
+				void onAsyncMessageEvent(Update& u) override
+				{
+					if (u.value < latest[u.key] || (!coalesce && u.value != next))
+						errors++;
+
+					latest[u.key] = u.value;
+					next = u.value + 1;
+					received++;
+				}
+
+				bool coalesce = false;
+				std::uint64_t next = 0, latest[keys] = {};
+				std::size_t errors = 0, received = 0;
+			} listener;
+
+			listener.coalesce = coalesce;
+
+			std::vector<Update> updates(batchSize);
+			std::size_t wakeups = 0;
+
+			auto post = [&](auto& system)
+			{
+				for (std::size_t sent = 0; sent < messages; )
+				{
+					const auto count = std::min(batchSize, messages - sent);
+
+					// let the consumer go idle, so the last messages are still queued when it's told to stop
+					if (sent + count == messages)
+						std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+					for (std::size_t i = 0; i < count; ++i)
+						updates[i] = { static_cast<std::uint32_t>((sent + i) % keys), sent + i };
+
+					// the queue is bounded, so wait for the consumer when it's full
+					for (std::size_t posted = 0; posted < count; std::this_thread::yield())
+						posted += batchSize == 1 ? system.postMessage(updates[0]) : system.postMessages(updates.data() + posted, count - posted);
+
+					sent += count;
+				}
+
+				wakeups = system.wakeups();
+			};
+
+			const auto start = std::chrono::steady_clock::now();
+
+			if (coalesce)
+			{
+				CFIFOEventSystem<Update, KeyOf> system(listener, 4096);
+				post(system);
+			}
+			else
+			{
+				CFIFOEventSystem<Update> system(listener, 4096);
+				post(system);
+			}
+
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			// the last messages of every key are delivered, even if they were coalesced
+			bool lost = coalesce ? listener.received > messages : listener.received != messages;
+
+			for (std::uint32_t k = 0; k < keys; ++k)
+				lost = lost || listener.latest[k] != messages - 1 - (messages - 1 - k) % keys;
+
+			success = success && !lost && !listener.errors;
+
+			dout(lost || listener.errors ? warn : info, lvl, "FET: %s: %.2f M messages/s, " CPL_FMT_SZT " delivered, " CPL_FMT_SZT " wakeups (%.0f / s), " CPL_FMT_SZT " out of order\n",
+				name, messages / seconds * 1e-6, listener.received, wakeups, wakeups / seconds, listener.errors);
+		};
+
+		run("single  ", 1, false);
+		run("batched ", 64, false);
+		run("coalesce", 64, true);
+
+		return success;
+	}
+
+	bool JobSystemScalingTest(std::size_t jobs, DiagnosticLevel lvl)
+	{
+		const std::size_t parents = 64, children = std::max<std::size_t>(jobs / parents, 1);
+		const std::size_t maxWorkers = std::max(4u, std::thread::hardware_concurrency());
+
+		JobSystem system(1);
+
+		// parents are scheduled from outside, and fan out to children pushed on the local deques of the workers
+		auto round = [&]
+		{
+			std::vector<JobSystem::Result<std::uint64_t>> results;
+
+			for (std::size_t p = 0; p < parents; ++p)
+			{
+				results.emplace_back(system.schedule([&system, p, children] {
+					std::vector<JobSystem::Result<std::uint64_t>> local;
+					local.reserve(children);
+
+					for (std::size_t c = 0; c < children; ++c)
+						local.emplace_back(system.schedule([n = p * children + c] { return static_cast<std::uint64_t>(n); }));
+
+					std::uint64_t sum = 0;
+
+					for (auto& child : local)
+						sum += child.complete();
+
+					return sum;
+				}));
+			}
+
+			std::uint64_t sum = 0;
+
+			for (auto& result : results)
+				sum += result.complete();
+
+			return sum;
+		};
+
+		const std::uint64_t total = parents * children, expected = total * (total - 1) / 2;
+		double baseline = 0;
+		bool success = true;
+
+		for (std::size_t workers = 1; workers <= maxWorkers; workers *= 2)
+		{
+			system.restart(workers);
+
+			const auto start = std::chrono::steady_clock::now();
+			const auto sum = round();
+			const double rate = (total + parents) / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			if (workers == 1)
+				baseline = rate;
+
+			success = success && sum == expected;
+
+			dout(sum != expected ? warn : info, lvl, "JSS: " CPL_FMT_SZT " workers: %.2f M jobs/s, %.2fx of one worker%s\n",
+				workers, rate * 1e-6, rate / baseline, sum != expected ? ", WRONG RESULT" : "");
+		}
+
+		// restarts racing each other must not join the same workers twice
+		std::thread first([&] { system.restart(2); }), second([&] { system.restart(2); });
+		first.join(); second.join();
+
+		const bool restarted = system.concurrency() == 2 && round() == expected;
+
+		dout(restarted ? info : warn, lvl, "JSS: concurrent restarts %s\n", restarted ? "succeeded" : "FAILED");
+
+		return success && restarted;
+	}
+
+	bool ParallelForTest(std::size_t n, DiagnosticLevel lvl)
+	{
+		// uneven, like resonators getting more expensive towards the top bins
+		auto work = [](std::size_t i)
+		{
+			double x = 1;
+
+			for (std::size_t k = 0; k < i / 4; ++k)
+				x = x * 1.0000001 + 1e-9;
+
+			return x;
+		};
+
+		std::vector<std::atomic_int> visits(n);
+		const std::size_t workers = JobSystem::getShared().concurrency() + 1;
+
+		// an equal split over the threads is what the earlier parallel_for did without parallel std algorithms
+		struct Split
+		{
+			const char* name;
+			std::size_t grain;
+		};
+
+		const Split splits[] =
+		{
+			{ "equal split  ", (n + workers - 1) / workers },
+			{ "default grain", 0 },
+			{ "grain of 16  ", 16 },
+		};
+
+		bool success = true;
+
+		for (auto& split : splits)
+		{
+			for (auto& v : visits)
+				v.store(0, std::memory_order_relaxed);
+
+			const auto start = std::chrono::steady_clock::now();
+			// the comparison is never true, but keeps the work from being optimized away
+			jobs::parallel_for(n, [&](std::size_t i) { visits[i] += 1 + (work(i) < 0); }, split.grain);
+			const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			const bool covered = std::all_of(visits.begin(), visits.end(), [](auto& v) { return v.load() == 1; });
+
+			// reductions must come out bit identical no matter how the chunks were scheduled
+			const auto reduce = [&] { return jobs::parallel_reduce(n, 0.0, work, std::plus<double>(), split.grain); };
+			const auto first = reduce();
+			const bool deterministic = first == reduce() && first == reduce();
+
+			success = success && covered && deterministic;
+
+			dout(covered && deterministic ? info : warn, lvl, "PFT: %s: " CPL_FMT_SZT " uneven indices on " CPL_FMT_SZT " threads in %.2f ms, %s, reduction %s\n",
+				split.name, n, workers, ms, covered ? "every index once" : "INDICES MISSED", deterministic ? "deterministic" : "NOT DETERMINISTIC");
+		}
+
+		return success;
+	}
+
+	bool AudioStreamFanOutTest(std::size_t blockSize, std::size_t blocks, DiagnosticLevel lvl)
+	{
+		typedef CountingSignal::Stream Stream;
+		typedef CountingSignal::Checker Checker;
+
+		const std::size_t numChannels = 2;
+		std::vector<std::vector<float>> data(numChannels, std::vector<float>(blockSize));
+		std::vector<const float*> pointers(numChannels);
+		bool success = true;
+
+		for (std::size_t listeners : { 1, 4, 16 })
+		{
+			double ms[2] = {};
+
+			for (std::size_t mode = 0; mode < 2; ++mode)
+			{
+				const bool concurrent = mode == 1;
+				auto io = Stream::create(true, 16 * blockSize, 16 * blockSize);
+				auto& input = std::get<0>(io);
+				auto& output = std::get<1>(io);
+
+				output->modifyConsumerInfo([&](auto& info) { info.concurrentListeners = concurrent; });
+
+				std::vector<std::shared_ptr<Checker>> checkers;
+
+				for (std::size_t l = 0; l < listeners; ++l)
+				{
+					checkers.emplace_back(std::make_shared<Checker>());
+					output->addListener(checkers.back());
+				}
+
+				input.initializeInfo(
+					[&](auto& info)
+					{
+						info.channels = static_cast<std::uint32_t>(numChannels);
+						info.anticipatedSize = static_cast<std::uint32_t>(blockSize);
+						info.sampleRate = 48000;
+					}
+				);
+
+				auto playhead = Stream::Playhead::empty();
+				std::uint64_t sent = 0;
+
+				auto slowest = [&]
+				{
+					std::uint64_t position = sent;
+
+					for (auto& checker : checkers)
+						position = std::min(position, checker->received.load(std::memory_order_acquire));
+
+					return position;
+				};
+
+				const auto start = std::chrono::steady_clock::now();
+
+				for (std::size_t b = 0; b < blocks; ++b)
+				{
+					CountingSignal::fill(data, pointers, sent);
+					input.processIncomingRTAudio(pointers.data(), numChannels, blockSize, playhead);
+					sent += blockSize;
+
+					// keep the listeners a few blocks behind, so the fifo never overflows
+					while (sent - slowest() > 8 * blockSize && output->getPerfMeasures().droppedFrames == 0)
+						std::this_thread::yield();
+				}
+
+				while (slowest() < sent && output->getPerfMeasures().droppedFrames == 0)
+					std::this_thread::yield();
+
+				ms[mode] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+				std::size_t errors = 0;
+
+				for (auto& checker : checkers)
+				{
+					errors += checker->errors + (checker->position != sent);
+					output->removeListener(checker);
+				}
+
+				const auto drops = output->getPerfMeasures().droppedFrames;
+				const bool failed = errors || drops;
+				success = success && !failed;
+
+				dout(failed ? warn : info, lvl, "FOT: %s, " CPL_FMT_SZT " listeners: %.3f ms per block, " CPL_FMT_SZT " errors, " CPL_FMT_SZT " dropped\n",
+					concurrent ? "concurrent" : "serial    ", listeners, ms[mode] / blocks, errors, static_cast<std::size_t>(drops));
+			}
+
+			dout(info, lvl, "FOT: " CPL_FMT_SZT " listeners: concurrent takes %.2fx the time of serial\n", listeners, ms[1] / ms[0]);
+		}
+
+		return success;
+	}
+
+	bool QueueBatchDrainTest(std::size_t elements, DiagnosticLevel lvl)
+	{
+		typedef CBlockingLockFreeQueueMovable<std::uint64_t> Queue;
+
+		std::vector<std::uint64_t> batch(128);
+		bool success = true;
+
+		// a batch of one is how the async audio loop drained before
+		for (std::size_t batchSize : { 1, 16, 128 })
+		{
+			Queue queue(1024, 1024);
+			std::uint64_t expected = 0;
+			std::size_t errors = 0, pops = 0;
+
+			const auto start = std::chrono::steady_clock::now();
+
+			std::thread producer([&] {
+				for (std::uint64_t i = 0; i < elements; ++i)
+				{
+					while (!queue.pushElement(std::uint64_t(i)))
+						std::this_thread::yield();
+				}
+
+				queue.releaseConsumer();
+			});
+
+			while (const auto count = queue.popElementsBlocking(batch.data(), batchSize))
+			{
+				pops++;
+
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					if (batch[i] != expected++)
+						errors++;
+				}
+			}
+
+			producer.join();
+
+			const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / elements;
+			const bool failed = errors || expected != elements;
+			success = success && !failed;
+
+			dout(failed ? warn : info, lvl, "BDT: batches of %3d: %.1f ns per element, %.1f elements per pop, " CPL_FMT_SZT " kernel signals per million, "
+				CPL_FMT_SZT " reorders, " CPL_FMT_SZT " lost\n", static_cast<int>(batchSize), ns, static_cast<double>(expected) / std::max<std::size_t>(pops, 1),
+				static_cast<std::size_t>(queue.kernelSignals() * 1000000.0 / elements), errors, static_cast<std::size_t>(elements - std::min<std::uint64_t>(expected, elements)));
+		}
+
+		return success;
+	}
+
+	bool InterleaveTest(std::size_t samples, DiagnosticLevel lvl)
+	{
+		// odd, so every kernel leaves a scalar tail
+		const std::size_t numSamples = samples | 3, offset = 5, rounds = 64;
+		bool success = true;
+
+		for (std::size_t channels = 1; channels <= 12; ++channels)
+		{
+			std::vector<float> interleaved(channels * numSamples), roundTrip(channels * numSamples);
+			std::vector<std::vector<float>> separate(channels, std::vector<float>(numSamples + offset));
+			std::vector<float*> pointers(channels);
+			std::size_t errors = 0;
+
+			for (std::size_t i = 0; i < interleaved.size(); ++i)
+				interleaved[i] = static_cast<float>(i);
+
+			for (std::size_t c = 0; c < channels; ++c)
+				pointers[c] = separate[c].data();
+
+			simd::deinterleave(interleaved.data(), channels, numSamples, pointers.data(), offset);
+
+			for (std::size_t c = 0; c < channels; ++c)
+			{
+				for (std::size_t n = 0; n < numSamples; ++n)
+					errors += separate[c][n + offset] != interleaved[n * channels + c];
+			}
+
+			for (std::size_t c = 0; c < channels; ++c)
+				pointers[c] = separate[c].data() + offset;
+
+			simd::interleave(pointers.data(), channels, numSamples, roundTrip.data());
+			errors += roundTrip != interleaved;
+
+			// every sample is read and written once per pass
+			const double bytes = 2.0 * sizeof(float) * channels * numSamples * rounds;
+
+			auto start = std::chrono::steady_clock::now();
+			for (std::size_t r = 0; r < rounds; ++r)
+				simd::deinterleave(interleaved.data(), channels, numSamples, pointers.data());
+			const double deinterleaveRate = bytes / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			start = std::chrono::steady_clock::now();
+			for (std::size_t r = 0; r < rounds; ++r)
+				simd::interleave(pointers.data(), channels, numSamples, roundTrip.data());
+			const double interleaveRate = bytes / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			// the scalar loops the kernels replaced
+			start = std::chrono::steady_clock::now();
+			for (std::size_t r = 0; r < rounds; ++r)
+			{
+				for (std::size_t c = 0; c < channels; ++c)
+				{
+					for (std::size_t n = 0; n < numSamples; ++n)
+						pointers[c][n] = interleaved[n * channels + c];
+				}
+			}
+			const double scalarRate = bytes / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			errors += roundTrip != interleaved;
+			success = success && !errors;
+
+			dout(errors ? warn : info, lvl, "ILT: %2d channels: deinterleave %.2f GB/s (scalar %.2f GB/s), interleave %.2f GB/s, " CPL_FMT_SZT " errors\n",
+				static_cast<int>(channels), deinterleaveRate * 1e-9, scalarRate * 1e-9, interleaveRate * 1e-9, errors);
+		}
+
+		return success;
+	}
+
+	bool MPMCQueueTest(std::size_t elements, DiagnosticLevel lvl)
+	{
+		struct LockFree
+		{
+			LockFree(std::size_t initialSize, std::size_t maxSize, bool grows) : queue(initialSize, maxSize), grows(grows) {}
+
+			bool push(std::uint64_t value) { return grows ? queue.pushElement<true>(value) : queue.pushElement(value); }
+			bool pop(std::uint64_t& value) { return queue.popElement(value); }
+
+			CLockFreeMPMCQueue<std::uint64_t> queue;
+			bool grows;
+		};
+
+		// what several producers end up behind without the queue
+		struct Locked
+		{
+			Locked(std::size_t maxSize) : maxSize(maxSize) {}
+
+			bool push(std::uint64_t value)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				if (queue.size() == maxSize)
+					return false;
+
+				queue.push_back(value);
+				return true;
+			}
+
+			bool pop(std::uint64_t& value)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				if (queue.empty())
+					return false;
+
+				value = queue.front();
+				queue.pop_front();
+				return true;
+			}
+
+			std::mutex mutex;
+			std::deque<std::uint64_t> queue;
+			std::size_t maxSize;
+		};
+
+		bool success = true;
+
+		// every element is tagged with its producer, and must arrive exactly once and, per consumer, in the order its producer pushed it
+		auto run = [&](auto& queue, const char* name, std::size_t producers, std::size_t consumers)
+		{
+			const std::size_t perProducer = elements / producers, total = perProducer * producers;
+			std::vector<std::atomic<std::uint8_t>> visits(total);
+			std::atomic<std::size_t> consumed{ 0 }, reorders{ 0 };
+			std::vector<std::thread> threads;
+
+			const auto start = std::chrono::steady_clock::now();
+
+			for (std::size_t p = 0; p < producers; ++p)
+			{
+				threads.emplace_back([&, p] {
+					for (std::uint64_t i = 0; i < perProducer; ++i)
+					{
+						while (!queue.push((std::uint64_t(p) << 32) | i))
+							std::this_thread::yield();
+					}
+				});
+			}
+
+			for (std::size_t c = 0; c < consumers; ++c)
+			{
+				threads.emplace_back([&] {
+					std::vector<std::int64_t> last(producers, -1);
+					std::uint64_t value;
+
+					while (consumed.load(std::memory_order_relaxed) < total)
+					{
+						if (!queue.pop(value))
+						{
+							std::this_thread::yield();
+							continue;
+						}
+
+						const auto producer = static_cast<std::size_t>(value >> 32);
+						const auto index = static_cast<std::int64_t>(value & 0xFFFFFFFF);
+
+						if (index <= last[producer])
+							reorders++;
+
+						last[producer] = index;
+						visits[producer * perProducer + index]++;
+						consumed++;
+					}
+				});
+			}
+
+			for (auto& t : threads)
+				t.join();
+
+			const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / total;
+			const auto wrong = std::count_if(visits.begin(), visits.end(), [](auto& v) { return v.load() != 1; });
+			const bool failed = wrong || reorders;
+			success = success && !failed;
+
+			dout(failed ? warn : info, lvl, "MPT: %s, " CPL_FMT_SZT " producers, " CPL_FMT_SZT " consumers: %.1f ns per element, "
+				CPL_FMT_SZT " lost or duplicated, " CPL_FMT_SZT " reorders\n", name, producers, consumers, ns, static_cast<std::size_t>(wrong), reorders.load());
+
+			return ns;
+		};
+
+		for (std::size_t threads : { 1, 2, 4 })
+		{
+			LockFree lockFree(1024, 1024, false);
+			Locked locked(1024);
+
+			const double ratio = run(locked, "mutex    ", threads, threads) / run(lockFree, "lock free", threads, threads);
+
+			dout(info, lvl, "MPT: " CPL_FMT_SZT " producers and consumers: lock free is %.2fx as fast as the mutex\n", threads, ratio);
+		}
+
+		// producers growing the queue while consumers drain it
+		LockFree growing(16, 1 << 16, true);
+		run(growing, "growing  ", 4, 4);
+
+		const bool grew = growing.queue.size() > 16;
+		success = success && grew;
+
+		dout(grew ? info : warn, lvl, "MPT: grew from 16 to " CPL_FMT_SZT " elements\n", growing.queue.size());
+
+		return success;
+	}
+
+	bool PoolAllocatorTest(std::size_t operations, DiagnosticLevel lvl)
+	{
+		const std::size_t align = 16, workingSet = 4096;
+
+		std::mt19937 rng(1);
+		std::uniform_int_distribution<std::size_t> sizeDist(16, PoolAllocator::maxPooledSize);
+		std::uniform_int_distribution<std::size_t> slotDist(0, workingSet - 1);
+
+		std::vector<std::size_t> sizes(operations), slots(operations);
+
+		for (std::size_t i = 0; i < operations; ++i)
+		{
+			sizes[i] = sizeDist(rng);
+			slots[i] = slotDist(rng);
+		}
+
+		struct Allocator
+		{
+			const char* name;
+			std::function<void*(std::size_t)> alloc;
+			std::function<void(void*, std::size_t)> free;
+		};
+
+		const Allocator allocators[] =
+		{
+			{ "stack ", [](std::size_t bytes) { return ThreadAllocator::get().alloc(align, bytes); }, [](void* p, std::size_t) { ThreadAllocator::get().free(p); } },
+			{ "pool  ", [](std::size_t bytes) { return PoolAllocator::get().alloc(align, bytes); }, [](void* p, std::size_t bytes) { PoolAllocator::free(p, align, bytes); } },
+			{ "malloc", [](std::size_t bytes) { return std::malloc(bytes); }, [](void* p, std::size_t) { std::free(p); } },
+		};
+
+		std::size_t corruptions = 0;
+
+		// every block is stamped with its slot, which must be intact when it is freed
+		auto stamp = [](void* p, std::size_t bytes, std::size_t tag) { std::memset(p, static_cast<int>(tag & 0xFF), bytes); };
+		auto intact = [](const void* p, std::size_t bytes, std::size_t tag)
+		{
+			auto bytePointer = static_cast<const unsigned char*>(p);
+			return bytePointer[0] == (tag & 0xFF) && bytePointer[bytes - 1] == (tag & 0xFF);
+		};
+
+		// nested lifetimes in groups of four, which every allocator supports
+		for (auto& allocator : allocators)
+		{
+			void* group[4];
+			const auto start = std::chrono::steady_clock::now();
+
+			for (std::size_t i = 0; i + 4 <= operations; i += 4)
+			{
+				for (std::size_t k = 0; k < 4; ++k)
+				{
+					group[k] = allocator.alloc(sizes[i + k] / 4);
+					stamp(group[k], sizes[i + k] / 4, k);
+				}
+
+				for (std::size_t k = 4; k-- > 0;)
+				{
+					corruptions += !intact(group[k], sizes[i + k] / 4, k);
+					allocator.free(group[k], sizes[i + k] / 4);
+				}
+			}
+
+			const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / operations;
+			dout(info, lvl, "PAT: %s, nested lifetimes: %.1f ns per allocation and free\n", allocator.name, ns);
+		}
+
+		// random lifetimes over a working set, which the stack can't do
+		std::vector<void*> blocks(workingSet);
+		std::vector<std::size_t> blockSizes(workingSet);
+		std::size_t reserved[2] = {};
+
+		for (std::size_t round = 0; round < 2; ++round)
+		{
+			for (std::size_t a = 1; a < 3; ++a)
+			{
+				auto& allocator = allocators[a];
+				std::size_t liveBytes = 0, peakBytes = 0;
+
+				for (std::size_t s = 0; s < workingSet; ++s)
+				{
+					blockSizes[s] = sizes[s];
+					blocks[s] = allocator.alloc(blockSizes[s]);
+					stamp(blocks[s], blockSizes[s], s);
+					liveBytes += blockSizes[s];
+				}
+
+				const auto start = std::chrono::steady_clock::now();
+
+				for (std::size_t i = 0; i < operations; ++i)
+				{
+					const auto s = slots[i];
+
+					corruptions += !intact(blocks[s], blockSizes[s], s);
+					allocator.free(blocks[s], blockSizes[s]);
+					liveBytes -= blockSizes[s];
+
+					blockSizes[s] = sizes[i];
+					blocks[s] = allocator.alloc(blockSizes[s]);
+					stamp(blocks[s], blockSizes[s], s);
+					liveBytes += blockSizes[s];
+					peakBytes = std::max(peakBytes, liveBytes);
+				}
+
+				const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / operations;
+
+				if (a == 1)
+				{
+					reserved[round] = PoolAllocator::get().reservedBytes();
+
+					dout(info, lvl, "PAT: %s, random lifetimes: %.1f ns per allocation and free, " CPL_FMT_SZT " KiB reserved for a peak of " CPL_FMT_SZT " KiB live (%.2fx)\n",
+						allocator.name, ns, reserved[round] >> 10, peakBytes >> 10, static_cast<double>(reserved[round]) / peakBytes);
+				}
+				else
+				{
+					dout(info, lvl, "PAT: %s, random lifetimes: %.1f ns per allocation and free\n", allocator.name, ns);
+				}
+
+				for (std::size_t s = 0; s < workingSet; ++s)
+				{
+					corruptions += !intact(blocks[s], blockSizes[s], s);
+					allocator.free(blocks[s], blockSizes[s]);
+				}
+			}
+		}
+
+		// repeating the same pattern reuses the freed blocks
+		const bool reused = reserved[1] == reserved[0];
+
+		// blocks freed by another thread return to their owner
+		for (std::size_t s = 0; s < workingSet; ++s)
+		{
+			blocks[s] = PoolAllocator::get().alloc(align, sizes[s]);
+			stamp(blocks[s], sizes[s], s);
+		}
+
+		std::thread([&] {
+			for (std::size_t s = 0; s < workingSet; ++s)
+			{
+				corruptions += !intact(blocks[s], sizes[s], s);
+				PoolAllocator::free(blocks[s], align, sizes[s]);
+			}
+		}).join();
+
+		for (std::size_t s = 0; s < workingSet; ++s)
+			blocks[s] = PoolAllocator::get().alloc(align, sizes[s]);
+
+		const bool reclaimed = PoolAllocator::get().reservedBytes() == reserved[1];
+
+		for (std::size_t s = 0; s < workingSet; ++s)
+			PoolAllocator::free(blocks[s], align, sizes[s]);
+
+		// a polypool_ptr converted to a base still destroys and frees the derived object
+		struct Base { virtual ~Base() {} };
+		struct Derived : Base { Derived(int& destroyed) : destroyed(destroyed) {} ~Derived() { destroyed++; } int& destroyed; char padding[100]; };
+
+		int destroyed = 0;
+		{
+			polypool_ptr<Base> base = make_polypool<Derived>(destroyed);
+		}
+
+		const bool failed = corruptions || !reused || !reclaimed || destroyed != 1;
+
+		dout(failed ? warn : info, lvl, "PAT: " CPL_FMT_SZT " corrupted blocks, slabs %s on a repeat, remote frees %s, polypool_ptr to base %s\n",
+			corruptions, reused ? "reused" : "NOT REUSED", reclaimed ? "reclaimed" : "NOT RECLAIMED", destroyed == 1 ? "destroys the derived object" : "BROKEN");
+
+		return !failed;
+	}
+
+	/// <summary>
+	/// Bytes of the mapping containing address that are backed by transparent huge pages, or zero if unknown.
+	/// </summary>
+	static std::size_t hugePageBytes(const void* address)
+	{
+		std::size_t bytes = 0;
+#ifdef __linux__
+		std::ifstream smaps("/proc/self/smaps");
+		std::string line;
+		bool inside = false;
+		const auto target = reinterpret_cast<std::uintptr_t>(address);
+
+		while (std::getline(smaps, line))
+		{
+			unsigned long long start, end, kiloBytes;
+
+			if (std::sscanf(line.c_str(), "%llx-%llx ", &start, &end) == 2)
+				inside = target >= start && target < end;
+			else if (inside && std::sscanf(line.c_str(), "AnonHugePages: %llu kB", &kiloBytes) == 1)
+				bytes += static_cast<std::size_t>(kiloBytes) << 10;
+		}
+#else
+		(void)address;
+#endif
+		return bytes;
+	}
+
+	bool HugePageHistoryTest(std::size_t megaBytes, DiagnosticLevel lvl)
+	{
+		typedef std::uint32_t T;
+
+		const std::size_t size = (megaBytes << 20) / sizeof(T), strided = std::min<std::size_t>(size, 1 << 22), block = 1 << 16;
+		// crosses a 4 KiB page every read, and a 2 MiB page every few hundred
+		const std::size_t stride = 4099;
+
+		std::vector<T> counting(block), destination(strided);
+		bool success = true;
+
+		auto run = [&](auto& history, const char* name)
+		{
+			history.setStorageRequirements(size, size);
+			std::size_t errors = 0;
+
+			{
+				auto writer = history.createWriter();
+
+				for (std::size_t written = 0; written < size; written += block)
+				{
+					const auto count = std::min(block, size - written);
+					std::iota(counting.begin(), counting.begin() + count, static_cast<T>(written));
+					writer.copyIntoHead(counting.data(), count);
+				}
+			}
+
+			auto reader = history.createProxyView();
+			std::uint64_t sum = 0;
+
+			// biased index i holds i, the oldest element written
+			auto start = std::chrono::steady_clock::now();
+			reader.forEachSpan(
+				[&](const T* span, std::size_t count, std::size_t index)
+				{
+					for (std::size_t i = 0; i < count; ++i)
+					{
+						sum += span[i];
+						errors += span[i] != static_cast<T>(index + i);
+					}
+				}
+			);
+			const double sequential = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / size;
+
+			start = std::chrono::steady_clock::now();
+			reader.copyStrided(destination.data(), strided, stride);
+			const double stridedTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / strided;
+
+			for (std::size_t i = 0; i < strided; ++i)
+				errors += destination[i] != static_cast<T>((i * stride) % size);
+
+			errors += sum != std::uint64_t(size) * (size - 1) / 2;
+			success = success && !errors;
+
+			dout(errors ? warn : info, lvl, "HPT: %s, " CPL_FMT_SZT " MiB history: sequential reads %.2f ns, strided reads %.2f ns per element, "
+				CPL_FMT_SZT " MiB in huge pages, " CPL_FMT_SZT " errors\n", name, megaBytes, sequential, stridedTime, hugePageBytes(reader.begin()) >> 20, errors);
+
+			return stridedTime;
+		};
+
+		double heap, huge;
+
+		{
+			CLIFOStream<T, 64> history;
+			heap = run(history, "heap      ");
+		}
+
+		{
+			CLIFOStream<T, 64, HugePageStorage<>> history;
+			huge = run(history, "huge pages");
+		}
+
+		dout(info, lvl, "HPT: strided reads from huge pages take %.2fx the time of the heap\n", huge / heap);
+
+		return success;
+	}
+
+	bool MirroredWindowTest(std::size_t windowSize, std::size_t windows, DiagnosticLevel lvl)
 	{
-		typedef float ftype;
+		// whole pages, so the mirrored stream can map it twice
+		const std::size_t size = 16 * windowSize;
+		// not a divisor of the size, so windows walk around the ring many times, wrapping at different points
+		const std::size_t hop = windowSize / 3 + 1;
+
+		std::vector<float> window(windowSize), scratch(windowSize), input(size);
+		std::vector<float> output[2] = { std::vector<float>(windowSize * windows), std::vector<float>(windowSize * windows) };
+
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> dist(-1, 1);
 
+		for (auto& x : input)
+			x = dist(rng);
 
+		for (std::size_t i = 0; i < windowSize; ++i)
+			window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2 * M_PI * i / (windowSize - 1)));
 
-		class LList : public cpl::CAudioStream<ftype, 128>::Listener
+		std::size_t errors = 0, copies = 0;
+		double us[2] = {};
+		bool mirrored = false;
+
+		auto run = [&](auto& history, std::size_t mode)
 		{
-		public:
-			virtual bool onRTAudio(const Stream & source, ftype ** buffer, std::size_t numChannels, std::size_t numSamples)  override
+			history.setStorageRequirements(size, size);
+
 			{
-				dout(verb, lvl, "AT: recieved %d realtime samples\n", numSamples);
-				rtc += numSamples;
-				return false;
-			};
-			/// <summary>
-			/// Called from a non real-time thread.
-			/// </summary>
-			virtual bool onAsyncAudio(const Stream & source, ftype ** buffer, std::size_t numChannels, std::size_t numSamples)  override
+				auto writer = history.createWriter();
+				// leaves the cursor away from the start
+				writer.copyIntoHead(input.data(), size / 2 + 7);
+				writer.copyIntoHead(input.data() + size / 2 + 7, size - size / 2 - 7);
+			}
+
+			auto reader = history.createProxyView();
+
+			if (mode == 0)
+				mirrored = reader.isMirrored();
+
+			const auto start = std::chrono::steady_clock::now();
+
+			for (std::size_t w = 0; w < windows; ++w)
+			{
+				const float* samples = reader.contiguous(w * hop, windowSize, scratch.data());
+				float* destination = output[mode].data() + w * windowSize;
+
+				copies += samples == scratch.data();
+
+				for (std::size_t i = 0; i < windowSize; ++i)
+					destination[i] = samples[i] * window[i];
+			}
+
+			us[mode] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / windows;
+
+			// against the ring read element by element
+			for (std::size_t w = 0; w < windows; ++w)
+			{
+				for (std::size_t i = 0; i < windowSize; ++i)
+					errors += output[mode][w * windowSize + i] != reader[(w * hop + i) % size] * window[i];
+			}
+		};
+
+		{
+			CLIFOStream<float, 64, MirroredStorage> history;
+			run(history, 0);
+		}
+
+		const auto mirroredCopies = copies;
+
+		{
+			CLIFOStream<float, 64> history;
+			run(history, 1);
+		}
+
+		errors += output[0] != output[1];
+
+		// where mirroring is supported, the ring must take it up and never copy
+		const bool supported = MirroredStorage::granularity<float>() != 0;
+		const bool failed = errors || (supported && (!mirrored || mirroredCopies));
+
+		dout(failed ? warn : info, lvl, "MWT: " CPL_FMT_SZT " sample Hann windows: %.2f us off the %s ring, %.2f us split (" CPL_FMT_SZT " copied), " CPL_FMT_SZT " errors\n",
+			windowSize, us[0], mirrored ? "mirrored" : "UNMIRRORED", us[1], copies - mirroredCopies, errors);
+
+		return !failed;
+	}
+
+	bool ResonatorWidthTest(std::size_t filters, std::size_t samples, DiagnosticLevel lvl)
+	{
+		typedef dsp::CComplexResonator<float, 2> Resonator;
+
+		const std::size_t block = 512;
+		const float sampleRate = 48000;
+
+		ResonatorTestInput<float> input;
+		std::mt19937 rng(1);
+		std::normal_distribution<float> noise;
+
+		for (std::size_t c = 0; c < 2; ++c)
+		{
+			input.channels[c].resize(samples);
+
+			for (auto& x : input.channels[c])
+				x = noise(rng);
+		}
+
+		std::vector<float> hz(filters);
+
+		for (std::size_t i = 0; i < filters; ++i)
+			hz[i] = static_cast<float>(20 * std::pow(1000.0, double(i) / filters));
+
+		struct Path
+		{
+			const char* name;
+			std::function<void(Resonator&, const Resonator::Constant&, std::size_t)> resonate;
+		};
+
+		std::vector<Path> paths =
+		{
+			{ "v4sf      ", [&](Resonator& r, const Resonator::Constant& c, std::size_t n) { r.resonateReal<Types::v4sf>(c, input, 2, n); } },
+		};
+
+#ifdef CPL_COMPILER_SUPPORTS_AVX
+		if (system::CProcessor::test(system::CProcessor::AVX))
+			paths.push_back({ "v8sf      ", [&](Resonator& r, const Resonator::Constant& c, std::size_t n) { r.resonateReal<Types::v8sf>(c, input, 2, n); } });
+#endif
+
+		paths.push_back({ "dispatched", [&](Resonator& r, const Resonator::Constant& c, std::size_t n) { r.resonateRealDispatched(c, input, 2, n); } });
+
+		dout(info, lvl, "RWT: dispatching to " CPL_FMT_SZT " floats per vector, %s\n",
+			simd::max_vector_capacity<float>(), system::CProcessor::test(system::CProcessor::FMA) ? "fused" : "not fused");
+
+		bool success = true;
+
+		for (std::size_t vectors : { 1, 3, 5 })
+		{
+			Resonator::Constant constant;
+			constant.mapSystemHz(hz, filters, vectors, sampleRate, false, 64, 8192);
+
+			std::vector<std::complex<float>> reference(2 * filters);
+			double baseline = 0;
+
+			for (std::size_t p = 0; p < paths.size(); ++p)
+			{
+				Resonator resonator;
+				const auto start = std::chrono::steady_clock::now();
+
+				for (std::size_t position = 0; position + block <= samples; position += block)
+				{
+					input.offset[0] = input.channels[0].data() + position;
+					input.offset[1] = input.channels[1].data() + position;
+					paths[p].resonate(resonator, constant, block);
+				}
+
+				const double rate = filters * (samples / block * block) / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+				if (p == 0)
+					baseline = rate;
+
+				// windows combining every vector, relative to the peak magnitude of the v4sf path
+				double error = 0, peak = 0;
+
+				for (std::size_t c = 0; c < 2; ++c)
+				{
+					for (std::size_t i = 0; i < filters; ++i)
+					{
+						const auto result = vectors == 1
+							? resonator.getWindowedResonanceAt<dsp::WindowTypes::Rectangular>(constant, i, c)
+							: resonator.getWindowedResonanceAt<dsp::WindowTypes::Hann>(constant, i, c);
+
+						if (p == 0)
+							reference[c * filters + i] = result;
+
+						error = std::max<double>(error, std::abs(result - reference[c * filters + i]));
+						peak = std::max<double>(peak, std::abs(reference[c * filters + i]));
+					}
+				}
+
+				error /= peak;
+
+				// only fused multiply-adds round differently
+				const bool failed = !(error <= 1e-4);
+				success = success && !failed;
+
+				dout(failed ? warn : info, lvl, "RWT: " CPL_FMT_SZT " vectors, %s: %.0f M resonator samples/s, %.2fx of v4sf, %.2g relative error\n",
+					vectors, paths[p].name, rate * 1e-6, rate / baseline, error);
+			}
+		}
+
+		return success;
+	}
+
+	bool ResonatorParallelTest(std::size_t filters, std::size_t samples, DiagnosticLevel lvl)
+	{
+		typedef dsp::CComplexResonator<float, 2> Resonator;
+
+		const std::size_t block = 512;
+
+		ResonatorTestInput<float> input;
+		std::mt19937 rng(1);
+		std::normal_distribution<float> noise;
+
+		for (std::size_t c = 0; c < 2; ++c)
+		{
+			input.channels[c].resize(samples);
+
+			for (auto& x : input.channels[c])
+				x = noise(rng);
+		}
+
+		std::vector<float> hz(filters);
+
+		for (std::size_t i = 0; i < filters; ++i)
+			hz[i] = static_cast<float>(20 * std::pow(1000.0, double(i) / filters));
+
+		Resonator::Constant constant;
+		constant.mapSystemHz(hz, filters, 3, 48000.0f, false, 64, 8192);
+
+		typedef std::function<void(Resonator&, std::size_t)> Resonate;
+
+		struct Mode
+		{
+			const char* name;
+			Resonate serial, parallel;
+		};
+
+		const Mode modes[] =
+		{
+			{
+				"real      ",
+				[&](Resonator& r, std::size_t n) { r.resonateReal<Types::v4sf>(constant, input, 2, n); },
+				[&](Resonator& r, std::size_t n) { r.resonateRealParallel<Types::v4sf>(constant, input, 2, n); }
+			},
+			{
+				"dispatched",
+				[&](Resonator& r, std::size_t n) { r.resonateRealDispatched(constant, input, 2, n); },
+				[&](Resonator& r, std::size_t n) { r.resonateRealDispatchedParallel(constant, input, 2, n); }
+			},
+			{
+				"complex   ",
+				[&](Resonator& r, std::size_t n) { r.resonateComplex<Types::v4sf>(constant, input, n); },
+				[&](Resonator& r, std::size_t n) { r.resonateComplexParallel<Types::v4sf>(constant, input, n); }
+			},
+		};
+
+		// returns resonator samples per second, and the windowed results of every filter
+		auto run = [&](const Resonate& resonate, std::vector<std::complex<float>>& results)
+		{
+			Resonator resonator;
+			const auto start = std::chrono::steady_clock::now();
+
+			for (std::size_t position = 0; position + block <= samples; position += block)
+			{
+				input.offset[0] = input.channels[0].data() + position;
+				input.offset[1] = input.channels[1].data() + position;
+				resonate(resonator, block);
+			}
+
+			const double rate = filters * (samples / block * block) / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			results.resize(2 * filters);
+
+			for (std::size_t c = 0; c < 2; ++c)
+			{
+				for (std::size_t i = 0; i < filters; ++i)
+					results[c * filters + i] = resonator.getWindowedResonanceAt<dsp::WindowTypes::Hann>(constant, i, c);
+			}
+
+			return rate;
+		};
+
+		auto& shared = JobSystem::getShared();
+		const std::size_t originalWorkers = shared.concurrency();
+		const std::size_t maxWorkers = std::max(4u, std::thread::hardware_concurrency());
+		std::vector<std::complex<float>> serialResults, parallelResults;
+		bool success = true;
+
+		for (auto& mode : modes)
+		{
+			const double serial = run(mode.serial, serialResults);
+
+			dout(info, lvl, "RPT: %s, serial   : %.0f M resonator samples/s\n", mode.name, serial * 1e-6);
+
+			for (std::size_t workers = 1; workers <= maxWorkers; workers *= 2)
+			{
+				shared.restart(workers);
+
+				const double parallel = run(mode.parallel, parallelResults);
+				// every resonator is independent, so nothing may change, not even rounding
+				const bool identical = serialResults == parallelResults;
+				success = success && identical;
+
+				dout(identical ? info : warn, lvl, "RPT: %s, " CPL_FMT_SZT " workers: %.0f M resonator samples/s, %.2fx of serial, %s\n",
+					mode.name, workers, parallel * 1e-6, parallel / serial, identical ? "bit-identical" : "DIFFERS FROM SERIAL");
+			}
+		}
+
+		shared.restart(originalWorkers);
+
+		return success;
+	}
+
+	template<typename Half>
+	bool HalfFloatConversionError(const char* name, const std::vector<float>& values, double bound, float smallestNormal, float largest, DiagnosticLevel lvl)
+	{
+		const std::size_t n = values.size(), rounds = 16;
+
+		std::vector<Half> bulk(n);
+		std::vector<float> expanded(n);
+		std::size_t mismatches = 0;
+		double error = 0;
+
+		simd::compress(values.data(), bulk.data(), n);
+		simd::expand(bulk.data(), expanded.data(), n);
+
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			// the vectorized kernels must agree with the scalar conversions bit for bit, and expanding must be exact
+			const Half scalar(values[i]);
+			mismatches += bulk[i].bits != scalar.bits || !(expanded[i] == static_cast<float>(scalar) || (std::isnan(expanded[i]) && std::isnan(values[i])));
+
+			const float magnitude = std::abs(values[i]);
+
+			if (magnitude >= smallestNormal && magnitude <= largest)
+				error = std::max(error, std::abs(double(expanded[i]) - values[i]) / magnitude);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		for (std::size_t r = 0; r < rounds; ++r)
+			simd::compress(values.data(), bulk.data(), n);
+		const double compressRate = n * rounds / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		start = std::chrono::steady_clock::now();
+		for (std::size_t r = 0; r < rounds; ++r)
+			simd::expand(bulk.data(), expanded.data(), n);
+		const double expandRate = n * rounds / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		const bool failed = mismatches || !(error <= bound);
+
+		dout(failed ? warn : info, lvl, "HFT: %s: compress %.2f G floats/s, expand %.2f G floats/s, relative error %.3g (bound %.3g), " CPL_FMT_SZT " mismatches\n",
+			name, compressRate * 1e-9, expandRate * 1e-9, error, bound, mismatches);
+
+		return !failed;
+	}
+
+	template<typename Element>
+	double HalfFloatWindowedState(dsp::CComplexResonator<float, 2>& resonator, const dsp::CComplexResonator<float, 2>::Constant& constant, std::size_t filters, std::vector<float>& magnitudes)
+	{
+		const std::size_t rounds = 100;
+		std::vector<Element> out(2 * filters);
+
+		const auto start = std::chrono::steady_clock::now();
+		for (std::size_t r = 0; r < rounds; ++r)
+			resonator.getWholeWindowedState<Types::v4sf>(constant, dsp::WindowTypes::Hann, out, 2, filters, dsp::CComplexResonator<float, 2>::WindowedOutput::Magnitude);
+		const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rounds;
+
+		magnitudes.assign(out.begin(), out.end());
+
+		return us;
+	}
+
+	bool HalfFloatTest(std::size_t filters, DiagnosticLevel lvl)
+	{
+		// magnitudes from 1e-9 to 1e6, both signs, and the special values
+		std::vector<float> values(1 << 20);
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> exponent(-9, 6);
+
+		for (std::size_t i = 0; i < values.size(); ++i)
+			values[i] = (i & 1 ? -1 : 1) * std::pow(10.0f, exponent(rng));
+
+		const float specials[] = { 0.0f, -0.0f, 65504.0f, 65520.0f, 6.1035156e-5f, 5.9604645e-8f, std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN() };
+		std::copy(std::begin(specials), std::end(specials), values.begin());
+
+		// rounding to nearest keeps half of the spacing of 11 and 8 significant bits
+		bool success = HalfFloatConversionError<simd::float16>("float16 ", values, std::ldexp(1.0, -11), 6.1035156e-5f, 65504.0f, lvl);
+		success = HalfFloatConversionError<simd::bfloat16>("bfloat16", values, std::ldexp(1.0, -8), std::numeric_limits<float>::min(), std::numeric_limits<float>::max(), lvl) && success;
+
+		typedef dsp::CComplexResonator<float, 2> Resonator;
+
+		ResonatorTestInput<float> input;
+		std::normal_distribution<float> noise;
+		const std::size_t samples = 1 << 14;
+
+		for (std::size_t c = 0; c < 2; ++c)
+		{
+			input.channels[c].resize(samples);
+
+			// quieter on the right, so the output spans more than a hundred dB
+			for (auto& x : input.channels[c])
+				x = noise(rng) * (c ? 1e-4f : 1.0f);
+
+			input.offset[c] = input.channels[c].data();
+		}
+
+		std::vector<float> hz(filters);
+
+		for (std::size_t i = 0; i < filters; ++i)
+			hz[i] = static_cast<float>(20 * std::pow(1000.0, double(i) / filters));
+
+		Resonator::Constant constant;
+		Resonator resonator;
+		constant.mapSystemHz(hz, filters, 3, 48000.0f, false, 64, 8192);
+		resonator.resonateReal<Types::v4sf>(constant, input, 2, samples);
+
+		std::vector<float> reference, halved;
+		const double floatTime = HalfFloatWindowedState<float>(resonator, constant, filters, reference);
+
+		// the largest error in dB where each format keeps its full precision
+		auto decibelError = [&](float floor)
+		{
+			double error = 0;
+
+			for (std::size_t i = 0; i < reference.size(); ++i)
+			{
+				if (reference[i] >= floor)
+					error = std::max(error, std::abs(20 * std::log10(double(halved[i]) / reference[i])));
+			}
+
+			return error;
+		};
+
+		const auto range = std::minmax_element(reference.begin(), reference.end());
+
+		dout(info, lvl, "HFT: " CPL_FMT_SZT " filters, stereo, from %.0f to %.0f dB: float output in %.1f us\n",
+			filters, 20 * std::log10(*range.first), 20 * std::log10(*range.second), floatTime);
+
+		const double float16Time = HalfFloatWindowedState<simd::float16>(resonator, constant, filters, halved);
+		const double float16Error = decibelError(6.1035156e-5f), float16Bound = 20 * std::log10(1 + std::ldexp(1.0, -11));
+
+		const double bfloat16Time = HalfFloatWindowedState<simd::bfloat16>(resonator, constant, filters, halved);
+		const double bfloat16Error = decibelError(std::numeric_limits<float>::min()), bfloat16Bound = 20 * std::log10(1 + std::ldexp(1.0, -8));
+
+		const bool float16Failed = !(float16Error <= float16Bound), bfloat16Failed = !(bfloat16Error <= bfloat16Bound);
+		success = success && !float16Failed && !bfloat16Failed;
+
+		dout(float16Failed ? warn : info, lvl, "HFT: float16  output in %.1f us, %.4f dB error above -84 dB (bound %.4f dB)\n", float16Time, float16Error, float16Bound);
+		dout(bfloat16Failed ? warn : info, lvl, "HFT: bfloat16 output in %.1f us, %.4f dB error (bound %.4f dB)\n", bfloat16Time, bfloat16Error, bfloat16Bound);
+
+		return success;
+	}
+
+	/// <summary>
+	/// Windows the state of a resonator in every format with the tap table kernel, and compares it to combining the
+	/// vectors of each resonator one by one through getWindowedResonanceAt(), timing both. Returns false on a mismatch.
+	/// </summary>
+	template<typename T, typename V, dsp::WindowTypes win>
+	bool WindowedStateError(const char* name, std::size_t vectors, std::size_t filters, double bound, DiagnosticLevel lvl)
+	{
+		typedef dsp::CComplexResonator<T, 2> Resonator;
+		typedef typename Resonator::WindowedOutput Format;
+
+		const std::size_t samples = 1 << 13, rounds = 20;
+
+		ResonatorTestInput<T> input;
+		std::mt19937 rng(1);
+		std::normal_distribution<T> noise;
+
+		for (std::size_t c = 0; c < 2; ++c)
+		{
+			input.channels[c].resize(samples);
+
+			for (auto& x : input.channels[c])
+				x = noise(rng);
+
+			input.offset[c] = input.channels[c].data();
+		}
+
+		std::vector<T> hz(filters);
+
+		for (std::size_t i = 0; i < filters; ++i)
+			hz[i] = static_cast<T>(20 * std::pow(1000.0, double(i) / filters));
+
+		typename Resonator::Constant constant;
+		Resonator resonator;
+		constant.mapSystemHz(hz, filters, vectors, T(48000), false, 64, 8192);
+		resonator.template resonateReal<V>(constant, input, 2, samples);
+
+		// the reference, also formatted one resonator at a time
+		std::vector<std::complex<T>> reference(2 * filters);
+		std::vector<T> formatted(2 * filters);
+		double peak = 0;
+
+		auto start = std::chrono::steady_clock::now();
+		for (std::size_t r = 0; r < rounds; ++r)
+		{
+			for (std::size_t c = 0; c < 2; ++c)
 			{
-				dout(verb, lvl, "AST: recieved %d async samples\n", numSamples);
+				for (std::size_t k = 0; k < filters; ++k)
+				{
+					reference[c * filters + k] = resonator.template getWindowedResonanceAt<win>(constant, k, c);
+					formatted[c * filters + k] = static_cast<T>(20 * std::log10(std::abs(reference[c * filters + k])));
+				}
+			}
+		}
+		const double referenceTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rounds;
+
+		for (auto& z : reference)
+			peak = std::max<double>(peak, std::abs(z));
+
+		const Format formats[] = { Format::Complex, Format::Magnitude, Format::Decibels, Format::Phase };
+		std::vector<T> out(4 * filters);
+		double times[4], errors[4] = {};
+		bool success = true;
+
+		for (std::size_t f = 0; f < 4; ++f)
+		{
+			start = std::chrono::steady_clock::now();
+			for (std::size_t r = 0; r < rounds; ++r)
+				resonator.template getWholeWindowedState<V>(constant, win, out, 2, filters, formats[f]);
+			times[f] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rounds;
+
+			for (std::size_t c = 0; c < 2; ++c)
+			{
+				for (std::size_t k = 0; k < filters; ++k)
+				{
+					const auto z = reference[c * filters + k];
+					const double magnitude = std::abs(z);
+					double error = 0;
+
+					switch (formats[f])
+					{
+						// relative to the peak
+						case Format::Complex:
+							error = std::abs(std::complex<double>(out[c * 2 * filters + k * 2], out[c * 2 * filters + k * 2 + 1]) - std::complex<double>(z)) / peak;
+							break;
+						case Format::Magnitude:
+							error = std::abs(out[c * filters + k] - magnitude) / peak;
+							break;
+						// in dB and radians, where the magnitude leaves them well defined
+						case Format::Decibels:
+							error = magnitude > peak * bound ? std::abs(out[c * filters + k] - 20 * std::log10(magnitude)) : 0;
+							break;
+						case Format::Phase:
+							error = magnitude > peak * bound ? std::abs(std::remainder(out[c * filters + k] - std::arg(std::complex<double>(z)), 2 * M_PI)) * magnitude / peak : 0;
+							break;
+					}
+
+					errors[f] = std::max(errors[f], error);
+				}
+			}
+
+			// dB are within 1e-4 of the exact logarithm, the rest within the rounding of T
+			const bool failed = !(errors[f] <= (formats[f] == Format::Decibels ? 1e-4 : bound));
+			success = success && !failed;
+		}
+
+		dout(success ? info : warn, lvl, "WST: %s, " CPL_FMT_SZT " vectors: reference %.1f us, table kernel %.1f / %.1f / %.1f / %.1f us (complex / magnitude / dB / phase), errors %.2g / %.2g / %.2g / %.2g\n",
+			name, vectors, referenceTime, times[0], times[1], times[2], times[3], errors[0], errors[1], errors[2], errors[3]);
+
+		return success;
+	}
+
+	bool WindowedStateTest(std::size_t filters, DiagnosticLevel lvl)
+	{
+		using dsp::WindowTypes;
+
+		// windows as wide as, narrower than and wider than the vectors, so the taps are centred and truncated
+		bool success = WindowedStateError<float, Types::v4sf, WindowTypes::Hann>("Hann, float v4sf        ", 3, filters, 1e-6, lvl);
+		success = WindowedStateError<float, Types::v4sf, WindowTypes::Rectangular>("Rectangular, float v4sf ", 3, filters, 1e-6, lvl) && success;
+		success = WindowedStateError<float, Types::v4sf, WindowTypes::FlatTop>("FlatTop, float v4sf     ", 9, filters, 1e-6, lvl) && success;
+		success = WindowedStateError<float, Types::v4sf, WindowTypes::FlatTop>("FlatTop, float v4sf     ", 5, filters, 1e-6, lvl) && success;
+		success = WindowedStateError<float, Types::v4sf, WindowTypes::Blackman>("Blackman, float v4sf    ", 9, filters, 1e-6, lvl) && success;
+#ifdef CPL_COMPILER_SUPPORTS_AVX
+		if (system::CProcessor::test(system::CProcessor::AVX))
+			success = WindowedStateError<float, Types::v8sf, WindowTypes::FlatTop>("FlatTop, float v8sf     ", 9, filters, 1e-6, lvl) && success;
+#endif
+		success = WindowedStateError<double, Types::v2sd, WindowTypes::Hann>("Hann, double v2sd       ", 3, filters, 1e-14, lvl) && success;
+
+		return success;
+	}
+
+	bool RunAutomatedTests(DiagnosticLevel lvl)
+	{
+		struct Test
+		{
+			const char* name;
+			std::function<bool()> run;
+		};
+
+		const Test tests[] =
+		{
+			{ "JobSystemAllocationTest", [&] { return JobSystemAllocationTest(10000, lvl); } },
+			{ "CSegmentedQueueTest", [&] { return CSegmentedQueueTest(1 << 24, lvl); } },
+			{ "AudioStreamHistoryStallTest", [&] { return AudioStreamHistoryStallTest(1, 5, lvl) && AudioStreamHistoryStallTest(2, 5, lvl); } },
+			{ "AudioStreamSlabTest", [&] { return AudioStreamSlabTest(8, 512, 2000, lvl); } },
+			{ "ResonatorBlockRecurrenceTest", [&] { return ResonatorBlockRecurrenceTest(20, lvl); } },
+			{ "CBlockingQueueTest", [&] { return CBlockingQueueTest(1 << 20, lvl); } },
+			{ "CFIFOEventSystemTest", [&] { return CFIFOEventSystemTest(1 << 20, lvl); } },
+			{ "JobSystemScalingTest", [&] { return JobSystemScalingTest(1 << 18, lvl); } },
+			{ "ParallelForTest", [&] { return ParallelForTest(1 << 12, lvl); } },
+			{ "AudioStreamFanOutTest", [&] { return AudioStreamFanOutTest(512, 500, lvl); } },
+			{ "QueueBatchDrainTest", [&] { return QueueBatchDrainTest(1 << 20, lvl); } },
+			{ "InterleaveTest", [&] { return InterleaveTest(1 << 14, lvl); } },
+			{ "MPMCQueueTest", [&] { return MPMCQueueTest(1 << 18, lvl); } },
+			{ "PoolAllocatorTest", [&] { return PoolAllocatorTest(1 << 20, lvl); } },
+			{ "HugePageHistoryTest", [&] { return HugePageHistoryTest(256, lvl); } },
+			{ "MirroredWindowTest", [&] { return MirroredWindowTest(4096, 1000, lvl); } },
+			{ "ResonatorWidthTest", [&] { return ResonatorWidthTest(2000, 1 << 15, lvl); } },
+			{ "ResonatorParallelTest", [&] { return ResonatorParallelTest(8192, 1 << 13, lvl); } },
+			{ "HalfFloatTest", [&] { return HalfFloatTest(4096, lvl); } },
+			{ "WindowedStateTest", [&] { return WindowedStateTest(4091, lvl); } },
+		};
+
+		std::size_t failures = 0;
+
+		for (auto& test : tests)
+		{
+			dout(info, lvl, "-- %s\n", test.name);
+
+			if (!test.run())
+			{
+				failures++;
+				dout(DiagnosticLevel::Errors, lvl, "-- %s FAILED\n", test.name);
+			}
+		}
+
+		dout(failures ? DiagnosticLevel::Errors : info, lvl, CPL_FMT_SZT " of " CPL_FMT_SZT " tests failed\n", failures, sizeof(tests) / sizeof(tests[0]));
+
+		return failures == 0;
+	}
+
+	bool CAudioStreamTest(std::size_t emulatedBufferSize, double sampleRate, DiagnosticLevel lvl)
+	{
+		typedef float ftype;
+		typedef AudioStream<ftype, 128> Stream;
+
+		class LList : public Stream::Listener
+		{
+		public:
+			virtual void onStreamAudio(Stream::ListenerContext&, ftype **, std::size_t, std::size_t numSamples) override
+			{
+				dout(verb, lvl, "AST: recieved " CPL_FMT_SZT " async samples\n", numSamples);
 				asc += numSamples;
-				return false;
 			};
 
 			std::size_t getACount()
 			{
 				return asc;
 			}
-			std::size_t getRTCount()
-			{
-				return rtc;
-			}
-			std::size_t rtc = 0, asc = 0;
+
+			std::atomic<std::size_t> asc{ 0 };
 
 			DiagnosticLevel lvl = DiagnosticLevel::None;
 		};
 
-		std::map<std::size_t, std::pair<LList, bool>> listeners;
-		LList permListener;
+		const std::size_t listenerTests = 300;
+		std::vector<std::pair<std::shared_ptr<LList>, bool>> listeners(listenerTests);
+		auto permListener = std::make_shared<LList>();
 		std::size_t count = 0;
-		std::size_t drops = 0;
-		std::size_t listenerTests = 300;
+		std::uint64_t drops = 0;
 
-		double msPerRender = emulatedBufferSize / sampleRate;
+		double msPerRender = 1000.0 * emulatedBufferSize / sampleRate;
 
 		{
-			cpl::CAudioStream<ftype, 128> stream(16, true, 10, 10000);
+			auto io = Stream::create(true, 10, 10000);
+			auto& input = std::get<0>(io);
+			auto& output = std::get<1>(io);
+
 			std::atomic_bool quit(false);
 			dout(info, lvl, "Press any key to quit - starting in 1000ms\n");
 			cpl::Misc::Delay(1000);
 
-			permListener.listenToSource(stream);
-			//permListener.lvl = warn;
+			output->addListener(permListener);
 
 			std::thread audioThread
 			(
 				[&]()
 			{
-
-				cpl::CAudioStream<ftype, 128>::AudioStreamInfo sinfo {};
-				sinfo.anticipatedChannels = 2;
-				sinfo.anticipatedSize = emulatedBufferSize;
-				sinfo.callAsyncListeners = true;
-				sinfo.callRTListeners = true;
-				sinfo.sampleRate = sampleRate;
-				sinfo.storeAudioHistory = true;
-				stream.initializeInfo(sinfo);
+				input.initializeInfo(
+					[&](auto& info)
+					{
+						info.channels = 2;
+						info.anticipatedSize = static_cast<std::uint32_t>(emulatedBufferSize);
+						info.sampleRate = sampleRate;
+					}
+				);
 
 				cpl::aligned_vector<ftype, 16> audioData[2];
-				ftype * buffers[2];
+				const ftype * buffers[2];
 				std::uint64_t prevDroppedFrames = 0;
+				auto playhead = Stream::Playhead::empty();
+
 				while (!quit)
 				{
-					auto size = sinfo.anticipatedSize + (std::rand() % 10) - 5;
+					auto size = emulatedBufferSize + (std::rand() % 10) - 5;
 					for (auto & ch : audioData)
 					{
 						ch.resize(size);
@@ -183,21 +2178,20 @@ namespace cpl
 					buffers[0] = audioData[0].data();
 					buffers[1] = audioData[1].data();
 
-					stream.processIncomingRTAudio(buffers, 2, size, cpl::CAudioStream<ftype, 128>::Playhead::empty());
-					auto newDrops = stream.getPerfMeasures().droppedAudioFrames - prevDroppedFrames;
-					const auto fsizef = stream.getASyncBufferSize();
+					input.processIncomingRTAudio(buffers, 2, size, playhead);
+					auto newDrops = output->getPerfMeasures().droppedFrames - prevDroppedFrames;
+					const auto fifo = input.getFifoUsage();
 					dout(newDrops > 0 ? warn : verb, lvl,
-						"AT: Sent " CPL_FMT_SZT " realtime samples - dropped %llu frames."
-						"Fifo size: " CPL_FMT_SZT " (" CPL_FMT_SZT "  bytes)\n",
-						size, newDrops,
-						fsizef, fsizef * stream.packetSize);
+						"AT: Sent " CPL_FMT_SZT " realtime samples - dropped %llu frames. "
+						"Fifo usage: " CPL_FMT_SZT " of " CPL_FMT_SZT "\n",
+						size, (unsigned long long)newDrops,
+						fifo.first, fifo.second);
 					prevDroppedFrames += newDrops;
 					count += size;
 
-
 					Misc::PreciseDelay(msPerRender);
 				}
-				drops = static_cast<std::size_t>(stream.getPerfMeasures().droppedAudioFrames);
+				drops = output->getPerfMeasures().droppedFrames;
 			}
 			);
 
@@ -209,25 +2203,30 @@ namespace cpl
 				{
 					std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
-					auto entry = std::rand() % listenerTests;
-					auto & listener = listeners[entry];
+					auto& listener = listeners[std::rand() % listenerTests];
 
 					if (listener.second)
 					{
-						if (!listener.first.detachFromSource())
-							dout(warn, lvl, "Unable to remove listener %d", entry);
-						else
-							listener.second = false;
+						output->removeListener(listener.first);
+						listener.second = false;
 					}
 					else
 					{
-						if (!listener.first.listenToSource(stream))
-							dout(warn, lvl, "Unable to add listener %d in 2 seconds", entry);
-						else
-							listener.second = true;
+						listener.first = std::make_shared<LList>();
+						output->addListener(listener.first);
+						listener.second = true;
 					}
 
-					stream.setAudioHistorySizeAndCapacity(std::rand() % 1000 + 100, std::rand() % 1000 + 1200);
+					const std::size_t capacity = std::rand() % 1000 + 1200;
+
+					output->modifyConsumerInfo(
+						[&](auto& info)
+						{
+							info.storeAudioHistory = true;
+							info.audioHistorySize = std::rand() % 1000 + 100;
+							info.audioHistoryCapacity = capacity;
+						}
+					);
 				}
 
 			}
@@ -239,9 +2238,9 @@ namespace cpl
 			audioThread.join();
 			listenerAdder.join();
 		}
-		dout(info, lvl, "Done...\nSent %d samples, recieved %d synchronuously, and %d asynchronuously (missing %d, dropped in total: %d).\n",
-			count, permListener.getRTCount(), permListener.getACount(),
-			count - permListener.getACount(), drops * (cpl::CAudioStream<ftype>::AudioFrame::capacity >> 1));
+
+		dout(info, lvl, "Done...\nSent " CPL_FMT_SZT " samples, recieved " CPL_FMT_SZT " asynchronuously (missing " CPL_FMT_SZT ", dropped frames: %llu).\n",
+			count, permListener->getACount(), count - permListener->getACount(), (unsigned long long)drops);
 
 		return true;
 	}
@@ -30,6 +30,8 @@
 #ifndef CPLTESTS_H
 #define CPLTESTS_H
 
+#include <cstddef>
+
 namespace cpl
 {
 
@@ -42,6 +44,140 @@ namespace cpl
 		All
 	};
 
+	/// <summary>
+	/// Runs every non-interactive test below with default arguments, returning false if any failed.
+	/// </summary>
+	bool RunAutomatedTests(DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Runs dependent and nested jobs until the JobSystem pools are warm, and then checks that
+	/// further rounds don't allocate on either the scheduling thread or the workers.
+	/// Requires CPL_TRAP_REALTIME_ALLOCATIONS.
+	/// </summary>
+	bool JobSystemAllocationTest(std::size_t rounds = 10000, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Hammers a CSegmentedQueue with a non-allocating producer and a stalling, growing consumer.
+	/// Checks that every element is either received in order or counted as dropped.
+	/// </summary>
+	bool CSegmentedQueueTest(std::size_t elements = 1 << 24, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Replays audio into an AudioStream with blockOnHistoryBuffer set, while slow readers hold on to history snapshots.
+	/// Reports how long the writer stalls, and fails if a single reader stalls it at all.
+	/// </summary>
+	bool AudioStreamHistoryStallTest(std::size_t slowReaders = 1, double holdMs = 5, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Streams a counting signal through an AudioStream with fixed-size packets, and again with slabs.
+	/// Fails if any sample arrives wrong or not at all, or if slabs cost the producer more cycles than packets.
+	/// </summary>
+	bool AudioStreamSlabTest(std::size_t numChannels = 8, std::size_t blockSize = 512, std::size_t blocks = 2000, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Runs CComplexResonator and IIRResonator in float and double over a long signal, with and without the block recurrence,
+	/// and fails if the blocked results drift further from the per-sample ones than rounding allows.
+	/// </summary>
+	bool ResonatorBlockRecurrenceTest(double seconds = 20, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Checks that pushes to a CBlockingLockFreeQueueMovable ahead of its consumer make no system calls, and counts them
+	/// for a consumer that keeps catching up and parking. Also checks ordering, and that every release is reported once.
+	/// </summary>
+	bool CBlockingQueueTest(std::size_t elements = 1 << 20, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Posts messages to a CFIFOEventSystem one at a time, in batches and coalesced by key, reporting messages and wakeups per second.
+	/// Fails if a message is lost, including those posted right before destruction, or delivered out of order.
+	/// </summary>
+	bool CFIFOEventSystemTest(std::size_t messages = 1 << 20, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Fans jobs out from a few parents over a JobSystem restarted with 1, 2, 4 ... workers, reporting jobs per second for each.
+	/// Fails if any result is wrong, or if concurrent restarts break the system.
+	/// </summary>
+	bool JobSystemScalingTest(std::size_t jobs = 1 << 18, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Times jobs::parallel_for over an uneven workload, split equally over the threads and with smaller grains.
+	/// Fails if an index isn't visited exactly once, or if jobs::parallel_reduce isn't deterministic.
+	/// </summary>
+	bool ParallelForTest(std::size_t n = 1 << 12, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Streams a counting signal to 1, 4 and 16 listeners, called serially and concurrently, reporting the time per block.
+	/// Fails if any listener misses a sample or receives a wrong one.
+	/// </summary>
+	bool AudioStreamFanOutTest(std::size_t blockSize = 512, std::size_t blocks = 500, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Drains a CBlockingLockFreeQueueMovable fed by another thread one element at a time and in batches of 16 and 128,
+	/// reporting the time per element and elements per pop. Fails if an element is lost or delivered out of order.
+	/// </summary>
+	bool QueueBatchDrainTest(std::size_t elements = 1 << 20, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Checks simd::deinterleave and simd::interleave against plain loops for 1 to 12 channels,
+	/// and reports their throughput in GB/s next to the scalar loop they replaced.
+	/// </summary>
+	bool InterleaveTest(std::size_t samples = 1 << 14, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Pushes and pops through a CLockFreeMPMCQueue and a mutex guarded deque from 1, 2 and 4 producers and consumers each,
+	/// reporting the time per element, and once more while the queue grows. Fails if an element is lost, duplicated,
+	/// or seen by a consumer out of its producer's order.
+	/// </summary>
+	bool MPMCQueueTest(std::size_t elements = 1 << 18, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Allocates with nested lifetimes from ThreadAllocator, PoolAllocator and malloc, and with random lifetimes from the latter two,
+	/// reporting the time per allocation and the slab memory reserved by the pool. Fails if a block is corrupted, if repeating
+	/// the same pattern or blocks freed by another thread don't reuse the slabs, or if a polypool_ptr to a base leaks the derived object.
+	/// </summary>
+	bool PoolAllocatorTest(std::size_t operations = 1 << 20, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Fills a CLIFOStream history of megaBytes from the heap and from HugePageStorage, and reports the time of sequential
+	/// and page-crossing strided reads over each, and how much is backed by huge pages. Fails if any element read back is wrong.
+	/// </summary>
+	bool HugePageHistoryTest(std::size_t megaBytes = 256, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Hann-windows overlapping windows, some of them wrapping, straight off a mirrored CLIFOStream and off a split one through a scratch copy,
+	/// reporting the time per window. Fails if the results differ from each other or from the ring read element by element,
+	/// or if a mirrored ring is available but not used.
+	/// </summary>
+	bool MirroredWindowTest(std::size_t windowSize = 4096, std::size_t windows = 1000, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Resonates stereo noise through CComplexResonator with 1, 3 and 5 vectors, using 4 and 8 wide floats and the
+	/// runtime dispatched path, and reports resonator samples per second. Fails if a path strays from the 4 wide results.
+	/// </summary>
+	bool ResonatorWidthTest(std::size_t filters = 2000, std::size_t samples = 1 << 15, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Resonates stereo noise through CComplexResonator serially and with the parallel modes on 1, 2, 4 and more workers
+	/// of the shared JobSystem, reporting resonator samples per second. Fails unless every parallel result is bit-identical to the serial one.
+	/// </summary>
+	bool ResonatorParallelTest(std::size_t filters = 8192, std::size_t samples = 1 << 13, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Converts floats spanning the ranges of simd::float16 and simd::bfloat16 in bulk, and windows the state of a CComplexResonator
+	/// into float, float16 and bfloat16 magnitudes, reporting the throughput and errors of each. Fails if the bulk conversions differ
+	/// from the scalar ones, or an error exceeds the rounding of the format.
+	/// </summary>
+	bool HalfFloatTest(std::size_t filters = 4096, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Windows the state of CComplexResonator into complex, magnitude, dB and phase outputs with the precomputed tap tables,
+	/// for windows as wide as, narrower and wider than the vectors, and reports the time of each next to combining the vectors
+	/// resonator by resonator. Fails if any output strays from that reference by more than the rounding of the type (1e-4 for dB).
+	/// </summary>
+	bool WindowedStateTest(std::size_t filters = 4091, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
+
+	/// <summary>
+	/// Interactive: streams random audio and churns listeners until a key is pressed.
+	/// </summary>
 	bool CAudioStreamTest(std::size_t emulatedBufferSize = 64, double sampleRate = 44100, DiagnosticLevel lvl = DiagnosticLevel::Warnings);
 
 };
@@ -24,6 +24,8 @@
 	file:JobSystem.h
 
 		A simple multi-dependency job system.
+		Each worker owns a work stealing deque, jobs scheduled or released from
+		a worker are pushed locally while other jobs go through a shared queue.
 
 		alternatively, https://github.com/vit-vit/ctpl
 
@@ -40,67 +42,264 @@
 #include <memory>
 #include <mutex>
 #include <future>
-#include <queue>
+#include <array>
+#include <cstddef>
+#include <new>
+#include <exception>
+#include <thread>
+#include <condition_variable>
 #include "lib/variable_array.h"
-
-#ifndef CPL_MAC
-#define CPL_HAVE_PAR_STD_ALGORITHMS
-#include <execution>
-#endif
+#include "lib/WorkStealingDeque.h"
 
 namespace cpl
 {
     class JobSystem
     {
-        struct BaseJob
+        struct Job;
+
+        /// <summary>
+        /// A link in a job's intrusive list of dependents, or in the free list when unused.
+        /// </summary>
+        struct Edge
+        {
+            Job* child;
+            Edge* next;
+        };
+
+        /// <summary>
+        /// A fixed-size, pooled and type erased job. Callables and results that fit are stored inline,
+        /// otherwise they're boxed on the heap.
+        /// A job is recycled once it has executed, and any Result referring to it is gone.
+        /// </summary>
+        struct Job
         {
+            static constexpr std::size_t callableCapacity = 64;
+            static constexpr std::size_t resultCapacity = 32;
+
             std::mutex graph;
+            std::condition_variable done;
             std::atomic_size_t parents;
-            virtual void execute(int lane) = 0;
-            virtual ~BaseJob() {}
+            /// <summary>
+            /// One for the pending execution, one for a live Result.
+            /// </summary>
+            std::atomic_int references;
+            JobSystem* owner;
+
+            // guarded by graph
+            std::uint32_t generation = 0;
+            Edge* children = nullptr;
+            /// <summary>
+            /// Written under graph, but may be polled without it.
+            /// </summary>
+            std::atomic_bool completed{ false };
+
+            /// <summary>
+            /// Link in either the free list or the shared queue.
+            /// </summary>
+            Job* next = nullptr;
+            void (*invoke)(Job&) = nullptr;
+            void (*destroyResult)(Job&) = nullptr;
+            std::exception_ptr exception;
+
+            alignas(std::max_align_t) unsigned char callable[callableCapacity];
+            alignas(std::max_align_t) unsigned char result[resultCapacity];
+        };
+
+        /// <summary>
+        /// Stores a T inside Capacity bytes if it fits, otherwise a pointer to a boxed T.
+        /// </summary>
+        template<typename T, std::size_t Capacity>
+        struct Inline
+        {
+            static constexpr bool fits = sizeof(T) <= Capacity && alignof(T) <= alignof(std::max_align_t);
+
+            template<typename... Args>
+            static void construct(void* where, Args&&... args)
+            {
+                if constexpr (fits)
+                    new (where) T(std::forward<Args>(args)...);
+                else
+                    *static_cast<T**>(where) = new T(std::forward<Args>(args)...);
+            }
+
+            static T& get(void* where) noexcept
+            {
+                if constexpr (fits)
+                    return *std::launder(static_cast<T*>(where));
+                else
+                    return **static_cast<T**>(where);
+            }
+
+            static void destroy(void* where) noexcept
+            {
+                if constexpr (fits)
+                    get(where).~T();
+                else
+                    delete *static_cast<T**>(where);
+            }
+        };
 
-            bool addDependent(std::shared_ptr<BaseJob> child)
+        /// <summary>
+        /// A free list of T's, allocated in growing chunks that are only released on destruction.
+        /// Every worker lane owns an unsynchronized cache, trading batches with a shared lock-free stack,
+        /// so workers don't contend on the pool in steady state. Other threads share a locked cache.
+        /// T must have a T* next member.
+        /// </summary>
+        template<typename T>
+        class Pool
+        {
+        public:
+
+            /// <summary>
+            /// Passed instead of a lane by threads that aren't workers of the owning system.
+            /// </summary>
+            static constexpr std::size_t external = static_cast<std::size_t>(-1);
+
+            ~Pool()
             {
-                std::lock_guard<std::mutex> lock(graph);
+                for (auto chunk : chunks)
+                    delete[] chunk;
+            }
+
+            /// <summary>
+            /// Sets the number of worker caches. Must only be called while no workers are running.
+            /// </summary>
+            void setLanes(std::size_t lanes)
+            {
+                for (auto& cache : caches)
+                    pushShared(cache.head);
+
+                caches.clear();
+                caches.resize(lanes);
+            }
 
-                if (!completed)
+            template<typename Init>
+            T* acquire(std::size_t lane, Init&& init)
+            {
+                if (lane == external)
                 {
-                    children.emplace_back(std::move(child));
-                    return true;
+                    std::lock_guard<std::mutex> lk(externalLock);
+                    return acquire(externalCache, init);
                 }
 
-                return false;
+                return acquire(caches[lane], init);
             }
 
-        protected:
-            std::vector<std::shared_ptr<BaseJob>> children;
-            bool completed{};
-        };
+            void release(std::size_t lane, T* element) noexcept
+            {
+                if (lane == external)
+                {
+                    std::lock_guard<std::mutex> lk(externalLock);
+                    release(externalCache, element);
+                }
+                else
+                {
+                    release(caches[lane], element);
+                }
+            }
 
-        template<typename R>
-        struct Job : public BaseJob
-        {
-            std::packaged_task<R()> fn;
+        private:
+
+            static constexpr std::size_t batchSize = 32;
+
+            struct alignas(64) Cache
+            {
+                T* head = nullptr;
+                /// <summary>
+                /// Released minus acquired since the last refill, a lower bound of the list length.
+                /// </summary>
+                std::size_t count = 0;
+            };
+
+            template<typename Init>
+            T* acquire(Cache& cache, Init& init)
+            {
+                if (!cache.head)
+                {
+                    // taking everything instead of popping one is immune to ABA
+                    cache.head = shared.exchange(nullptr, std::memory_order_acquire);
+                    cache.count = 0;
+
+                    if (!cache.head)
+                        cache.head = grow(init);
+                }
 
-            void execute(int lane) override
+                auto ret = cache.head;
+                cache.head = ret->next;
+                ret->next = nullptr;
+
+                if (cache.count > 0)
+                    cache.count--;
+
+                return ret;
+            }
+
+            void release(Cache& cache, T* element) noexcept
             {
-                std::lock_guard<std::mutex> lock(graph);
+                element->next = cache.head;
+                cache.head = element;
 
-                if (completed)
+                // return a batch, once the cache has a surplus of two
+                if (++cache.count < batchSize * 2)
                     return;
 
-                fn();
-                completed = true;
+                auto last = cache.head;
+
+                for (std::size_t i = 1; i < batchSize; ++i)
+                    last = last->next;
 
-                for (auto& j : children)
+                auto batch = cache.head;
+                cache.head = last->next;
+                last->next = nullptr;
+                cache.count -= batchSize;
+
+                pushShared(batch);
+            }
+
+            void pushShared(T* list) noexcept
+            {
+                if (!list)
+                    return;
+
+                auto last = list;
+
+                while (last->next)
+                    last = last->next;
+
+                auto top = shared.load(std::memory_order_relaxed);
+
+                do
                 {
-                    // we were the last parent?
-                    if (j->parents.fetch_sub(1) == 1)
-                    {
-                        j->execute(lane);
-                    }
+                    last->next = top;
+                } while (!shared.compare_exchange_weak(top, list, std::memory_order_release, std::memory_order_relaxed));
+            }
+
+            template<typename Init>
+            T* grow(Init& init)
+            {
+                std::lock_guard<std::mutex> lk(growthLock);
+
+                const std::size_t size = chunks.empty() ? 64 : chunkSize * 2;
+                auto chunk = new T[size];
+                chunks.push_back(chunk);
+                chunkSize = size;
+
+                for (std::size_t i = 0; i < size; ++i)
+                {
+                    init(chunk[i]);
+                    chunk[i].next = i + 1 < size ? &chunk[i + 1] : nullptr;
                 }
+
+                return chunk;
             }
+
+            std::vector<Cache> caches;
+            std::atomic<T*> shared{ nullptr };
+            std::mutex externalLock;
+            Cache externalCache;
+            std::mutex growthLock;
+            std::size_t chunkSize = 0;
+            std::vector<T*> chunks;
         };
 
     public:
@@ -112,17 +311,26 @@ namespace cpl
 
         ~JobSystem()
         {
+            std::lock_guard<std::mutex> lk(lifetimeMutex);
             shutdown();
         }
 
+        /// <summary>
+        /// A weak reference to a job, usable as a dependency.
+        /// Referring to a job that has completed is well defined.
+        /// </summary>
         struct Handle
         {
             friend class JobSystem;
 
         protected:
-            std::weak_ptr<BaseJob> job;
+            Job* job = nullptr;
+            std::uint32_t generation = 0;
         };
 
+        /// <summary>
+        /// The owning side of a scheduled job. Must not outlive the JobSystem it came from.
+        /// </summary>
         template<typename T>
         struct Result : public Handle
         {
@@ -130,13 +338,73 @@ namespace cpl
 
         public:
 
+            Result() = default;
+            Result(const Result&) = delete;
+            Result& operator = (const Result&) = delete;
+
+            Result(Result&& other) noexcept
+                : Handle(other)
+            {
+                other.job = nullptr;
+            }
+
+            Result& operator = (Result&& other) noexcept
+            {
+                if (this != &other)
+                {
+                    reset();
+                    static_cast<Handle&>(*this) = other;
+                    other.job = nullptr;
+                }
+
+                return *this;
+            }
+
+            ~Result()
+            {
+                reset();
+            }
+
+            /// <summary>
+            /// Waits for the job to complete, and returns its result or rethrows its exception.
+            /// Can only be called once.
+            /// </summary>
+            /// <remarks>
+            /// Called from a worker of the same system, the worker keeps executing other jobs while waiting.
+            /// </remarks>
             T complete()
             {
-                return result.get();
+                if (!job)
+                    throw std::future_error(std::future_errc::no_state);
+
+                job->owner->waitFor(job);
+
+                struct Release
+                {
+                    ~Release() { JobSystem::release(job); }
+                    Job* job;
+                } release{ job };
+
+                job = nullptr;
+
+                if (release.job->exception)
+                    std::rethrow_exception(release.job->exception);
+
+                if constexpr (std::is_void<T>::value)
+                    return;
+                else
+                    return std::move(Inline<T, Job::resultCapacity>::get(release.job->result));
             }
 
         private:
-            std::future<T> result;
+
+            void reset() noexcept
+            {
+                if (job)
+                    JobSystem::release(job);
+
+                job = nullptr;
+            }
         };
 
         template<typename... Handles>
@@ -145,49 +413,55 @@ namespace cpl
             return schedule([] {}, std::forward<Handles>(handles)...);
         }
 
+        /// <summary>
+        /// Schedules the callable to run once all the handles have completed.
+        /// Doesn't allocate, unless the pools need to grow or the callable / result doesn't fit inline.
+        /// </summary>
         template<class Callable, typename... Handles>
         auto schedule(Callable&& callable, Handles&&... handles)
         {
             std::array<Handle, sizeof...(Handles)> baseHandles{ handles... };
 
+            using F = std::decay_t<Callable>;
             using R = std::decay_t<decltype(callable())>;
 
-            auto job = std::make_shared<Job<R>>();
-            job->fn = std::packaged_task<R(void)>(std::move(callable));
-            job->parents = baseHandles.size();
+            auto job = jobPool.acquire(localLane(), [this](Job& j) { j.owner = this; });
+
+            Inline<F, Job::callableCapacity>::construct(job->callable, std::forward<Callable>(callable));
+            job->invoke = &invokeJob<F, R>;
+
+            if constexpr (!std::is_void<R>::value)
+                job->destroyResult = &destroyResult<R>;
+
+            job->references.store(2, std::memory_order_relaxed);
+            // one extra so the job can't be released while adding it to parents below
+            job->parents.store(baseHandles.size() + 1, std::memory_order_relaxed);
 
             Result<R> ret;
-            ret.result = job->fn.get_future();
+            ret.job = job;
+            ret.generation = job->generation;
 
-            bool hasAnyParents = false;
-            // prevent eager execution from parents during the execution of the following loop
+            for (auto& handle : baseHandles)
             {
-                std::lock_guard<std::mutex> executionLock(job->graph);
-
-                for (auto& handle : baseHandles)
-                {
-                    if (auto parent = handle.job.lock())
-                    {
-                        if (parent->addDependent(job))
-                        {
-                            hasAnyParents = true;
-                            continue;
-                        }
-                    }
-                    job->parents--;
-                }
+                if (!handle.job || !addDependent(*handle.job, handle.generation, job))
+                    job->parents.fetch_sub(1, std::memory_order_relaxed);
             }
 
-            if (!hasAnyParents)
+            if (job->parents.fetch_sub(1, std::memory_order_acq_rel) == 1)
             {
-                push(std::move(job));
+                push(job);
             }
 
             return ret;
         }
 
+        /// <summary>
+        /// Stops the workers, runs any jobs they left behind on this thread and starts workers anew.
+        /// Safe to call from several threads at once, but not from a worker of this system.
+        /// </summary>
         void restart(std::size_t workers)
         {
+            std::lock_guard<std::mutex> lk(lifetimeMutex);
             shutdown();
             start(workers);
         }
@@ -201,24 +475,177 @@ namespace cpl
 
     private:
 
+        template<typename F, typename R>
+        static void invokeJob(Job& job)
+        {
+            auto& f = Inline<F, Job::callableCapacity>::get(job.callable);
+
+            try
+            {
+                if constexpr (std::is_void<R>::value)
+                    f();
+                else
+                    Inline<R, Job::resultCapacity>::construct(job.result, f());
+            }
+            catch (...)
+            {
+                job.exception = std::current_exception();
+            }
+
+            // release captures as soon as possible
+            Inline<F, Job::callableCapacity>::destroy(job.callable);
+        }
+
+        template<typename R>
+        static void destroyResult(Job& job)
+        {
+            Inline<R, Job::resultCapacity>::destroy(job.result);
+        }
+
+        static void release(Job* job) noexcept
+        {
+            if (job->references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+
+            if (job->destroyResult && !job->exception)
+                job->destroyResult(*job);
+
+            job->exception = nullptr;
+            job->invoke = nullptr;
+            job->destroyResult = nullptr;
+
+            {
+                // invalidates any handles still referring to this job
+                std::lock_guard<std::mutex> lk(job->graph);
+                job->generation++;
+                job->completed = false;
+            }
+
+            job->owner->jobPool.release(job->owner->localLane(), job);
+        }
+
+        void waitFor(Job* job)
+        {
+            auto& worker = currentWorker();
+
+            if (worker.system == this)
+            {
+                // help instead of blocking, so nested waits can't starve the workers
+                while (!job->completed.load(std::memory_order_acquire))
+                {
+                    if (auto other = findWork(worker.lane))
+                        execute(other);
+                    else
+                        std::this_thread::yield();
+                }
+            }
+            else
+            {
+                std::unique_lock<std::mutex> lk(job->graph);
+                job->done.wait(lk, [job] { return job->completed.load(std::memory_order_relaxed); });
+            }
+        }
+
+        bool addDependent(Job& parent, std::uint32_t generation, Job* child)
+        {
+            std::lock_guard<std::mutex> lock(parent.graph);
+
+            if (parent.generation != generation || parent.completed)
+                return false;
+
+            auto edge = edgePool.acquire(localLane(), [](Edge&) {});
+            edge->child = child;
+            edge->next = parent.children;
+            parent.children = edge;
+
+            return true;
+        }
+
+        void execute(Job* job)
+        {
+            job->invoke(*job);
+
+            Edge* children;
+
+            {
+                std::lock_guard<std::mutex> lock(job->graph);
+                job->completed = true;
+                children = job->children;
+                job->children = nullptr;
+            }
+
+            job->done.notify_all();
+
+            const auto lane = localLane();
+
+            while (children)
+            {
+                auto edge = children;
+                children = edge->next;
+
+                // we were the last parent? push it onto our own deque,
+                // where it's likely to run next on the same (warm) lane unless stolen.
+                if (edge->child->parents.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    push(edge->child);
+
+                edgePool.release(lane, edge);
+            }
+
+            release(job);
+        }
+
+        struct WorkerContext
+        {
+            JobSystem* system = nullptr;
+            std::size_t lane = 0;
+        };
+
+        static WorkerContext& currentWorker() noexcept
+        {
+            static thread_local WorkerContext context;
+            return context;
+        }
+
+        /// <summary>
+        /// The calling thread's lane, if it's a worker of this system.
+        /// </summary>
+        std::size_t localLane() noexcept
+        {
+            auto& worker = currentWorker();
+            return worker.system == this ? worker.lane : Pool<Job>::external;
+        }
 
         void start(std::size_t workers)
         {
             quit = false;
 
+            jobPool.setLanes(workers);
+            edgePool.setLanes(workers);
+
+            deques.clear();
+
+            for (std::size_t i = 0; i < workers; ++i)
+                deques.emplace_back(std::make_unique<CWorkStealingDeque<Job*>>());
+
             for (std::size_t i = 0; i < workers; ++i)
             {
                 threads.emplace_back(&JobSystem::entry, this, i);
             }
 
-            cv.notify_all();
             nthreads.store(workers, std::memory_order_release);
         }
 
+        /// <summary>
+        /// Requires lifetimeMutex, so concurrent restarts are serialized instead of joining the same threads twice.
+        /// </summary>
         void shutdown()
         {
-            // TODO: concurrent shutdown?
-            quit = true;
+            {
+                std::lock_guard<std::mutex> lk(mutex);
+                quit = true;
+                wakeups++;
+            }
+
             cv.notify_all();
 
             for (auto& thread : threads)
@@ -226,59 +653,174 @@ namespace cpl
 
             threads.clear();
 
-            std::lock_guard<std::mutex> lk(mutex);
+            // no workers left, so this thread is the only one touching the deques.
+            // released children are injected, and drained here as well.
+            while (true)
+            {
+                Job* job = popInjected();
+
+                for (std::size_t i = 0; i < deques.size() && !job; ++i)
+                    job = deques[i]->steal();
+
+                if (!job)
+                    break;
+
+                execute(job);
+            }
 
-            while (!jobs.empty())
+            deques.clear();
+        }
+
+        void push(Job* job)
+        {
+            auto& worker = currentWorker();
+
+            if (worker.system == this)
             {
-                auto job = jobs.front();
-                job->execute(0);
-                jobs.pop();
+                deques[worker.lane]->push(job);
+
+                // pairs with the fence in idle(): either we see the sleeper, or it sees our job.
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                if (sleepers.load(std::memory_order_relaxed) > 0)
+                    wake();
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lk(mutex);
+                job->next = nullptr;
+
+                if (queueTail)
+                    queueTail->next = job;
+                else
+                    queueHead = job;
+
+                queueTail = job;
+                injected.fetch_add(1, std::memory_order_relaxed);
+
+                if (sleepers.load(std::memory_order_relaxed) > 0)
+                {
+                    wakeups++;
+                    cv.notify_one();
+                }
             }
         }
 
-        void push(std::shared_ptr<BaseJob> job)
+        void wake()
         {
-            std::lock_guard<std::mutex> lk(mutex);
-            jobs.push(std::move(job));
+            {
+                std::lock_guard<std::mutex> lk(mutex);
+                wakeups++;
+            }
 
             cv.notify_one();
         }
 
-        void entry(int lane)
+        Job* popInjected()
         {
-            std::unique_lock<std::mutex> lk(mutex);
+            if (injected.load(std::memory_order_relaxed) == 0)
+                return nullptr;
 
-            while (true)
+            std::lock_guard<std::mutex> lk(mutex);
+
+            auto job = queueHead;
+
+            if (!job)
+                return nullptr;
+
+            queueHead = job->next;
+
+            if (!queueHead)
+                queueTail = nullptr;
+
+            job->next = nullptr;
+            injected.fetch_sub(1, std::memory_order_relaxed);
+            return job;
+        }
+
+        Job* findWork(std::size_t lane)
+        {
+            if (auto job = deques[lane]->pop())
+                return job;
+
+            if (auto job = popInjected())
+                return job;
+
+            for (std::size_t i = 1; i < deques.size(); ++i)
             {
-                while (true)
-                {
-                    if (quit)
-                        return;
+                if (auto job = deques[(lane + i) % deques.size()]->steal())
+                    return job;
+            }
 
-                    if (jobs.size())
-                    {
-                        auto front = jobs.front();
-                        jobs.pop();
+            return nullptr;
+        }
 
-                        lk.unlock();
-                        front->execute(lane);
-                        lk.lock();
-                        continue;
-                    }
+        /// <summary>
+        /// Parks the worker, unless any work was published in the meantime.
+        /// Steals may fail spuriously, so the deques are checked for emptiness instead.
+        /// </summary>
+        void idle()
+        {
+            std::unique_lock<std::mutex> lk(mutex);
 
-                    break;
-                }
+            const auto observed = wakeups;
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            bool hasWork = quit || queueHead;
+
+            for (std::size_t i = 0; i < deques.size() && !hasWork; ++i)
+                hasWork = !deques[i]->empty();
 
-                cv.wait(lk, [this] { return quit || jobs.size(); });
+            if (!hasWork)
+                cv.wait(lk, [&] { return quit || wakeups != observed; });
+
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void entry(std::size_t lane)
+        {
+            auto& worker = currentWorker();
+            worker.system = this;
+            worker.lane = lane;
+
+            // spin a few rounds before parking, as parking and waking costs a lock on both ends
+            constexpr int spinRounds = 64;
+            int rounds = 0;
+
+            while (!quit.load(std::memory_order_acquire))
+            {
+                if (auto job = findWork(lane))
+                {
+                    execute(job);
+                    rounds = 0;
+                }
+                else if (++rounds < spinRounds)
+                {
+                    std::this_thread::yield();
+                }
+                else
+                {
+                    idle();
+                    rounds = 0;
+                }
             }
+
+            worker = {};
         }
 
         std::condition_variable cv;
-        std::mutex mutex;
-        std::queue<std::shared_ptr<BaseJob>> jobs;
+        std::mutex mutex, lifetimeMutex;
+        Job* queueHead = nullptr, * queueTail = nullptr;
+        std::vector<std::unique_ptr<CWorkStealingDeque<Job*>>> deques;
+        std::size_t wakeups = 0;
+        std::atomic_size_t injected{ 0 };
+        std::atomic_size_t sleepers{ 0 };
         std::atomic_bool quit{ false };
         std::vector<std::thread> threads;
         std::atomic_size_t nthreads;
+        Pool<Job> jobPool;
+        Pool<Edge> edgePool;
     };
 
     namespace jobs
@@ -298,60 +840,192 @@ namespace cpl
             return schedule([] {}, std::forward<Handles>(handles)...);
         }
 
+        namespace detail
+        {
+            inline std::size_t chunkCount(std::size_t n, std::size_t grain)
+            {
+                return (n + grain - 1) / grain;
+            }
+
+            /// <summary>
+            /// Splits [0, n) into fixed chunks of grain indices, that the caller and any helpers
+            /// claim dynamically until none are left. Lives on the caller's stack.
+            /// </summary>
+            template<class ChunkBody>
+            struct ChunkedRange
+            {
+                ChunkedRange(std::size_t n, std::size_t grain, ChunkBody& body)
+                    : n(n), grain(grain), chunks(chunkCount(n, grain)), body(body)
+                {
+
+                }
+
+                void run()
+                {
+                    while (true)
+                    {
+                        const auto chunk = next.fetch_add(1, std::memory_order_relaxed);
+
+                        if (chunk >= chunks)
+                            return;
+
+                        const auto begin = chunk * grain;
+
+                        try
+                        {
+                            body(chunk, begin, std::min(n, begin + grain));
+                        }
+                        catch (...)
+                        {
+                            // stop everyone else early
+                            next.store(chunks, std::memory_order_relaxed);
+                            throw;
+                        }
+                    }
+                }
+
+                const std::size_t n, grain, chunks;
+                ChunkBody& body;
+                std::atomic_size_t next{ 0 };
+            };
+
+            /// <summary>
+            /// Only depends on n, so reductions are deterministic for a given n.
+            /// </summary>
+            inline std::size_t defaultGrain(std::size_t n)
+            {
+                return std::max<std::size_t>(1, n / 256);
+            }
+
+            /// <summary>
+            /// Calls body(chunk, begin, end) for every chunk of [0, n), on the calling thread
+            /// and as many workers as useful. Returns once every chunk has completed.
+            /// Exceptions are propagated to the caller (the first one wins).
+            /// </summary>
+            template<class ChunkBody>
+            void run_chunks(std::size_t n, std::size_t grain, ChunkBody& body)
+            {
+                auto& system = JobSystem::getShared();
+                ChunkedRange<ChunkBody> range(n, grain, body);
+
+                const auto helpers = std::min(range.chunks - 1, system.concurrency());
+
+                if (helpers == 0)
+                {
+                    range.run();
+                    return;
+                }
+
+                cpl::variable_array<cpl::JobSystem::Result<void>> handles(
+                    helpers,
+                    [&](std::size_t)
+                    {
+                        return system.schedule([&range] { range.run(); });
+                    }
+                );
+
+                std::exception_ptr error;
+
+                try
+                {
+                    range.run();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+
+                // helpers refer to the range, so they have to be waited for regardless
+                for (auto& h : handles)
+                {
+                    try
+                    {
+                        h.complete();
+                    }
+                    catch (...)
+                    {
+                        if (!error)
+                            error = std::current_exception();
+                    }
+                }
+
+                if (error)
+                    std::rethrow_exception(error);
+            }
+        }
+
+        /// <summary>
+        /// Calls callable(begin, end) for consecutive ranges of at most grain indices covering [0, n).
+        /// The calling thread participates. A grain of 0 selects one based on n.
+        /// </summary>
         template<class Callable>
-        void parallel_for(std::size_t n, Callable&& callable)
+        void parallel_for_range(std::size_t n, Callable&& callable, std::size_t grain = 0)
         {
             if (n == 0)
                 return;
 
+            grain = grain ? grain : detail::defaultGrain(n);
+
+            auto body = [&](std::size_t, std::size_t begin, std::size_t end) { callable(begin, end); };
+            detail::run_chunks(n, grain, body);
+        }
+
+        /// <summary>
+        /// Calls callable(i) for every i in [0, n), see parallel_for_range().
+        /// </summary>
+        template<class Callable>
+        void parallel_for(std::size_t n, Callable&& callable, std::size_t grain = 0)
+        {
             if (n == 1)
             {
                 callable(0);
                 return;
             }
 
-#ifdef CPL_HAVE_PAR_STD_ALGORITHMS
+            parallel_for_range(
+                n,
+                [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t i = begin; i < end; ++i)
+                        callable(i);
+                },
+                grain
+            );
+        }
 
-            cpl::variable_array<std::size_t> ns(n, [](std::size_t i) { return i; });
+        /// <summary>
+        /// Folds combine(acc, body(i)) over [0, n) starting from identity.
+        /// Each chunk is folded in order, and the chunk results are then folded in order on the calling thread,
+        /// so the result is deterministic for a given n and grain regardless of the number of workers.
+        /// </summary>
+        template<typename T, class Body, class Combine>
+        T parallel_reduce(std::size_t n, T identity, Body&& body, Combine&& combine, std::size_t grain = 0)
+        {
+            if (n == 0)
+                return identity;
 
-            std::for_each(std::execution::par_unseq, ns.begin(), ns.end(), std::forward<Callable>(callable));
-#else
+            grain = grain ? grain : detail::defaultGrain(n);
 
-            auto& system = JobSystem::getShared();
-            auto hw = std::min(n, system.concurrency());
-            auto concurrency = std::max(static_cast<std::size_t>(1), n / hw);
-            auto remainder = n - hw * concurrency;
+            cpl::variable_array<T> partials(detail::chunkCount(n, grain), [&](std::size_t) { return identity; });
 
-            if (remainder == 0)
+            auto chunkBody = [&](std::size_t chunk, std::size_t begin, std::size_t end)
             {
-                remainder = concurrency;
-                hw--;
-            }
+                T acc = identity;
 
-            cpl::variable_array<cpl::JobSystem::Result<void>> handles(
-                hw, 
-                [&] (std::size_t i)
-                {
-                    return cpl::jobs::schedule(
-                        [&, i]
-                        {
-                            for (std::size_t c = 0; c < concurrency; ++c)
-                            {
-                                callable(i * concurrency + c);
-                            }
-                        }
-                    );
-                }
-            );
+                for (std::size_t i = begin; i < end; ++i)
+                    acc = combine(std::move(acc), body(i));
 
-            for (std::size_t c = 0; c < remainder; ++c)
-            {
-                callable(hw * concurrency + c);
-            }
+                partials[chunk] = std::move(acc);
+            };
 
-            for (auto& r : handles)
-                r.complete();
-#endif
+            detail::run_chunks(n, grain, chunkBody);
+
+            T result = std::move(identity);
+
+            for (auto& partial : partials)
+                result = combine(std::move(result), std::move(partial));
+
+            return result;
         }
     }
 
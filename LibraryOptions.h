@@ -36,6 +36,11 @@
 			(before user code in audio threads, async threads, opengl rendering etc.),
 			that will catch soft- and hardware exceptions, display messages and log
 			the exceptions with stacktraces etc.
+		#define CPL_TRAP_REALTIME_ALLOCATIONS
+			if set, replaces the global operator new / delete, so allocations
+			inside a Realtime::ScopedThread (like every audio callback of an
+			AudioStream) are counted, and optionally trapped.
+			See RealtimeGuard.h.
 
 *************************************************************************************/
 
@@ -50,6 +55,7 @@
 #endif
 //#define CPL_THROW_ON_NO_RESOURCE
 #define CPL_TRACEGUARD_ENTRYPOINTS
+//#define CPL_TRAP_REALTIME_ALLOCATIONS
 #ifdef CPL_WINDOWS
 #define CPL_MINIMUM_WINDOWS_SUPPORT NTDDI_WINXP
 #else
@@ -349,6 +349,24 @@
 		#define PACKED
 	#endif
 
+	// targets for code paths selected at runtime (see simd_isa.h). Flattening a targeted function
+	// pulls the generic code it calls into it, so that is compiled for the target as well.
+	#if defined(CPL_COMPILER_SUPPORTS_AVX) && (defined(__LLVM__) || defined(__GCC__))
+		#define CPL_COMPILER_SUPPORTS_AVX512
+		#define CPL_FMA_TARGET __attribute__((target("avx,fma")))
+		#define CPL_AVX512_TARGET __attribute__((target("avx512f,fma")))
+		#define CPL_F16C_TARGET __attribute__((target("avx,f16c")))
+		#define CPL_FLATTEN __attribute__((flatten))
+	#else
+		#if defined(CPL_MSVC) && _MSC_VER >= 1911
+			#define CPL_COMPILER_SUPPORTS_AVX512
+		#endif
+		#define CPL_FMA_TARGET
+		#define CPL_AVX512_TARGET
+		#define CPL_F16C_TARGET
+		#define CPL_FLATTEN
+	#endif
+
 	#ifdef CPL_REMOVE_CWARN
 		#undef cwarn
 
@@ -0,0 +1,180 @@
+/*************************************************************************************
+
+	cpl - cross-platform library - v. 0.1.0.
+
+	Copyright (C) 2023 Janus Lynggaard Thorborg (www.jthorborg.com)
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	See \licenses\ for additional details on licenses associated with this program.
+
+**************************************************************************************
+
+	file:RealtimeGuard.cpp
+
+		Implementation of RealtimeGuard.h, and the replaced global allocation
+		functions if CPL_TRAP_REALTIME_ALLOCATIONS is defined.
+
+*************************************************************************************/
+
+#include "RealtimeGuard.h"
+#include "MacroConstants.h"
+#include "Misc.h"
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace cpl
+{
+	namespace Realtime
+	{
+		static std::atomic<std::size_t> guardedAllocations{ 0 };
+		static std::atomic<bool> trapping{ false };
+
+		std::size_t allocationCount() noexcept
+		{
+			return guardedAllocations.load(std::memory_order_relaxed);
+		}
+
+		void setTrapping(bool shouldTrap) noexcept
+		{
+			trapping.store(shouldTrap, std::memory_order_relaxed);
+		}
+
+#ifdef CPL_TRAP_REALTIME_ALLOCATIONS
+		/// <summary>
+		/// CPL_ISDEBUGGED() without allocating. Misc::IsBeingDebugged() shells out to grep on Linux,
+		/// so the tracer is read from /proc/self/status into a stack buffer instead.
+		/// </summary>
+		static bool isDebugged() noexcept
+		{
+#ifdef __linux__
+			char status[4096];
+			const int fd = ::open("/proc/self/status", O_RDONLY | O_CLOEXEC);
+
+			if (fd == -1)
+				return false;
+
+			const auto length = ::read(fd, status, sizeof(status) - 1);
+			::close(fd);
+
+			if (length <= 0)
+				return false;
+
+			status[length] = '\0';
+
+			const char* tracer = std::strstr(status, "TracerPid:");
+
+			if (!tracer)
+				return false;
+
+			for (tracer += sizeof("TracerPid:") - 1; *tracer == ' ' || *tracer == '\t'; ++tracer);
+
+			return *tracer >= '1' && *tracer <= '9';
+#else
+			return CPL_ISDEBUGGED();
+#endif
+		}
+
+		static void checkAllocation(std::size_t size) noexcept
+		{
+			if (!isGuarded())
+				return;
+
+			guardedAllocations.fetch_add(1, std::memory_order_relaxed);
+
+			if (trapping.load(std::memory_order_relaxed))
+			{
+				// lift the guard while reporting, so nothing allocating below recurses back in here
+				ScopedAllocationAllowance reporting;
+
+				// stderr is unbuffered, so this doesn't allocate on its own
+				std::fprintf(stderr, "cpl: %zu byte global allocation on a realtime thread\n", size);
+
+				if (isDebugged())
+					DBG_BREAK();
+				else
+					std::abort();
+			}
+		}
+
+		static void* allocate(std::size_t size)
+		{
+			checkAllocation(size);
+
+			for (;;)
+			{
+				if (auto p = std::malloc(size ? size : 1))
+					return p;
+
+				if (auto handler = std::get_new_handler())
+					handler();
+				else
+					throw std::bad_alloc();
+			}
+		}
+
+		static void* allocateAligned(std::size_t size, std::align_val_t alignment)
+		{
+			checkAllocation(size);
+
+			for (;;)
+			{
+				if (auto p = cpl::Misc::alignedBytesMalloc(size ? size : 1, static_cast<std::size_t>(alignment)))
+					return p;
+
+				if (auto handler = std::get_new_handler())
+					handler();
+				else
+					throw std::bad_alloc();
+			}
+		}
+#endif
+	};
+};
+
+#ifdef CPL_TRAP_REALTIME_ALLOCATIONS
+
+void* operator new(std::size_t size) { return cpl::Realtime::allocate(size); }
+void* operator new[](std::size_t size) { return cpl::Realtime::allocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { try { return cpl::Realtime::allocate(size); } catch (...) { return nullptr; } }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { try { return cpl::Realtime::allocate(size); } catch (...) { return nullptr; } }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+void* operator new(std::size_t size, std::align_val_t alignment) { return cpl::Realtime::allocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return cpl::Realtime::allocateAligned(size, alignment); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { try { return cpl::Realtime::allocateAligned(size, alignment); } catch (...) { return nullptr; } }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { try { return cpl::Realtime::allocateAligned(size, alignment); } catch (...) { return nullptr; } }
+
+void operator delete(void* p, std::align_val_t) noexcept { cpl::Misc::alignedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { cpl::Misc::alignedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { cpl::Misc::alignedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { cpl::Misc::alignedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { cpl::Misc::alignedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { cpl::Misc::alignedFree(p); }
+
+#endif
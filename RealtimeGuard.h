@@ -0,0 +1,95 @@
+/*************************************************************************************
+
+	cpl - cross-platform library - v. 0.1.0.
+
+	Copyright (C) 2023 Janus Lynggaard Thorborg (www.jthorborg.com)
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	See \licenses\ for additional details on licenses associated with this program.
+
+**************************************************************************************
+
+	file:RealtimeGuard.h
+
+		Marks threads (or scopes of them) as realtime, so global allocations
+		happening inside can be counted or trapped.
+		See CPL_TRAP_REALTIME_ALLOCATIONS in LibraryOptions.h.
+
+*************************************************************************************/
+
+#ifndef CPL_REALTIMEGUARD_H
+#define CPL_REALTIMEGUARD_H
+
+#include "LibraryOptions.h"
+#include <cstddef>
+
+namespace cpl
+{
+	namespace Realtime
+	{
+		namespace detail
+		{
+			inline thread_local int realtimeDepth = 0;
+			inline thread_local int allowanceDepth = 0;
+		};
+
+		/// <summary>
+		/// While alive, the calling thread is considered realtime.
+		/// Scopes nest, and are cheap enough to wrap every audio callback in.
+		/// </summary>
+		struct ScopedThread
+		{
+			ScopedThread() noexcept { detail::realtimeDepth++; }
+			~ScopedThread() noexcept { detail::realtimeDepth--; }
+
+			ScopedThread(const ScopedThread&) = delete;
+			ScopedThread& operator = (const ScopedThread&) = delete;
+		};
+
+		/// <summary>
+		/// Exempts a known, deliberate allocation on a realtime thread (like opt-in queue growth).
+		/// </summary>
+		struct ScopedAllocationAllowance
+		{
+			ScopedAllocationAllowance() noexcept { detail::allowanceDepth++; }
+			~ScopedAllocationAllowance() noexcept { detail::allowanceDepth--; }
+
+			ScopedAllocationAllowance(const ScopedAllocationAllowance&) = delete;
+			ScopedAllocationAllowance& operator = (const ScopedAllocationAllowance&) = delete;
+		};
+
+		/// <summary>
+		/// Returns true if the calling thread is realtime, and not currently allowed to allocate.
+		/// </summary>
+		inline bool isGuarded() noexcept
+		{
+			return detail::realtimeDepth > 0 && detail::allowanceDepth == 0;
+		}
+
+		/// <summary>
+		/// Returns the number of global operator new calls made on guarded threads.
+		/// Always zero unless CPL_TRAP_REALTIME_ALLOCATIONS is defined.
+		/// </summary>
+		std::size_t allocationCount() noexcept;
+
+		/// <summary>
+		/// If set, a guarded allocation also breaks into the debugger (or stops the process, if none is attached).
+		/// Otherwise they are only counted. Off by default.
+		/// </summary>
+		void setTrapping(bool shouldTrap) noexcept;
+	};
+};
+
+#endif
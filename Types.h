@@ -69,6 +69,13 @@ namespace cpl
 		// avx-vector of 4 doubles
 		typedef __m256d v4sd;
 
+		#ifdef CPL_COMPILER_SUPPORTS_AVX512
+		// avx512-vector of 16 floats
+		typedef __m512 v16sf;
+		// avx512-vector of 8 doubles
+		typedef __m512d v8sd;
+		#endif
+
 		// sse-vector of 16/8/4/2 ints
 		typedef __m128i v128si;
 		typedef __m128i v128i;
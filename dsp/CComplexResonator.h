@@ -37,6 +37,12 @@
 #include "DSPWindows.h"
 #include "../Utility.h"
 #include "../lib/AlignedAllocator.h"
+#include "../JobSystem.h"
+
+// see the kernels below
+#if defined(CPL_COMPILER_SUPPORTS_AVX512) && defined(__GNUC__) && !defined(__clang__)
+	#define CPL_CCOMPLEX_RESONATOR_PSABI
+#endif
 
 namespace cpl
 {
@@ -52,17 +58,48 @@ namespace cpl
 			static_assert(Channels > 0, "CComplexResonator needs at least one channel");
 			static const std::size_t numChannels = Channels;
 
+			/// <summary>
+			/// Formats of the results of getWholeWindowedState().
+			/// </summary>
+			enum class WindowedOutput
+			{
+				/// <summary>
+				/// Interleaved real and imaginary parts, out[c * 2 * outSize + k * 2 + (0, 1)].
+				/// </summary>
+				Complex,
+				/// <summary>
+				/// |z|, out[c * outSize + k].
+				/// </summary>
+				Magnitude,
+				/// <summary>
+				/// 20 * log10(|z|), out[c * outSize + k]. Silence is floored at the smallest normal power of float (-379 dB).
+				/// </summary>
+				Decibels,
+				/// <summary>
+				/// arg(z) in radians, out[c * outSize + k].
+				/// </summary>
+				Phase
+			};
+
 			class Constant
 			{
 			public:
+
+				/// <summary>
+				/// Samples advanced at once by the block recurrence, see setBlockRecurrence().
+				/// </summary>
+				static constexpr std::size_t blockSize = 4;
+
 				Constant()
 					: numFilters(0)
 					, numResonators()
 					, centerFilter(0)
 					, numVectors(0)
+					, blockRecurrence(false)
 				{
 
 					reallocBuffers(0, 1);
+					computeWindowTables(0);
 				}
 
 				std::size_t getNumFilters() const noexcept
@@ -70,6 +107,24 @@ namespace cpl
 					return numFilters;
 				}
 
+				/// <summary>
+				/// If set, resonators using this constant advance blockSize samples at a time as
+				/// s[n + K] = p^K * s[n] + sum(p^(K - 1 - j) * x[n + j]), using precomputed powers of the poles.
+				/// The input terms don't depend on the state, so the serial dependency is one complex multiply
+				/// per block instead of per sample, and real input needs fewer operations as well.
+				/// Results only differ from the per-sample recurrence by rounding, which doesn't accumulate
+				/// as the poles are inside the unit circle. Off by default.
+				/// </summary>
+				void setBlockRecurrence(bool shouldUseBlocks) noexcept
+				{
+					blockRecurrence = shouldUseBlocks;
+				}
+
+				bool usesBlockRecurrence() const noexcept
+				{
+					return blockRecurrence;
+				}
+
 				/// <summary>
 				/// Maps the internal resonators (and their vectors) to resonate at the frequencies specified in mappedHz.
 				/// This call is SAFE, on any thread. However, it may acquire a mutex and reallocate memory.
@@ -167,6 +222,8 @@ namespace cpl
 						}
 					}
 
+					computePowers();
+					computeWindowTables(vSize);
 				}
 
 			private:
@@ -190,28 +247,89 @@ namespace cpl
 					centerFilter = (vectors - 1) >> 1;
 
 					numFilters = minimumSize;
-					// quantize to next multiple of 8, to ensure vectorization
-					numResonators = numFilters + (8 - numFilters & 0x7);
+					// quantize to next multiple of 16, to ensure vectorization (up to 512-bit vectors of floats)
+					numResonators = numFilters + ((16 - numFilters) & 0xF);
 
 					N.resize(numResonators);
 					coeff.resize((real + imag) * 2 * numResonators * numVectors);
+					powers.resize(blockSize * 2 * numResonators * numVectors);
+					normalization.resize(numResonators);
+					windowTaps.resize((std::size_t)WindowTypes::End * numVectors);
 
 					return true;
 				}
 
+				/// <summary>
+				/// Raises the (rounded) coefficients to the powers 1 ... blockSize in double precision, so the block
+				/// recurrence models the same poles as the per-sample one.
+				/// Layout is [vector][power - 1][real / imag][resonator].
+				/// </summary>
+				void computePowers()
+				{
+					std::size_t nR = numResonators;
+					std::size_t vC = nR * 2; // space filled by a vector buf
+
+					for (std::size_t v = 0; v < numVectors; ++v)
+					{
+						for (std::size_t k = 0; k < nR; ++k)
+						{
+							const std::complex<double> p(coeff[v * vC + k + nR * real], coeff[v * vC + k + nR * imag]);
+							std::complex<double> power = p;
+
+							for (std::size_t m = 0; m < blockSize; ++m)
+							{
+								powers[(v * blockSize + m) * vC + k + nR * real] = (Scalar)power.real();
+								powers[(v * blockSize + m) * vC + k + nR * imag] = (Scalar)power.imag();
+								power *= p;
+							}
+						}
+					}
+				}
+
+				/// <summary>
+				/// Centres the DFT coefficients of every window on the vectors, truncating windows wider than them.
+				/// Windows without a finite DFT are rectangular. Layout is [window][vector].
+				/// Also inverts the bandwidths of the mapped resonators into gains; the rest get zero.
+				/// </summary>
+				void computeWindowTables(std::size_t mapped)
+				{
+					for (std::size_t w = 0; w < (std::size_t)WindowTypes::End; ++w)
+					{
+						const auto window = windowCoefficients<Scalar>((WindowTypes)w);
+						const auto half = window.second >> 1;
+
+						windowRanges[w].first = centerFilter > half ? centerFilter - half : 0;
+						windowRanges[w].second = std::min(numVectors, centerFilter + half + 1);
+
+						for (std::size_t v = 0; v < numVectors; ++v)
+						{
+							const auto tap = v + half - centerFilter;
+							windowTaps[w * numVectors + v] = v + half >= centerFilter && tap < window.second ? window.first[tap] : Scalar(0);
+						}
+					}
+
+					for (std::size_t k = 0; k < numResonators; ++k)
+						normalization[k] = k < mapped && N[k] > 0 ? Scalar(2) / N[k] : Scalar(0);
+				}
+
 				friend class CComplexResonator<T, Channels>;
 				inline Scalar getBandwidth(std::size_t resonator)
 				{
 					return N.at(resonator);
 				}
 
-				cpl::aligned_vector<Scalar, 32u> coeff;
+				cpl::aligned_vector<Scalar, 64u> coeff, powers, normalization, windowTaps;
 				std::vector<Scalar> N;
+				/// <summary>
+				/// The vectors [first, second) each window has taps for.
+				/// </summary>
+				std::pair<std::size_t, std::size_t> windowRanges[(std::size_t)WindowTypes::End];
 
 				std::size_t centerFilter;
 				std::size_t numVectors;
 
 				std::size_t numFilters, numResonators;
+				bool blockRecurrence;
 			};
 
 
@@ -228,45 +346,59 @@ namespace cpl
 			template<typename V, class MultiVector>
 			inline void resonateReal(const Constant& constant, const MultiVector & data, std::size_t numDataChannels, std::size_t numSamples)
 			{
-				numDataChannels = std::min(numChannels, numDataChannels);
+				match(constant);
+				resonateRealWith<simd::isa_traits<V, false>>(constant, data, numDataChannels, numSamples, 0, constant.numFilters);
+			}
 
-				switch (numDataChannels)
-				{
-					case 1:
-						switch (constant.numVectors)
-						{
-							case 1:
-								internalWindowResonate1<V, MultiVector, 1>(constant, data, numSamples); break;
-							case 3:
-								internalWindowResonate3<V, MultiVector, 1>(constant, data, numSamples); break;
-							case 5:
-								internalWindowResonate<V, MultiVector, 1, 5>(constant, data, numSamples); break;
-							case 7:
-								internalWindowResonate<V, MultiVector, 1, 7>(constant, data, numSamples); break;
-							case 9:
-								internalWindowResonate<V, MultiVector, 1, 9>(constant, data, numSamples); break;
-						}
-						break;
-					case 2:
-						switch (constant.numVectors)
-						{
-							case 1:
-								internalWindowResonate1<V, MultiVector, 2>(constant, data, numSamples); break;
-							case 3:
-								internalWindowResonate3<V, MultiVector, 2>(constant, data, numSamples); break;
-							case 5:
-								internalWindowResonate<V, MultiVector, 2, 5>(constant, data, numSamples); break;
-							case 7:
-								internalWindowResonate<V, MultiVector, 2, 7>(constant, data, numSamples); break;
-							case 9:
-								internalWindowResonate<V, MultiVector, 2, 9>(constant, data, numSamples); break;
-						}
-						break;
-					default:
-						CPL_RUNTIME_EXCEPTION("Unsupported number of channels.");
-				}
+			/// <summary>
+			/// Like resonateReal(), using the widest vectors and FMA if the processor supports it, selected at runtime
+			/// (see simd::dynamic_isa_dispatch()). The fused recurrence rounds slightly differently.
+			/// </summary>
+			template<class MultiVector>
+			void resonateRealDispatched(const Constant& constant, const MultiVector & data, std::size_t numDataChannels, std::size_t numSamples)
+			{
+				match(constant);
+				simd::dynamic_isa_dispatch<T, RealDispatcher>(*this, constant, data, numDataChannels, numSamples, std::size_t(0), constant.numFilters);
+			}
+
+			/// <summary>
+			/// Like resonateReal(), with the filters partitioned into chunks (see chunkFilters()) resonated
+			/// concurrently on the shared JobSystem, including the calling thread.
+			/// Every resonator is independent, so results are bit-identical to resonateReal().
+			/// </summary>
+			template<typename V, class MultiVector>
+			void resonateRealParallel(const Constant& constant, const MultiVector & data, std::size_t numDataChannels, std::size_t numSamples)
+			{
+				match(constant);
+
+				jobs::parallel_for_range(
+					constant.numFilters,
+					[&](std::size_t begin, std::size_t end)
+					{
+						resonateRealWith<simd::isa_traits<V, false>>(constant, data, numDataChannels, numSamples, begin, end);
+					},
+					chunkFilters(constant)
+				);
 			}
 
+			/// <summary>
+			/// Like resonateRealParallel(), with the instruction set selected at runtime as in resonateRealDispatched().
+			/// Bit-identical to resonateRealDispatched().
+			/// </summary>
+			template<class MultiVector>
+			void resonateRealDispatchedParallel(const Constant& constant, const MultiVector & data, std::size_t numDataChannels, std::size_t numSamples)
+			{
+				match(constant);
+
+				jobs::parallel_for_range(
+					constant.numFilters,
+					[&](std::size_t begin, std::size_t end)
+					{
+						simd::dynamic_isa_dispatch<T, RealDispatcher>(*this, constant, data, numDataChannels, numSamples, begin, end);
+					},
+					chunkFilters(constant)
+				);
+			}
 
 			/// <summary>
 			/// Resonates the system (processing the data). Safe from any thread.
@@ -277,20 +409,68 @@ namespace cpl
 			template<typename V, class MultiVector>
 			inline void resonateComplex(const Constant& constant, const MultiVector & data, std::size_t numSamples)
 			{
-				switch (constant.numVectors)
-				{
-					case 1:
-						internalWindowComplexResonate<V, MultiVector, 1>(constant, data, numSamples); break;
-					case 3:
-						internalWindowComplexResonate<V, MultiVector, 3>(constant, data, numSamples); break;
-					case 5:
-						internalWindowComplexResonate<V, MultiVector, 5>(constant, data, numSamples); break;
-					case 7:
-						internalWindowComplexResonate<V, MultiVector, 7>(constant, data, numSamples); break;
-					case 9:
-						internalWindowComplexResonate<V, MultiVector, 9>(constant, data, numSamples); break;
-				}
+				match(constant);
+				resonateComplexWith<simd::isa_traits<V, false>>(constant, data, numSamples, 0, constant.numFilters);
+			}
 
+			/// <summary>
+			/// Like resonateComplex(), using the widest vectors and FMA if the processor supports it, selected at runtime.
+			/// </summary>
+			template<class MultiVector>
+			void resonateComplexDispatched(const Constant& constant, const MultiVector & data, std::size_t numSamples)
+			{
+				match(constant);
+				simd::dynamic_isa_dispatch<T, ComplexDispatcher>(*this, constant, data, numSamples, std::size_t(0), constant.numFilters);
+			}
+
+			/// <summary>
+			/// Like resonateComplex(), partitioned as in resonateRealParallel(). Bit-identical to resonateComplex().
+			/// </summary>
+			template<typename V, class MultiVector>
+			void resonateComplexParallel(const Constant& constant, const MultiVector & data, std::size_t numSamples)
+			{
+				match(constant);
+
+				jobs::parallel_for_range(
+					constant.numFilters,
+					[&](std::size_t begin, std::size_t end)
+					{
+						resonateComplexWith<simd::isa_traits<V, false>>(constant, data, numSamples, begin, end);
+					},
+					chunkFilters(constant)
+				);
+			}
+
+			/// <summary>
+			/// Like resonateComplexDispatched(), partitioned as in resonateRealParallel(). Bit-identical to resonateComplexDispatched().
+			/// </summary>
+			template<class MultiVector>
+			void resonateComplexDispatchedParallel(const Constant& constant, const MultiVector & data, std::size_t numSamples)
+			{
+				match(constant);
+
+				jobs::parallel_for_range(
+					constant.numFilters,
+					[&](std::size_t begin, std::size_t end)
+					{
+						simd::dynamic_isa_dispatch<T, ComplexDispatcher>(*this, constant, data, numSamples, begin, end);
+					},
+					chunkFilters(constant)
+				);
+			}
+
+			/// <summary>
+			/// The number of filters resonated by each job in the parallel modes. A multiple of 16, so chunks never
+			/// split a vector or share a cache line of state, sized for the coefficients and state of a chunk to fit
+			/// in half of a typical 32 KB L1 data cache.
+			/// </summary>
+			static std::size_t chunkFilters(const Constant& constant) noexcept
+			{
+				const std::size_t chunkBytes = 1 << 14;
+				const auto coefficients = constant.blockRecurrence ? Constant::blockSize : 1;
+				const auto bytesPerFilter = sizeof(Scalar) * 2 * std::max<std::size_t>(1, constant.numVectors) * (coefficients + numChannels);
+
+				return std::max<std::size_t>(16, (chunkBytes / bytesPerFilter) & ~std::size_t(15));
 			}
 
 			/// <summary>
@@ -322,135 +502,82 @@ namespace cpl
 			{
 				match(c);
 
-				Scalar gainCoeff = c.N.at(resonator) * 0.5; // 2^-3 (3 vectors)
-				Scalar scale = resonatorScales[(int)win];
+				Scalar gainCoeff = resonatorScales[(int)win] * c.normalization.at(resonator); // bounds checking here.
 				Scalar realPart(0), imagPart(0);
 
 				std::size_t nR = c.numResonators;
 				std::size_t vC = nR * 2; // space filled by a vector buf
 				std::size_t sC = vC * c.numVectors; // space filled by all vector bufs
 
-				auto extent = std::extent<decltype(Windows::DFTCoeffs<T, win>::coeffs)>::value;
-
-				std::size_t v = 0;
-				std::size_t off = 0;
-				// truncate window,
-				if (extent > c.numVectors)
-				{
-					auto diff = extent - c.numVectors;
-					diff = (diff - 1) >> 1;
-					v = diff;
-					extent -= diff;
-				}
-				else if (c.numVectors > extent) // or select the middle vectors.
-				{
-					auto diff = c.numVectors - extent;
-					diff = (diff - 1) >> 1;
-					off = diff;
-				}
+				const Scalar * taps = &c.windowTaps[(std::size_t)win * c.numVectors];
+				const auto range = c.windowRanges[(std::size_t)win];
 
-				for (; v < extent; ++v)
+				for (std::size_t v = range.first; v < range.second; ++v)
 				{
-					realPart += Windows::DFTCoeffs<T, win>::coeffs[v] * state[sC * channel + (v + off) * vC + resonator + real * nR];
-					imagPart += Windows::DFTCoeffs<T, win>::coeffs[v] * state[sC * channel + (v + off) * vC + resonator + imag * nR];
+					realPart += taps[v] * state[sC * channel + v * vC + resonator + real * nR];
+					imagPart += taps[v] * state[sC * channel + v * vC + resonator + imag * nR];
 				}
 
-				return std::complex<Scalar>(scale * realPart / gainCoeff, scale * imagPart / gainCoeff);
-			}
-			/// <summary>
-			/// Gets the windowed resonance at the specified index.
-			/// If the window is larger than the amout of vectors, it will be truncated.
-			/// <param name="out">
-			/// Vector is a dimensional array of size * 2 (complex) * channels of T. Channels are separated.
-			/// </param>
-			/// </summary>
-			template<typename V, class Vector>
-			void getWholeWindowedState(const Constant& c, WindowTypes win, Vector & out, std::size_t outChannels, std::size_t outSize)
-			{
-				typedef WindowTypes w;
-				switch (win)
-				{
-					case cpl::dsp::WindowTypes::Hann:
-						getWholeWindowedState<w::Hann, V, Vector>(c, out, outChannels, outSize); break;
-					case cpl::dsp::WindowTypes::Hamming:
-						getWholeWindowedState<w::Hamming, V, Vector>(c, out, outChannels, outSize); break;
-					case cpl::dsp::WindowTypes::FlatTop:
-						getWholeWindowedState<w::FlatTop, V, Vector>(c, out, outChannels, outSize); break;
-					case cpl::dsp::WindowTypes::Blackman:
-						getWholeWindowedState<w::Blackman, V, Vector>(c, out, outChannels, outSize); break;
-					case cpl::dsp::WindowTypes::ExactBlackman:
-						getWholeWindowedState<w::ExactBlackman, V, Vector>(c, out, outChannels, outSize); break;
-					case cpl::dsp::WindowTypes::Nuttall:
-						getWholeWindowedState<w::Nuttall, V, Vector>(c, out, outChannels, outSize); break;
-					case cpl::dsp::WindowTypes::BlackmanNuttall:
-						getWholeWindowedState<w::BlackmanNuttall, V, Vector>(c, out, outChannels, outSize); break;
-					case cpl::dsp::WindowTypes::BlackmanHarris:
-						getWholeWindowedState<w::BlackmanHarris, V, Vector>(c, out, outChannels, outSize); break;
-					default:
-						getWholeWindowedState<w::Rectangular, V, Vector>(c, out, outChannels, outSize); break;
-				}
+				return std::complex<Scalar>(gainCoeff * realPart, gainCoeff * imagPart);
 			}
 
 			/// <summary>
-			/// Gets the windowed resonance at the specified index.
+			/// Gets the windowed resonances of every resonator, combining the vectors with the window taps
+			/// precomputed by mapSystemHz(). Windows without a finite DFT are rectangular.
 			/// If the window is larger than the amout of vectors, it will be truncated.
 			/// <param name="out">
-			/// Vector is a dimensional array of size * 2 (complex) * channels of T. Channels are separated.
+			/// Vector is a dimensional array of size * 2 (complex) * channels of T, or size * channels for the
+			/// other formats. Channels are separated.
+			/// Elements may also be simd::float16 or simd::bfloat16, halving the size of the output. The window
+			/// is still accumulated in T, and the results are rounded in bulk.
 			/// </param>
 			/// </summary>
-			template<WindowTypes win, typename V, class Vector>
-			void getWholeWindowedState(const Constant& constant, Vector & out, std::size_t outChannels, std::size_t outSize)
+			template<typename V, class Vector>
+			void getWholeWindowedState(const Constant& constant, WindowTypes win, Vector & out, std::size_t outChannels, std::size_t outSize, WindowedOutput format = WindowedOutput::Complex)
 			{
 				match(constant);
 
+				typedef typename std::remove_cv<typename std::remove_reference<decltype(out[0])>::type>::type Element;
+				typedef typename std::conditional<simd::is_half_float<Element>::value, float, Scalar>::type Result;
+
 				std::size_t maxResonators = std::min(constant.numResonators, outSize);
 				std::size_t maxChannels = std::min(numChannels, outChannels);
+				std::size_t stride = format == WindowedOutput::Complex ? 2 : 1;
 
-				auto extent = std::extent<decltype(Windows::DFTCoeffs<T, win>::coeffs)>::value;
-
-				std::size_t vStart = 0;
-				std::size_t off = 0;
-				Scalar scale = resonatorScales[(int)win];
-
-				std::size_t nR = constant.numResonators;
-				std::size_t vC = nR * 2; // space filled by a vector buf
-				std::size_t sC = vC * constant.numVectors; // space filled by all vector bufs
-
-				// truncate window,
-				if (extent > constant.numVectors)
-				{
-					auto diff = extent - constant.numVectors;
-					diff = (diff - 1);
-					vStart = diff;
-					extent -= diff;
-				}
-				else if (constant.numVectors > extent) // or select the middle vectors.
-				{
-					auto diff = constant.numVectors - extent;
-					diff = (diff - 1) >> 1;
-					off = diff;
-				}
+				// windowed a tile at a time, and formatted while it is still in the cache
+				alignas(64) Scalar parts[2][windowTile];
+				Result results[windowTile * 2];
 
 				for (std::size_t c = 0; c < maxChannels; c++)
 				{
-					for (std::size_t k = 0; k < maxResonators; k++)
+					for (std::size_t start = 0; start < maxResonators; start += windowTile)
 					{
-						Scalar gainCoeff = scale / (constant.N[k] * 0.5); // 2^-3 (3 vectors)
+						const auto count = std::min(windowTile, maxResonators - start);
+						const auto offset = (c * outSize + start) * stride;
 
-						Scalar realPart(0), imagPart(0);
+						applyWindow<V>(constant, win, c, start, count, parts[real], parts[imag]);
+						formatWindowed(format, parts[real], parts[imag], results, count);
 
-						for (std::size_t v = vStart; v < extent; ++v)
+						if constexpr (simd::is_half_float<Element>::value)
 						{
-							realPart += Windows::DFTCoeffs<T, win>::coeffs[v] * state[sC * c + (v + off) * vC + k + real * nR];
-							imagPart += Windows::DFTCoeffs<T, win>::coeffs[v] * state[sC * c + (v + off) * vC + k + imag * nR];
+							simd::compress(results, &out[offset], count * stride);
+						}
+						else
+						{
+							for (std::size_t i = 0; i < count * stride; i++)
+								out[offset + i] = results[i];
 						}
-
-						out[c * 2 * outSize + k * 2] = gainCoeff * realPart;
-						out[c * 2 * outSize + k * 2 + 1] = gainCoeff * imagPart;
-
 					}
 				}
+			}
 
+			/// <summary>
+			/// getWholeWindowedState() with a window known at compile time, as complex results.
+			/// </summary>
+			template<WindowTypes win, typename V, class Vector>
+			void getWholeWindowedState(const Constant& constant, Vector & out, std::size_t outChannels, std::size_t outSize)
+			{
+				getWholeWindowedState<V>(constant, win, out, outChannels, outSize);
 			}
 
 
@@ -471,16 +598,195 @@ namespace cpl
 				state.resize((real + imag) * 2 * constant.numResonators * constant.numVectors * numChannels);
 			}
 
-			template<typename V, class MultiVector, std::size_t inputDataChannels, std::size_t staticVectors>
-			void internalWindowResonate(const Constant& constant, const MultiVector & data, std::size_t numSamples)
+			/// <summary>
+			/// Resonates filters [begin, end). begin must be a multiple of 16, and the state must already match the constant.
+			/// </summary>
+			template<class ISA, class MultiVector>
+			void resonateRealWith(const Constant& constant, const MultiVector & data, std::size_t numDataChannels, std::size_t numSamples, std::size_t begin, std::size_t end)
 			{
-				match(constant);
+				numDataChannels = std::min(numChannels, numDataChannels);
+
+				if (constant.blockRecurrence)
+				{
+					switch (numDataChannels)
+					{
+						case 1:
+							return resonateBlocksWith<ISA, MultiVector, 1>(constant, data, numSamples, begin, end);
+						case 2:
+							return resonateBlocksWith<ISA, MultiVector, 2>(constant, data, numSamples, begin, end);
+						default:
+							CPL_RUNTIME_EXCEPTION("Unsupported number of channels.");
+					}
+				}
+
+				switch (numDataChannels)
+				{
+					case 1:
+						switch (constant.numVectors)
+						{
+							case 1:
+								internalWindowResonate1<ISA, MultiVector, 1>(constant, data, numSamples, begin, end); break;
+							case 3:
+								internalWindowResonate3<ISA, MultiVector, 1>(constant, data, numSamples, begin, end); break;
+							case 5:
+								internalWindowResonate<ISA, MultiVector, 1, 5>(constant, data, numSamples, begin, end); break;
+							case 7:
+								internalWindowResonate<ISA, MultiVector, 1, 7>(constant, data, numSamples, begin, end); break;
+							case 9:
+								internalWindowResonate<ISA, MultiVector, 1, 9>(constant, data, numSamples, begin, end); break;
+						}
+						break;
+					case 2:
+						switch (constant.numVectors)
+						{
+							case 1:
+								internalWindowResonate1<ISA, MultiVector, 2>(constant, data, numSamples, begin, end); break;
+							case 3:
+								internalWindowResonate3<ISA, MultiVector, 2>(constant, data, numSamples, begin, end); break;
+							case 5:
+								internalWindowResonate<ISA, MultiVector, 2, 5>(constant, data, numSamples, begin, end); break;
+							case 7:
+								internalWindowResonate<ISA, MultiVector, 2, 7>(constant, data, numSamples, begin, end); break;
+							case 9:
+								internalWindowResonate<ISA, MultiVector, 2, 9>(constant, data, numSamples, begin, end); break;
+						}
+						break;
+					default:
+						CPL_RUNTIME_EXCEPTION("Unsupported number of channels.");
+				}
+			}
+
+			template<class ISA, class MultiVector>
+			void resonateComplexWith(const Constant& constant, const MultiVector & data, std::size_t numSamples, std::size_t begin, std::size_t end)
+			{
+				if (constant.blockRecurrence)
+				{
+					switch (constant.numVectors)
+					{
+						case 1:
+							internalBlockComplexResonate<ISA, MultiVector, 1>(constant, data, numSamples, begin, end); break;
+						case 3:
+							internalBlockComplexResonate<ISA, MultiVector, 3>(constant, data, numSamples, begin, end); break;
+						case 5:
+							internalBlockComplexResonate<ISA, MultiVector, 5>(constant, data, numSamples, begin, end); break;
+						case 7:
+							internalBlockComplexResonate<ISA, MultiVector, 7>(constant, data, numSamples, begin, end); break;
+						case 9:
+							internalBlockComplexResonate<ISA, MultiVector, 9>(constant, data, numSamples, begin, end); break;
+					}
+
+					return;
+				}
+
+				switch (constant.numVectors)
+				{
+					case 1:
+						internalWindowComplexResonate<ISA, MultiVector, 1>(constant, data, numSamples, begin, end); break;
+					case 3:
+						internalWindowComplexResonate<ISA, MultiVector, 3>(constant, data, numSamples, begin, end); break;
+					case 5:
+						internalWindowComplexResonate<ISA, MultiVector, 5>(constant, data, numSamples, begin, end); break;
+					case 7:
+						internalWindowComplexResonate<ISA, MultiVector, 7>(constant, data, numSamples, begin, end); break;
+					case 9:
+						internalWindowComplexResonate<ISA, MultiVector, 9>(constant, data, numSamples, begin, end); break;
+				}
+
+			}
+
+			template<class ISA, class MultiVector, std::size_t inputDataChannels>
+			void resonateBlocksWith(const Constant& constant, const MultiVector & data, std::size_t numSamples, std::size_t begin, std::size_t end)
+			{
+				switch (constant.numVectors)
+				{
+					case 1:
+						internalBlockResonate<ISA, MultiVector, inputDataChannels, 1>(constant, data, numSamples, begin, end); break;
+					case 3:
+						internalBlockResonate<ISA, MultiVector, inputDataChannels, 3>(constant, data, numSamples, begin, end); break;
+					case 5:
+						internalBlockResonate<ISA, MultiVector, inputDataChannels, 5>(constant, data, numSamples, begin, end); break;
+					case 7:
+						internalBlockResonate<ISA, MultiVector, inputDataChannels, 7>(constant, data, numSamples, begin, end); break;
+					case 9:
+						internalBlockResonate<ISA, MultiVector, inputDataChannels, 9>(constant, data, numSamples, begin, end); break;
+				}
+			}
+
+			struct RealDispatcher
+			{
+				template<class ISA, class MultiVector>
+				static void dispatch(CComplexResonator& self, const Constant& constant, const MultiVector & data, std::size_t numDataChannels, std::size_t numSamples, std::size_t begin, std::size_t end)
+				{
+					self.template resonateRealWith<ISA>(constant, data, numDataChannels, numSamples, begin, end);
+				}
+			};
+
+			struct ComplexDispatcher
+			{
+				template<class ISA, class MultiVector>
+				static void dispatch(CComplexResonator& self, const Constant& constant, const MultiVector & data, std::size_t numSamples, std::size_t begin, std::size_t end)
+				{
+					self.template resonateComplexWith<ISA>(constant, data, numSamples, begin, end);
+				}
+			};
 
+// the 512-bit instantiations of the kernels below are only reached through dynamic_isa_dispatch(), which inlines them into an avx512 target.
+// gcc still checks the register ABI at every call to a 512-bit helper in them, as they don't carry the target themselves,
+// and warns about an ABI change that can't happen once inlined.
+#ifdef CPL_CCOMPLEX_RESONATOR_PSABI
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+			/// <summary>
+			/// s = s * p + input, for complex s and p. The fused version rounds differently.
+			/// </summary>
+			template<class ISA, typename V>
+			static inline void rotate(V & s_r, V & s_i, const V p_r, const V p_i, const V input)
+			{
+				if constexpr (ISA::is_fma_accelerated)
+				{
+					const V t0 = ISA::fma(s_r, p_r, ISA::fnma(s_i, p_i, input));
+					s_i = ISA::fma(s_r, p_i, s_i * p_r);
+					s_r = t0;
+				}
+				else
+				{
+					const V t0 = s_r * p_r - s_i * p_i;
+					s_i = s_r * p_i + s_i * p_r;
+					s_r = t0 + input;
+				}
+			}
+
+			/// <summary>
+			/// s = s * p + input, for complex s, p and input.
+			/// </summary>
+			template<class ISA, typename V>
+			static inline void rotate(V & s_r, V & s_i, const V p_r, const V p_i, const V input_r, const V input_i)
+			{
+				if constexpr (ISA::is_fma_accelerated)
+				{
+					const V t0 = ISA::fma(s_r, p_r, ISA::fnma(s_i, p_i, input_r));
+					s_i = ISA::fma(s_r, p_i, ISA::fma(s_i, p_r, input_i));
+					s_r = t0;
+				}
+				else
+				{
+					const V t0 = s_r * p_r - s_i * p_i;
+					s_i = s_r * p_i + s_i * p_r;
+					s_r = t0 + input_r;
+					s_i += input_i;
+				}
+			}
+
+			template<class ISA, class MultiVector, std::size_t inputDataChannels, std::size_t staticVectors>
+			void internalWindowResonate(const Constant& constant, const MultiVector & data, std::size_t numSamples, std::size_t begin, std::size_t end)
+			{
 				using namespace cpl;
 				using namespace cpl::simd;
+				typedef typename ISA::V V;
 
 				auto const vfactor = suitable_container<V>::size;
-				V t0;
 
 				std::size_t nR = constant.numResonators;
 				std::size_t vC = nR * 2; // space filled by a vector buf
@@ -488,7 +794,7 @@ namespace cpl
 
 
 				 //  iterate over each filter for each sample for each channel for each vector.
-				for (Types::fint_t k = 0; k < constant.numFilters; k += vfactor)
+				for (Types::fint_t k = begin; k < end; k += vfactor)
 				{
 
 					// pointer to current sample
@@ -521,9 +827,7 @@ namespace cpl
 							// v stage (m) (fc +- v * bw)
 							for (Types::fint_t v = 0; v < staticVectors; ++v)
 							{
-								t0 = s_r[c][v] * p_r[v] - s_i[c][v] * p_i[v];
-								s_i[c][v] = s_r[c][v] * p_i[v] + s_i[c][v] * p_r[v];
-								s_r[c][v] = t0 + input;
+								rotate<ISA>(s_r[c][v], s_i[c][v], p_r[v], p_i[v], input);
 							}
 
 							audioInputs[c]++;
@@ -542,16 +846,14 @@ namespace cpl
 				}
 			}
 
-			template<typename V, class MultiVector, std::size_t inputDataChannels>
-			void internalWindowResonate1(const Constant& constant, const MultiVector& data, std::size_t numSamples)
+			template<class ISA, class MultiVector, std::size_t inputDataChannels>
+			void internalWindowResonate1(const Constant& constant, const MultiVector& data, std::size_t numSamples, std::size_t begin, std::size_t end)
 			{
-				match(constant);
-
 				using namespace cpl;
 				using namespace cpl::simd;
+				typedef typename ISA::V V;
 
 				auto const vfactor = suitable_container<V>::size;
-				V t0;
 
 				std::size_t nR = constant.numResonators;
 				std::size_t vC = nR * 2; // space filled by a vector buf
@@ -559,7 +861,7 @@ namespace cpl
 
 
 				 //  iterate over each filter for each sample for each channel for each vector.
-				for (Types::fint_t k = 0; k < constant.numFilters; k += vfactor)
+				for (Types::fint_t k = begin; k < end; k += vfactor)
 				{
 
 					// pointer to current sample
@@ -589,9 +891,7 @@ namespace cpl
 							V input = broadcast<V>(audioInputs[c]);
 
 							// v stage (m) (fc +- v * bw)
-							t0 = s_r[c] * p_r - s_i[c] * p_i;
-							s_i[c] = s_r[c] * p_i + s_i[c] * p_r;
-							s_r[c] = t0 + input;
+							rotate<ISA>(s_r[c], s_i[c], p_r, p_i, input);
 
 							audioInputs[c]++;
 						}
@@ -605,22 +905,20 @@ namespace cpl
 				}
 			}
 
-			template<typename V, class MultiVector, std::size_t staticVectors>
-			void internalWindowComplexResonate(const Constant& constant, const MultiVector & data, std::size_t numSamples)
+			template<class ISA, class MultiVector, std::size_t staticVectors>
+			void internalWindowComplexResonate(const Constant& constant, const MultiVector & data, std::size_t numSamples, std::size_t begin, std::size_t end)
 			{
-				match(constant);
-
 				using namespace cpl;
 				using namespace cpl::simd;
+				typedef typename ISA::V V;
 
 				auto const vfactor = suitable_container<V>::size;
-				V t0;
 
 				std::size_t nR = constant.numResonators;
 				std::size_t vC = nR * 2; // space filled by a vector buf
 
 				 //  iterate over each filter for each sample for each channel for each vector.
-				for (Types::fint_t k = 0; k < constant.numFilters; k += vfactor)
+				for (Types::fint_t k = begin; k < end; k += vfactor)
 				{
 
 					// pointer to current sample
@@ -653,10 +951,7 @@ namespace cpl
 
 						for (Types::fint_t v = 0; v < staticVectors; ++v)
 						{
-							t0 = s_r[v] * p_r[v] - s_i[v] * p_i[v];
-							s_i[v] = s_r[v] * p_i[v] + s_i[v] * p_r[v];
-							s_r[v] = t0 + real;
-							s_i[v] += imag;
+							rotate<ISA>(s_r[v], s_i[v], p_r[v], p_i[v], real, imag);
 						}
 					}
 
@@ -668,23 +963,21 @@ namespace cpl
 				}
 			}
 
-			template<typename V, class MultiVector, std::size_t inputDataChannels>
-			void internalWindowResonate3(const Constant& constant, const MultiVector & data, std::size_t numSamples)
+			template<class ISA, class MultiVector, std::size_t inputDataChannels>
+			void internalWindowResonate3(const Constant& constant, const MultiVector & data, std::size_t numSamples, std::size_t begin, std::size_t end)
 			{
-				match(constant);
-
 				using namespace cpl;
 				using namespace cpl::simd;
+				typedef typename ISA::V V;
 
 				auto const vfactor = suitable_container<V>::size;
-				V t0;
 
 				std::size_t nR = constant.numResonators;
 				std::size_t vC = nR * 2; // space filled by a vector buf
 				std::size_t sC = vC * constant.numVectors; // space filled by all vector bufs
 
 				//  iterate over each filter for each sample for each channel.
-				for (Types::fint_t filter = 0; filter < constant.numFilters; filter += vfactor)
+				for (Types::fint_t filter = begin; filter < end; filter += vfactor)
 				{
 
 					// pointer to current sample
@@ -728,19 +1021,13 @@ namespace cpl
 							V input = broadcast<V>(audioInputs[c]);
 
 							// -1 stage (m1) (fc - bw)
-							t0 = s_m1_r[c] * p_m1_r - s_m1_i[c] * p_m1_i;
-							s_m1_i[c] = s_m1_r[c] * p_m1_i + s_m1_i[c] * p_m1_r;
-							s_m1_r[c] = t0 + input;
+							rotate<ISA>(s_m1_r[c], s_m1_i[c], p_m1_r, p_m1_i, input);
 
 							// 0 stage (m) (fc)
-							t0 = s_m_r[c] * p_m_r - s_m_i[c] * p_m_i;
-							s_m_i[c] = s_m_r[c] * p_m_i + s_m_i[c] * p_m_r;
-							s_m_r[c] = t0 + input;
+							rotate<ISA>(s_m_r[c], s_m_i[c], p_m_r, p_m_i, input);
 
 							// +1 stage (p1) (fc + bw)
-							t0 = s_p1_r[c] * p_p1_r - s_p1_i[c] * p_p1_i;
-							s_p1_i[c] = s_p1_r[c] * p_p1_i + s_p1_i[c] * p_p1_r;
-							s_p1_r[c] = t0 + input;
+							rotate<ISA>(s_p1_r[c], s_p1_i[c], p_p1_r, p_p1_i, input);
 
 							audioInputs[c]++;
 						}
@@ -759,6 +1046,291 @@ namespace cpl
 				}
 			}
 
+			/// <summary>
+			/// The block recurrence (see Constant::setBlockRecurrence()) for real input.
+			/// Remaining samples, that don't fill a block, go through the per-sample recurrence.
+			/// </summary>
+			template<class ISA, class MultiVector, std::size_t inputDataChannels, std::size_t staticVectors>
+			void internalBlockResonate(const Constant& constant, const MultiVector & data, std::size_t numSamples, std::size_t begin, std::size_t end)
+			{
+				using namespace cpl;
+				using namespace cpl::simd;
+				typedef typename ISA::V V;
+
+				auto const vfactor = suitable_container<V>::size;
+				const std::size_t K = Constant::blockSize;
+				const std::size_t numBlocks = numSamples / K;
+
+				std::size_t nR = constant.numResonators;
+				std::size_t vC = nR * 2; // space filled by a vector buf
+				std::size_t sC = vC * constant.numVectors; // space filled by all vector bufs
+				std::size_t pC = vC * K; // space filled by the powers of a vector
+
+				for (Types::fint_t k = begin; k < end; k += vfactor)
+				{
+					// pointer to current sample
+					const typename scalar_of<V>::type * audioInputs[numChannels];
+
+					V s_r[inputDataChannels][staticVectors], s_i[inputDataChannels][staticVectors];
+
+					for (Types::fint_t v = 0; v < staticVectors; ++v)
+					{
+						for (Types::fint_t c = 0; c < inputDataChannels; ++c)
+						{
+							audioInputs[c] = &data[c][0];
+
+							s_r[c][v] = load<V>(&state[sC * c + v * vC + k + nR * real]);
+							s_i[c][v] = load<V>(&state[sC * c + v * vC + k + nR * imag]);
+						}
+					}
+
+					for (std::size_t block = 0; block < numBlocks; ++block)
+					{
+						for (Types::fint_t c = 0; c < inputDataChannels; ++c)
+						{
+							V input[K];
+
+							for (std::size_t j = 0; j < K; ++j)
+								input[j] = broadcast<V>(audioInputs[c] + j);
+
+							for (Types::fint_t v = 0; v < staticVectors; ++v)
+							{
+								// power m is at powers[m - 1]
+								const Scalar * power = &constant.powers[v * pC + k];
+
+								// sum(p^(K - 1 - j) * x[j]), independent of the state
+								V in_r = input[K - 1], in_i = zero<V>();
+
+								for (std::size_t j = 0; j + 1 < K; ++j)
+								{
+									const auto m = K - 2 - j;
+									in_r = ISA::fma(load<V>(power + m * vC + nR * real), input[j], in_r);
+									in_i = ISA::fma(load<V>(power + m * vC + nR * imag), input[j], in_i);
+								}
+
+								const V p_r = load<V>(power + (K - 1) * vC + nR * real), p_i = load<V>(power + (K - 1) * vC + nR * imag);
+
+								const V t0 = ISA::fma(s_r[c][v], p_r, ISA::fnma(s_i[c][v], p_i, in_r));
+								s_i[c][v] = ISA::fma(s_r[c][v], p_i, ISA::fma(s_i[c][v], p_r, in_i));
+								s_r[c][v] = t0;
+							}
+
+							audioInputs[c] += K;
+						}
+					}
+
+					for (std::size_t sample = numBlocks * K; sample < numSamples; ++sample)
+					{
+						for (Types::fint_t c = 0; c < inputDataChannels; ++c)
+						{
+							V input = broadcast<V>(audioInputs[c]);
+
+							for (Types::fint_t v = 0; v < staticVectors; ++v)
+							{
+								const V p_r = load<V>(&constant.coeff[v * vC + k + nR * real]), p_i = load<V>(&constant.coeff[v * vC + k + nR * imag]);
+								rotate<ISA>(s_r[c][v], s_i[c][v], p_r, p_i, input);
+							}
+
+							audioInputs[c]++;
+						}
+					}
+
+					for (Types::fint_t c = 0; c < inputDataChannels; ++c)
+					{
+						for (Types::fint_t v = 0; v < staticVectors; ++v)
+						{
+							store(&state[sC * c + v * vC + k + nR * real], s_r[c][v]); // state: e^i*omega (real)
+							store(&state[sC * c + v * vC + k + nR * imag], s_i[c][v]); // state: e^i*omega (imag)
+						}
+					}
+				}
+			}
+
+			/// <summary>
+			/// The block recurrence (see Constant::setBlockRecurrence()) for complex input.
+			/// </summary>
+			template<class ISA, class MultiVector, std::size_t staticVectors>
+			void internalBlockComplexResonate(const Constant& constant, const MultiVector & data, std::size_t numSamples, std::size_t begin, std::size_t end)
+			{
+				using namespace cpl;
+				using namespace cpl::simd;
+				typedef typename ISA::V V;
+
+				auto const vfactor = suitable_container<V>::size;
+				const std::size_t K = Constant::blockSize;
+				const std::size_t numBlocks = numSamples / K;
+
+				std::size_t nR = constant.numResonators;
+				std::size_t vC = nR * 2; // space filled by a vector buf
+				std::size_t pC = vC * K; // space filled by the powers of a vector
+
+				for (Types::fint_t k = begin; k < end; k += vfactor)
+				{
+					// pointer to current sample
+					const typename scalar_of<V>::type * audioInputs[2] = { &data[0][0], &data[1][0] };
+
+					V s_r[staticVectors], s_i[staticVectors];
+
+					for (Types::fint_t v = 0; v < staticVectors; ++v)
+					{
+						s_r[v] = load<V>(&state[v * vC + k + nR * real]);
+						s_i[v] = load<V>(&state[v * vC + k + nR * imag]);
+					}
+
+					for (std::size_t block = 0; block < numBlocks; ++block)
+					{
+						V input_r[K], input_i[K];
+
+						for (std::size_t j = 0; j < K; ++j)
+						{
+							input_r[j] = broadcast<V>(audioInputs[0] + j);
+							input_i[j] = broadcast<V>(audioInputs[1] + j);
+						}
+
+						for (Types::fint_t v = 0; v < staticVectors; ++v)
+						{
+							const Scalar * power = &constant.powers[v * pC + k];
+
+							V in_r = input_r[K - 1], in_i = input_i[K - 1];
+
+							for (std::size_t j = 0; j + 1 < K; ++j)
+							{
+								const auto m = K - 2 - j;
+								const V w_r = load<V>(power + m * vC + nR * real), w_i = load<V>(power + m * vC + nR * imag);
+
+								in_r = ISA::fma(w_r, input_r[j], ISA::fnma(w_i, input_i[j], in_r));
+								in_i = ISA::fma(w_r, input_i[j], ISA::fma(w_i, input_r[j], in_i));
+							}
+
+							const V p_r = load<V>(power + (K - 1) * vC + nR * real), p_i = load<V>(power + (K - 1) * vC + nR * imag);
+
+							const V t0 = ISA::fma(s_r[v], p_r, ISA::fnma(s_i[v], p_i, in_r));
+							s_i[v] = ISA::fma(s_r[v], p_i, ISA::fma(s_i[v], p_r, in_i));
+							s_r[v] = t0;
+						}
+
+						audioInputs[0] += K;
+						audioInputs[1] += K;
+					}
+
+					for (std::size_t sample = numBlocks * K; sample < numSamples; ++sample)
+					{
+						const V x_r = broadcast<V>(audioInputs[0]++), x_i = broadcast<V>(audioInputs[1]++);
+
+						for (Types::fint_t v = 0; v < staticVectors; ++v)
+						{
+							const V p_r = load<V>(&constant.coeff[v * vC + k + nR * real]), p_i = load<V>(&constant.coeff[v * vC + k + nR * imag]);
+							rotate<ISA>(s_r[v], s_i[v], p_r, p_i, x_r, x_i);
+						}
+					}
+
+					for (Types::fint_t v = 0; v < staticVectors; ++v)
+					{
+						store(&state[v * vC + k + nR * real], s_r[v]); // state: e^i*omega (real)
+						store(&state[v * vC + k + nR * imag], s_i[v]); // state: e^i*omega (imag)
+					}
+				}
+			}
+
+#ifdef CPL_CCOMPLEX_RESONATOR_PSABI
+	#pragma GCC diagnostic pop
+#endif
+
+			/// <summary>
+			/// Resonators windowed at a time by getWholeWindowedState(). A multiple of 16.
+			/// </summary>
+			static constexpr std::size_t windowTile = 64;
+
+			/// <summary>
+			/// Combines the vectors of the resonators [start, start + count) with the window taps, scaled by their gains.
+			/// start must be a multiple of 16. Whole vectors of V are written, so the parts must hold count rounded up to V.
+			/// </summary>
+			template<typename V>
+			void applyWindow(const Constant& constant, WindowTypes win, std::size_t channel, std::size_t start, std::size_t count, Scalar * realParts, Scalar * imagParts)
+			{
+				using namespace cpl::simd;
+
+				auto const vfactor = suitable_container<V>::size;
+
+				std::size_t nR = constant.numResonators;
+				std::size_t vC = nR * 2; // space filled by a vector buf
+				std::size_t sC = vC * constant.numVectors; // space filled by all vector bufs
+
+				const Scalar * taps = &constant.windowTaps[(std::size_t)win * constant.numVectors];
+				const Scalar * channelState = &state[sC * channel];
+				const auto range = constant.windowRanges[(std::size_t)win];
+				const V scale = set1<V>(resonatorScales[(std::size_t)win]);
+
+				for (std::size_t k = start; k < start + count; k += vfactor)
+				{
+					V realPart = zero<V>(), imagPart = zero<V>();
+
+					for (std::size_t v = range.first; v < range.second; ++v)
+					{
+						const V tap = broadcast<V>(taps + v);
+						realPart += tap * load<V>(channelState + v * vC + k + nR * real);
+						imagPart += tap * load<V>(channelState + v * vC + k + nR * imag);
+					}
+
+					const V gain = scale * load<V>(&constant.normalization[k]);
+
+					store(realParts + k - start, realPart * gain);
+					store(imagParts + k - start, imagPart * gain);
+				}
+			}
+
+			/// <summary>
+			/// 10 * log10(power) within 1e-4 dB, clamped to the normal range of float. Branch free, so loops of it vectorize.
+			/// </summary>
+			static inline float powerToDecibels(float power) noexcept
+			{
+				power = std::min(std::max(power, std::numeric_limits<float>::min()), std::numeric_limits<float>::max());
+
+				std::int32_t bits;
+				std::memcpy(&bits, &power, sizeof(bits));
+
+				// power = m * 2^e, with m in [sqrt(0.5), sqrt(2))
+				const std::int32_t exponent = (bits - 0x3F3504F3) >> 23;
+				bits -= exponent << 23;
+
+				float m;
+				std::memcpy(&m, &bits, sizeof(m));
+
+				// ln(m) = 2 * atanh(t), |t| < 0.172
+				const float t = (m - 1) / (m + 1), t2 = t * t;
+				const float ln = 2 * t * (1 + t2 * (1.0f / 3 + t2 * (1.0f / 5 + t2 * (1.0f / 7))));
+
+				// 10 / ln(10), 10 * log10(2)
+				return 4.34294481903f * ln + 3.01029995664f * exponent;
+			}
+
+			template<typename Result>
+			static void formatWindowed(WindowedOutput format, const Scalar * realParts, const Scalar * imagParts, Result * results, std::size_t count)
+			{
+				switch (format)
+				{
+					case WindowedOutput::Complex:
+						for (std::size_t k = 0; k < count; ++k)
+						{
+							results[k * 2] = (Result)realParts[k];
+							results[k * 2 + 1] = (Result)imagParts[k];
+						}
+						break;
+					case WindowedOutput::Magnitude:
+						for (std::size_t k = 0; k < count; ++k)
+							results[k] = (Result)std::sqrt(realParts[k] * realParts[k] + imagParts[k] * imagParts[k]);
+						break;
+					case WindowedOutput::Decibels:
+						for (std::size_t k = 0; k < count; ++k)
+							results[k] = (Result)powerToDecibels((float)(realParts[k] * realParts[k] + imagParts[k] * imagParts[k]));
+						break;
+					case WindowedOutput::Phase:
+						for (std::size_t k = 0; k < count; ++k)
+							results[k] = (Result)std::atan2(imagParts[k], realParts[k]);
+						break;
+				}
+			}
+
 			static T resonatorScales[(std::size_t)WindowTypes::End];
 
 			static int initiateResonatorScale()
@@ -790,7 +1362,7 @@ namespace cpl
 				real = 0, imag = 1
 			};
 
-			cpl::aligned_vector<Scalar, 32u> state;
+			cpl::aligned_vector<Scalar, 64u> state;
 
 		};
 		template<typename T, std::size_t Channels>
@@ -800,4 +1372,9 @@ namespace cpl
 		const std::size_t CComplexResonator<T, Channels>::numChannels;
 	};
 };
+
+#ifdef CPL_CCOMPLEX_RESONATOR_PSABI
+	#undef CPL_CCOMPLEX_RESONATOR_PSABI
+#endif
+
 #endif
@@ -29,12 +29,12 @@
 #ifndef _IIRRESONATOR_H
 #define _IIRRESONATOR_H
 #include "../CMutex.h"
-#include "../CAudioBuffer.h"
 #include "../simd.h"
-#include "filterdesign.h"
 #include "../LibraryOptions.h"
 #include <vector>
-#include "../mathext.h"
+#include <complex>
+#include "../Mathext.h"
+#include "../lib/AlignedAllocator.h"
 
 namespace cpl
 {
@@ -45,8 +45,13 @@ namespace cpl
 
 		typedef T Scalar;
 
+		/// <summary>
+		/// Samples advanced at once by the block recurrence, see setBlockRecurrence().
+		/// </summary>
+		static const std::size_t blockSize = 4;
+
 		IIRResonator()
-			: minWindowSize(8), maxWindowSize(8), numFilters(0), lowpass(nullptr), vectorQ(2 * M_PI)
+			: minWindowSize(8), maxWindowSize(8), numFilters(0), lowpass(nullptr), vectorQ(2 * M_PI), resonatorStride(0), blockRecurrence(false)
 		{
 			for (int i = 0; i < numVectors; ++i)
 				realCoeff[i] = imagCoeff[i] = realState[i] = imagState[i] = nullptr;
@@ -67,6 +72,9 @@ namespace cpl
 			using namespace cpl::simd;
 			CFastMutex lock(this);
 
+			if (blockRecurrence)
+				return wresonateBlocks<V>(data, numSamples);
+
 			auto const vfactor = suitable_container<V>::size;
 			V t0;
 
@@ -177,6 +185,19 @@ namespace cpl
 			vectorQ = Q;
 		}
 
+		/// <summary>
+		/// If set, wresonate() advances blockSize samples at a time. Every oscillator value in a block is
+		/// computed from the state at the start of it using precomputed powers, and the lowpass is applied
+		/// to the whole block at once as m[n + K] = c^K * m[n] + sum((1 - c) * c^(K - 1 - j) * t[j]),
+		/// so the serial dependency is per block instead of per sample.
+		/// Results differ from the per-sample recurrence by rounding.
+		/// </summary>
+		void setBlockRecurrence(bool shouldUseBlocks)
+		{
+			CFastMutex lock(this);
+			blockRecurrence = shouldUseBlocks;
+		}
+
 
 		template<typename Vector>
 		void mapSystemHz(const Vector & mappedHz, int vSize, double sampleRate)
@@ -222,10 +243,10 @@ namespace cpl
 				{
 					auto const theta = mappedHz[i] + (z - (numVectors - 1) >> 1) * Q;
 					auto const omega = 2 * M_PI * theta / sampleRate;
-					auto const coeffs = dsp::filters::design<dsp::filters::type::resonator, 1, double>(omega);
+					auto const coeffs = std::polar(1.0, omega);
 
-					realCoeff[z][i] = coeffs.c[0].real();
-					imagCoeff[z][i] = coeffs.c[0].imag();
+					realCoeff[z][i] = coeffs.real();
+					imagCoeff[z][i] = coeffs.imag();
 					if (newData)
 					{
 						realState[z][i] = 1.0;
@@ -258,10 +279,10 @@ namespace cpl
 						int imdone[3] = {-1, 0, 1};
 						auto const omega = (2 * M_PI * mappedHz[i] + imdone[z] * hDiff) / sampleRate;
 
-						auto const coeffs = dsp::filters::design<dsp::filters::type::resonator, 1, double>(omega);
+						auto const coeffs = std::polar(1.0, omega);
 
-						realCoeff[z][i] = coeffs.c[0].real();
-						imagCoeff[z][i] = coeffs.c[0].imag();
+						realCoeff[z][i] = coeffs.real();
+						imagCoeff[z][i] = coeffs.imag();
 						if (newData)
 						{
 							realState[z][i] = 1.0;
@@ -286,6 +307,8 @@ namespace cpl
 				}
 				lowpass[i] = 0;
 			}
+
+			computeBlockPowers(numResonators);
 		}
 
 
@@ -334,10 +357,10 @@ namespace cpl
 				{
 					auto const theta = mappedRads[i] + (z - (numVectors - 1) >> 1) * Q;
 
-					auto const coeffs = dsp::filters::design<dsp::filters::type::resonator, 1, double>(theta);
+					auto const coeffs = std::polar(1.0, theta);
 
-					realCoeff[z][i] = coeffs.c[0].real();
-					imagCoeff[z][i] = coeffs.c[0].imag();
+					realCoeff[z][i] = coeffs.real();
+					imagCoeff[z][i] = coeffs.imag();
 					if (newData)
 					{
 						realState[z][i] = 1.0;
@@ -366,10 +389,10 @@ namespace cpl
 					{
 						auto const theta = mappedRads[i] + (z - (numVectors - 1) >> 1) * Q;
 
-						auto const coeffs = dsp::filters::design<dsp::filters::type::resonator, 1, double>(theta);
+						auto const coeffs = std::polar(1.0, theta);
 
-						realCoeff[z][i] = coeffs.c[0].real();
-						imagCoeff[z][i] = coeffs.c[0].imag();
+						realCoeff[z][i] = coeffs.real();
+						imagCoeff[z][i] = coeffs.imag();
 						if (newData)
 						{
 							realState[z][i] = 1.0;
@@ -394,6 +417,133 @@ namespace cpl
 				}
 				lowpass[i] = 0;
 			}
+
+			computeBlockPowers(numResonators);
+		}
+
+	private:
+
+		template<typename V, class MultiVector>
+		void wresonateBlocks(const MultiVector & data, std::size_t numSamples)
+		{
+			using namespace cpl;
+			using namespace cpl::simd;
+
+			auto const vfactor = suitable_container<V>::size;
+			const std::size_t K = blockSize;
+			const std::size_t numBlocks = numSamples / K;
+			const std::size_t nR = resonatorStride;
+
+			V t0;
+
+			for (Types::fint_t filter = 0; filter < numFilters; filter += vfactor)
+			{
+				const V
+					lpCoeff = load<V>(lowpass + filter),
+					cK = load<V>(blockPowers.data() + numVectors * (K + 1) * 2 * nR + filter);
+
+				for (std::size_t z = 0; z < numVectors; ++z)
+				{
+					// pointer to current sample
+					auto audioInput = data[0];
+					// g[j] at [j * 2], p^K at [K * 2], real and imag
+					const Scalar * powers = blockPowers.data() + z * (K + 1) * 2 * nR + filter;
+
+					const V
+						p_r = load<V>(realCoeff[z] + filter),
+						p_i = load<V>(imagCoeff[z] + filter),
+						pK_r = load<V>(powers + K * 2 * nR),
+						pK_i = load<V>(powers + K * 2 * nR + nR);
+
+					V
+						s_r = load<V>(realState[z] + filter),
+						s_i = load<V>(imagState[z] + filter),
+						m_r = load<V>(real[z] + filter),
+						m_i = load<V>(imag[z] + filter);
+
+					for (std::size_t block = 0; block < numBlocks; ++block)
+					{
+						// the oscillator is s * p^j through the block, so it factors out of the input sum:
+						// sum((1 - c) * c^(K - 1 - j) * s * p^j * x[j]) = s * sum(g[j] * x[j])
+						V q_r = zero<V>(), q_i = zero<V>();
+
+						for (std::size_t j = 0; j < K; ++j)
+						{
+							const V input = broadcast<V>(audioInput + j);
+							q_r = q_r + load<V>(powers + j * 2 * nR) * input;
+							q_i = q_i + load<V>(powers + j * 2 * nR + nR) * input;
+						}
+
+						m_r = m_r * cK + (s_r * q_r - s_i * q_i);
+						m_i = m_i * cK + (s_r * q_i + s_i * q_r);
+
+						t0 = s_r * pK_r - s_i * pK_i;
+						s_i = s_r * pK_i + s_i * pK_r;
+						s_r = t0;
+
+						audioInput += K;
+					}
+
+					for (std::size_t sample = numBlocks * K; sample < numSamples; ++sample)
+					{
+						V input = broadcast<V>(audioInput);
+
+						t0 = s_r * input;
+						m_r = t0 + lpCoeff * (m_r - t0);
+
+						t0 = s_i * input;
+						m_i = t0 + lpCoeff * (m_i - t0);
+
+						t0 = s_r * p_r - s_i * p_i;
+						s_i = s_r * p_i + s_i * p_r;
+						s_r = t0;
+
+						audioInput++;
+					}
+
+					store(realState[z] + filter, s_r);
+					store(imagState[z] + filter, s_i);
+					store(real[z] + filter, m_r);
+					store(imag[z] + filter, m_i);
+				}
+			}
+		}
+
+		/// <summary>
+		/// Computes the block coefficients g[j] = (1 - c) * c^(K - 1 - j) * p^j, p^K and c^K used by
+		/// wresonateBlocks() in double precision.
+		/// </summary>
+		void computeBlockPowers(std::size_t numResonators)
+		{
+			const std::size_t K = blockSize;
+
+			resonatorStride = numResonators;
+			blockPowers.resize(numVectors * (K + 1) * 2 * numResonators + numResonators);
+
+			for (std::size_t i = 0; i < numResonators; ++i)
+			{
+				const double c = lowpass[i];
+
+				for (std::size_t z = 0; z < numVectors; ++z)
+				{
+					const std::complex<double> p(realCoeff[z][i], imagCoeff[z][i]);
+					std::complex<double> power = 1;
+					auto powers = blockPowers.data() + z * (K + 1) * 2 * numResonators + i;
+
+					for (std::size_t j = 0; j < K; ++j)
+					{
+						const auto g = (1 - c) * std::pow(c, double(K - 1 - j)) * power;
+						powers[j * 2 * numResonators] = (Scalar)g.real();
+						powers[j * 2 * numResonators + numResonators] = (Scalar)g.imag();
+						power *= p;
+					}
+
+					powers[K * 2 * numResonators] = (Scalar)power.real();
+					powers[K * 2 * numResonators + numResonators] = (Scalar)power.imag();
+				}
+
+				blockPowers[numVectors * (K + 1) * 2 * numResonators + i] = (Scalar)std::pow(c, double(K));
+			}
 		}
 
 	public:
@@ -411,7 +561,10 @@ namespace cpl
 		double maxWindowSize;
 		double minWindowSize;
 		double vectorQ;
-		std::vector<Scalar, cpl::AlignmentAllocator<Scalar, 32u>> buffer;
+		cpl::aligned_vector<Scalar, 32u> buffer;
+		cpl::aligned_vector<Scalar, 32u> blockPowers;
+		std::size_t resonatorStride;
+		bool blockRecurrence;
 
 	};
 
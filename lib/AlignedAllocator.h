@@ -33,11 +33,12 @@
 #include <cstdlib>
 #include <vector>
 #include "../Misc.h"
+#include "PageStorage.h"
 
 namespace cpl
 {
 
-	template <typename T, std::size_t N = 16>
+	template <typename T, std::size_t N = 16, class Storage = HeapStorage>
 	class CAlignedAllocator
 	{
 	public:
@@ -55,7 +56,7 @@ namespace cpl
 		inline CAlignedAllocator() throw () { }
 
 		template <typename T2>
-		inline CAlignedAllocator(const CAlignedAllocator<T2, N> &) throw () { }
+		inline CAlignedAllocator(const CAlignedAllocator<T2, N, Storage> &) throw () { }
 
 		inline ~CAlignedAllocator() throw () { }
 
@@ -68,11 +69,11 @@ namespace cpl
 		}
 
 		inline pointer allocate(size_type n) {
-			return Misc::alignedMalloc<value_type, N>(n);
+			return Storage::template allocate<value_type, N>(n);
 		}
 
-		inline void deallocate(pointer p, size_type) {
-			Misc::alignedFree(p);
+		inline void deallocate(pointer p, size_type n) {
+			Storage::release(p, n);
 		}
 
 		inline void construct(pointer p, const value_type & wert) {
@@ -89,22 +90,25 @@ namespace cpl
 
 		template <typename T2>
 		struct rebind {
-			typedef CAlignedAllocator<T2, N> other;
+			typedef CAlignedAllocator<T2, N, Storage> other;
 		};
 
-		bool operator!=(const CAlignedAllocator<T, N>& other) const {
+		bool operator!=(const CAlignedAllocator& other) const {
 			return !(*this == other);
 		}
 
 		// Returns true if and only if storage allocated from *this
 		// can be deallocated from other, and vice versa.
 		// Always returns true for stateless allocators.
-		bool operator==(const CAlignedAllocator<T, N>& other) const {
+		bool operator==(const CAlignedAllocator& other) const {
 			return true;
 		}
 	};
 
 	template<class Ty, std::size_t alignment>
 	using aligned_vector = std::vector < Ty, CAlignedAllocator<Ty, alignment> >;
+
+	template<class Ty, std::size_t alignment>
+	using hugepage_vector = std::vector < Ty, CAlignedAllocator<Ty, alignment, HugePageStorage<>> >;
 };
 #endif
\ No newline at end of file
@@ -31,11 +31,15 @@
 #define CPL_SBLOCKFREE_DATAQUEUE_H
 
 #include "readerwriterqueue/readerwriterqueue.h"
+#include "SegmentedQueue.h"
 #include <vector>
 #include "../CMutex.h"
 #include "../Utility.h"
 #include <atomic>
 #include <type_traits>
+#include <algorithm>
+#include <cstddef>
+#include <xmmintrin.h>
 #include "weak_atomic.h"
 
 #if defined(__C11__) && defined(CPL_CLANG)
@@ -61,6 +65,12 @@ namespace cpl
 	/// 
 	/// This queue is further specialized in that pop's block the consumer thread until an entry is produced, if it
 	/// is empty. 
+	///
+	/// Storage is a chain of chunks (see CSegmentedQueue), so growing never causes pushes to fail.
+	///
+	/// Blocking is an eventcount: the consumer spins a while before registering itself as a waiter
+	/// and parking, and the producer only enters the kernel if a waiter is registered. A producer
+	/// that is outpaced by its consumer thus never makes a system call.
 	/// </summary>
 	template<typename T>
 	class CBlockingLockFreeQueueMovable
@@ -70,12 +80,7 @@ namespace cpl
 		friend struct ElementAccess;
 
 		CBlockingLockFreeQueueMovable(std::size_t initialSize, std::size_t maxSize)
-			: queue(new moodycamel::ReaderWriterQueue<T>(initialSize))
-			, oldQueue(nullptr)
-			, currentNumElements(initialSize)
-			, enqueuedDataAllocations(false)
-			, enqueuedQueueAllocations(false)
-			, maxElements(maxSize)
+			: queue(initialSize, maxSize)
 		{
 
 		}
@@ -89,27 +94,11 @@ namespace cpl
 		template<bool allocOnFail = false, bool enqueueNewAllocations = true>
 		bool pushElement(T && data)
 		{
-			if (allocOnFail)
-			{
-				if (queue.load()->enqueue(std::move(data)))
-				{
-					semaphore.signal();
-					return true;
-				}
-			}
-			else
-			{
-				if (queue.load()->try_enqueue(std::move(data)))
-				{
-					semaphore.signal();
-					return true;
-				}
-			}
-			if (enqueueNewAllocations)
-			{
-				enqueuedDataAllocations = true;
-			}
-			return false;
+			if (!queue.template pushElement<allocOnFail, enqueueNewAllocations>(std::move(data)))
+				return false;
+
+			signalElement();
+			return true;
 		}
 
 		/// <summary>
@@ -122,29 +111,39 @@ namespace cpl
 		/// <returns></returns>
 		bool popElementBlocking(T & data)
 		{
-			semaphore.wait();
-			if (oldQueue)
-			{
-				if (oldQueue->try_dequeue(data))
-				{
-					return true;
-				}
+			return popElementsBlocking(&data, 1) == 1;
+		}
 
-			}
-			// note that if the old queue is empty, and the new has an enqueued element, we can conclusively
-			// prove that it is safe to delete the old queue since it is (a) empty and (b) the thread state 
-			// for the producer is updated such that it uses all the new entities and will never use the old again.
-			// if we successfully dequeue an element, we can delete the old (if it exists).
-			if (queue.load()->try_dequeue(data))
+		/// <summary>
+		/// CONSUMER ONLY.
+		/// Blocks until at least one element is available, and then moves up to maxElements
+		/// of the firstly enqueued elements into the range starting at elements, in order.
+		/// Everything available is claimed with a single atomic operation, and dequeued
+		/// chunk by chunk, instead of paying for every element individually.
+		/// Returns the number of elements dequeued. If it returns zero, someone else signaled
+		/// the queue, probably indicating it wont be filled again.
+		/// </summary>
+		std::size_t popElementsBlocking(T * elements, std::size_t maxElements)
+		{
+			if (pendingReleases)
 			{
-				if (oldQueue)
-				{
-					delete oldQueue;
-					oldQueue = nullptr;
-				}
-				return true;
+				// each release is reported exactly once, like a signal of the semaphore.
+				pendingReleases--;
+				return 0;
 			}
-			return false;
+
+			if (!maxElements)
+				return 0;
+
+			const auto claimed = waitForElements(maxElements);
+			const auto count = queue.popElements(elements, claimed);
+
+			// a claimed signal without an element means the consumer was released.
+			// if nothing was dequeued, this call reports the first release; the rest are reported by the next calls.
+			if (const auto releases = claimed - count)
+				pendingReleases = count ? releases : releases - 1;
+
+			return count;
 		}
 
 		/// <summary>
@@ -153,7 +152,7 @@ namespace cpl
 		/// </summary>
 		void releaseConsumer()
 		{
-			semaphore.signal();
+			signalElement();
 		}
 
 		/// <summary>
@@ -166,38 +165,14 @@ namespace cpl
 		/// 
 		/// Thus you can use this function to automatically grow the queue if it begins to fill up, thereby
 		/// avoiding a full queue. This will NOT delete any enqueued elements, issue locks or in any way mess up 
-		/// ordering of concurrently enqueued elements.
+		/// ordering of concurrently enqueued elements, nor cause concurrent pushes to fail.
 		/// 
 		/// returns true if the queue was grown, otherwise false.
-		/// 
-		/// Note: You should always grow the queue preemptively, that is, before you dequeue it fully.
 		/// </summary>
 		/// <returns></returns>
 		bool grow(std::size_t minimumSize = 0, bool growth = false, float growthRequirement = 1.0f, int growthFactor = 2)
 		{
-			// old resize not done yet!
-			if (oldQueue)
-				return false;
-
-			auto currentSpaceFilled = queue.load()->size_approx();
-
-			std::size_t newSize(currentNumElements);
-
-			if ((growth && currentSpaceFilled > currentNumElements * growthRequirement) || enqueuedDataAllocations || enqueuedQueueAllocations)
-			{
-				newSize *= growthFactor;
-			}
-
-			newSize = std::min(maxElements, std::max(newSize, minimumSize));
-
-			if (newSize > currentNumElements)
-			{
-				oldQueue = queue.exchange(new moodycamel::ReaderWriterQueue<T>(newSize));
-				enqueuedDataAllocations = enqueuedQueueAllocations = false;
-				currentNumElements = newSize;
-				return true;
-			}
-			return false;
+			return queue.grow(minimumSize, growth, growthRequirement, growthFactor);
 		}
 
 		/// <summary>
@@ -206,7 +181,7 @@ namespace cpl
 		/// </summary>
 		std::size_t size() const noexcept
 		{
-			return currentNumElements;
+			return queue.size();
 		}
 		/// <summary>
 		/// ANY THREAD.
@@ -214,34 +189,84 @@ namespace cpl
 		/// </summary>
 		std::size_t enqueuededElements() const noexcept
 		{
-			return queue.load()->size_approx();
+			return queue.enqueuededElements();
 		}
 
-		~CBlockingLockFreeQueueMovable()
+		/// <summary>
+		/// ANY THREAD.
+		/// Returns how many times a push had to wake the parked consumer through the kernel.
+		/// </summary>
+		std::size_t kernelSignals() const noexcept
 		{
-			auto * q = queue.load();
-			if (oldQueue)
+			return wakeups.load(std::memory_order_relaxed);
+		}
+
+	protected:
+
+		/// <summary>
+		/// Publishes one signal to the consumer, only entering the kernel if it is asleep.
+		/// </summary>
+		void signalElement()
+		{
+			if (signals.fetch_add(1, std::memory_order_release) < 0)
 			{
-				delete oldQueue;
+				wakeups.fetch_add(1, std::memory_order_relaxed);
+				semaphore.signal();
 			}
-			delete q;
 		}
 
-	protected:
-		moodycamel::spsc_sema::Semaphore semaphore;
-		std::atomic<moodycamel::ReaderWriterQueue<T> *> queue;
-		moodycamel::ReaderWriterQueue<T> * oldQueue;
+		/// <summary>
+		/// CONSUMER ONLY.
+		/// Claims between 1 and maxElements signals, blocking if none are available.
+		/// </summary>
+		std::size_t waitForElements(std::size_t maxElements)
+		{
+			// parking costs a system call on both ends, so spin a while first.
+			for (int rounds = 0; rounds < spinRounds; ++rounds)
+			{
+				if (const auto claimed = tryClaimElements(maxElements))
+					return claimed;
 
-		std::size_t currentNumElements, maxElements;
+				_mm_pause();
+			}
 
+			if (signals.fetch_sub(1, std::memory_order_acquire) <= 0)
+				semaphore.wait();
+
+			return 1 + tryClaimElements(maxElements - 1);
+		}
+
+		std::size_t tryClaimElements(std::size_t maxElements)
+		{
+			auto current = signals.load(std::memory_order_relaxed);
+
+			while (current > 0 && maxElements)
+			{
+				const auto claimed = std::min(current, static_cast<std::ptrdiff_t>(maxElements));
+
+				if (signals.compare_exchange_weak(current, current - claimed, std::memory_order_acquire, std::memory_order_relaxed))
+					return static_cast<std::size_t>(claimed);
+			}
+
+			return 0;
+		}
+
+		/// <summary>
+		/// Rounds of pausing before the consumer parks; a few microseconds.
+		/// </summary>
+		static constexpr int spinRounds = 256;
+
+		moodycamel::spsc_sema::Semaphore semaphore;
 		/// <summary>
-		/// If set, try to grow the freeElements queue
+		/// The number of unclaimed signals; -1 if the consumer is asleep on the semaphore.
 		/// </summary>
-		weak_atomic<bool> enqueuedDataAllocations;
+		std::atomic<std::ptrdiff_t> signals{ 0 };
 		/// <summary>
-		/// If set, try to grow the queue.
+		/// Signals from releaseConsumer() claimed by the consumer, but not yet reported by popElementsBlocking()
 		/// </summary>
-		weak_atomic<bool> enqueuedQueueAllocations;
+		std::size_t pendingReleases = 0;
+		std::atomic<std::size_t> wakeups{ 0 };
+		CSegmentedQueue<T> queue;
 	};
 
 	template<typename T>
@@ -250,6 +275,7 @@ namespace cpl
 	public:
 
 		using CBlockingLockFreeQueueMovable<T>::CBlockingLockFreeQueueMovable;
+		using CBlockingLockFreeQueueMovable<T>::pushElement;
 
 		/// <summary>
 		/// PRODUCER ONLY.
@@ -260,27 +286,11 @@ namespace cpl
 		template<bool allocOnFail = false, bool enqueueNewAllocations = true>
 		bool pushElement(const T & data)
 		{
-			if (allocOnFail)
-			{
-				if (this->queue.load()->enqueue(data))
-				{
-					this->semaphore.signal();
-					return true;
-				}
-			}
-			else
-			{
-				if (this->queue.load()->try_enqueue(data))
-				{
-					this->semaphore.signal();
-					return true;
-				}
-			}
-			if (enqueueNewAllocations)
-			{
-				this->enqueuedDataAllocations = true;
-			}
-			return false;
+			if (!this->queue.template pushElement<allocOnFail, enqueueNewAllocations>(data))
+				return false;
+
+			this->signalElement();
+			return true;
 		}
 	};
 
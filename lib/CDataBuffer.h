@@ -32,11 +32,14 @@
 		Note: It is not guaranteed to use realloc, and may in fact be a wrapper
 		around std::vector. This can be checked through CDataBuffer<T>::is_std_vector > 0
 
+		Where memory comes from is decided by the Storage policy, see PageStorage.h.
+
 *************************************************************************************/
 
 #ifndef _CDATABUFFER_H
 #define _CDATABUFFER_H
 #include "../MacroConstants.h"
+#include "PageStorage.h"
 #include <vector>
 #include <cstdlib>
 #include <type_traits>
@@ -45,7 +48,7 @@
 namespace cpl
 {
 
-	template<typename T, std::size_t requiredAlignment = alignof(T)>
+	template<typename T, std::size_t requiredAlignment = alignof(T), class Storage = HeapStorage>
 	class CDataBuffer
 	{
 	public:
@@ -95,14 +98,14 @@ namespace cpl
 			std::memcpy(buffer, first, (last - first) * sizeof(T));
 		}
 
-		CDataBuffer(const CDataBuffer<T, requiredAlignment> & other)
+		CDataBuffer(const CDataBuffer & other)
 			: buffer(nullptr), bufSize(0)
 		{
 			resize(other.size);
 			std::memcpy(buffer, other.buffer, other.size * sizeof(T));
 		}
 
-		CDataBuffer(CDataBuffer<T> && other)
+		CDataBuffer(CDataBuffer && other)
 		{
 			bufSize = other.bufSize;
 			buffer = other.buffer;
@@ -110,7 +113,7 @@ namespace cpl
 			other.buffer = nullptr;
 		}
 
-		CDataBuffer & operator = (const CDataBuffer<T, requiredAlignment> & other)
+		CDataBuffer & operator = (const CDataBuffer & other)
 		{
 			clear();
 			resize(other.size);
@@ -118,8 +121,9 @@ namespace cpl
 			return *this;
 		}
 
-		CDataBuffer & operator = (CDataBuffer<T, requiredAlignment> && other)
+		CDataBuffer & operator = (CDataBuffer && other)
 		{
+			clear();
 			bufSize = other.bufSize;
 			buffer = other.buffer;
 			other.bufSize = 0;
@@ -136,7 +140,7 @@ namespace cpl
 		{
 			if (buffer)
 			{
-				Misc::alignedFree(buffer);
+				Storage::release(buffer, bufSize);
 			}
 			buffer = nullptr;
 			bufSize = 0;
@@ -149,7 +153,7 @@ namespace cpl
 		{
 			if (newSize != bufSize)
 			{
-				T * newBlock = Misc::alignedRealloc<T, alignment>(buffer, newSize);
+				T * newBlock = Storage::template reallocate<T, alignment>(buffer, bufSize, newSize);
 				if (!newBlock && newSize != 0)
 				{
 					// error allocating memory.
@@ -24,6 +24,7 @@
 	file:CFIFOEventSystem.h
 
 			A wait free SPSC message system, delivering messages asynchronously
+			in batches, optionally coalescing messages for the same target.
 
 *************************************************************************************/
 
@@ -32,12 +33,65 @@
 
 #include "readerwriterqueue/readerwriterqueue.h"
 #include <thread>
+#include <atomic>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <type_traits>
 #include "../Utility.h"
 
 namespace cpl
 {
+	/// <summary>
+	/// Default for CFIFOEventSystem: every message is delivered.
+	/// </summary>
+	struct NoCoalescing {};
 
-	template<class Message>
+	namespace detail
+	{
+		/// <summary>
+		/// Drops all but the latest message of each key in a batch, preserving the order of the survivors.
+		/// </summary>
+		template<class Message, class KeyOf>
+		struct FIFOEventCoalescer
+		{
+			typedef typename std::decay<decltype(std::declval<KeyOf>()(std::declval<const Message &>()))>::type Key;
+
+			std::size_t apply(Message * messages, std::size_t count)
+			{
+				seen.clear();
+				std::size_t kept = count;
+
+				for (std::size_t i = count; i-- > 0; )
+				{
+					if (seen.insert(KeyOf()(messages[i])).second && --kept != i)
+						messages[kept] = std::move(messages[i]);
+				}
+
+				std::move(messages + kept, messages + count, messages);
+				return count - kept;
+			}
+
+			std::unordered_set<Key> seen;
+		};
+
+		template<class Message>
+		struct FIFOEventCoalescer<Message, NoCoalescing>
+		{
+			std::size_t apply(Message * messages, std::size_t count) { return count; }
+		};
+	};
+
+	/// <summary>
+	/// Messages posted from one thread are delivered to the listener on an internal thread, in order.
+	/// The internal thread is only woken when it has gone idle, and drains everything posted until then
+	/// in batches of up to maxBatchSize.
+	///
+	/// If KeyOf is given, it is a functor type returning a hashable key for a message. Of several messages
+	/// with the same key in one batch only the latest is delivered, in the position of the latest
+	/// (latest value wins, like parameter changes to the same target).
+	/// </summary>
+	template<class Message, class KeyOf = NoCoalescing>
 	class CFIFOEventSystem : Utility::CNoncopyable
 	{
 	public:
@@ -47,28 +101,64 @@ namespace cpl
 		public:
 
 			virtual void onAsyncMessageEvent(Message & msg) = 0;
-			virtual ~AsyncEventListener() {};
-		};
 
-		CFIFOEventSystem(AsyncEventListener & l, std::size_t queueSize = 1)
-			: queue(queueSize), listener(&l)
-		{
-			if (!l)
+			/// <summary>
+			/// Receives each batch drained, after coalescing.
+			/// By default, calls onAsyncMessageEvent() for every message in order.
+			/// </summary>
+			virtual void onAsyncMessageBatch(Message * messages, std::size_t count)
 			{
-				CPL_RUNTIME_EXCEPTION("Null-pointer listener interface passed!");
+				for (std::size_t i = 0; i < count; ++i)
+					onAsyncMessageEvent(messages[i]);
 			}
 
-			asyncThread = std::thread(asyncSubsystem, this);
+			virtual ~AsyncEventListener() {};
+		};
+
+		CFIFOEventSystem(AsyncEventListener & l, std::size_t queueSize = 1, std::size_t maxBatchSize = 64)
+			: listener(&l), queue(queueSize), batch(std::max<std::size_t>(maxBatchSize, 1))
+		{
+			asyncThread = std::thread(&CFIFOEventSystem::asyncSubsystem, this);
 		}
 
+		/// <summary>
+		/// PRODUCER ONLY.
+		/// Returns false if the queue is full.
+		/// </summary>
 		bool postMessage(const Message & m)
 		{
-			if (queue.try_enqueue(m))
-			{
-				semaphore.signal();
-				return true;
-			}
-			return false;
+			if (!queue.try_enqueue(m))
+				return false;
+
+			publish(1);
+			return true;
+		}
+
+		/// <summary>
+		/// PRODUCER ONLY.
+		/// Posts messages in order until the queue is full, waking the internal thread at most once.
+		/// Returns how many were posted.
+		/// </summary>
+		std::size_t postMessages(const Message * messages, std::size_t count)
+		{
+			std::size_t posted = 0;
+
+			while (posted < count && queue.try_enqueue(messages[posted]))
+				posted++;
+
+			if (posted)
+				publish(posted);
+
+			return posted;
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// Returns how many times the internal thread has been woken to deliver messages.
+		/// </summary>
+		std::size_t wakeups() const noexcept
+		{
+			return wakeupCount.load(std::memory_order_relaxed);
 		}
 
 		~CFIFOEventSystem()
@@ -87,33 +177,70 @@ namespace cpl
 
 	private:
 
+		void publish(std::size_t count)
+		{
+			// only an idle consumer needs a signal, a busy one picks the messages up before going idle
+			if (pending.fetch_add(count, std::memory_order_acq_rel) == 0)
+				semaphore.signal();
+		}
+
 		void signalAsyncStop()
 		{
+			quit.store(true, std::memory_order_release);
 			semaphore.signal();
 		}
 
 		void asyncSubsystem()
 		{
-			Message msg;
 			while (true)
 			{
 				semaphore.wait();
-				if (!queue.try_dequeue(msg))
+
+				// messages posted before the stop are still delivered
+				const bool stop = quit.load(std::memory_order_acquire);
+				auto available = pending.load(std::memory_order_acquire);
+
+				if (available)
+					wakeupCount.fetch_add(1, std::memory_order_relaxed);
+
+				// everything counted in pending is already in the queue
+				while (available)
 				{
-					return; // signaled semaphore
+					drain(available);
+					available = pending.fetch_sub(available, std::memory_order_acq_rel) - available;
 				}
-				else
+
+				if (stop)
+					return;
+			}
+		}
+
+		void drain(std::size_t count)
+		{
+			while (count)
+			{
+				const auto chunk = std::min(count, batch.size());
+
+				for (std::size_t i = 0; i < chunk; ++i)
 				{
-					listener->onAsyncMessageEvent(msg);
+					const bool dequeued = queue.try_dequeue(batch[i]);
+					CPL_RUNTIME_ASSERTION(dequeued);
 				}
+
+				listener->onAsyncMessageBatch(batch.data(), coalescer.apply(batch.data(), chunk));
+				count -= chunk;
 			}
 		}
 
 		AsyncEventListener * listener;
-		std::thread asyncThread;
 		moodycamel::ReaderWriterQueue<Message> queue;
 		moodycamel::spsc_sema::Semaphore semaphore;
+		std::vector<Message> batch;
+		detail::FIFOEventCoalescer<Message, KeyOf> coalescer;
+		std::atomic<std::size_t> pending{ 0 }, wakeupCount{ 0 };
+		std::atomic<bool> quit{ false };
+		std::thread asyncThread;
 	};
 
 };
-#endif
\ No newline at end of file
+#endif
@@ -38,6 +38,7 @@
 
 #include "CDataBuffer.h"
 #include "../Mathext.h"
+#include <atomic>
 
 #ifdef _DEBUG
 #define NOEXCEPT_RELEASE
@@ -47,14 +48,14 @@
 
 namespace cpl
 {
-	template<typename T, std::size_t alignment = alignof(T)>
+	template<typename T, std::size_t alignment = alignof(T), class Storage = HeapStorage>
 	class CLIFOStream
 	{
 
 	public:
 
-		typedef CLIFOStream<T, alignment> CBuf;
-		typedef CDataBuffer<T, alignment> DataBuf;
+		typedef CLIFOStream<T, alignment, Storage> CBuf;
+		typedef CDataBuffer<T, alignment, Storage> DataBuf;
 
 		// TODO: ensure sizeof(T) >= 2
 		typedef typename std::make_signed<std::size_t>::type ssize_t;
@@ -66,7 +67,7 @@ namespace cpl
 		{
 		protected:
 			IteratorBase(const CBuf & parent)
-				: cursor(parent.cursor), bsize(parent.size), buffer(parent.memory), ncParent(&parent)
+				: cursor(parent.cursor), bsize(parent.size), buffer(parent.memory), ncParent(&parent), mirrored(parent.isMirrored())
 			{
 
 			}
@@ -106,6 +107,39 @@ namespace cpl
 			inline std::size_t size() const noexcept { return bsize; }
 			inline std::size_t cursorPosition() const noexcept { return cursor; }
 
+			/// <summary>
+			/// If set, buffer[i + size()] aliases buffer[i], so no window ever wraps (see CLIFOStream::isMirrored()).
+			/// </summary>
+			inline bool isMirrored() const noexcept { return mirrored; }
+
+			/// <summary>
+			/// Returns a pointer to length consecutive elements of the biased window, starting at offset.
+			/// If the ring is mirrored or the window doesn't wrap, this points directly into the ring;
+			/// otherwise the window is copied into scratch, which is returned. length is capped at size().
+			/// </summary>
+			const T * contiguous(std::size_t offset, std::size_t length, T * scratch) const noexcept
+			{
+				if (bsize == 0)
+					return buffer;
+
+				length = std::min(length, bsize);
+				const auto start = (cursor + offset % bsize) % bsize;
+
+				if (mirrored || start + length <= bsize)
+					return buffer + start;
+
+				forEachSpan(
+					[&](const T* span, std::size_t count, std::size_t index)
+					{
+						std::memcpy(scratch + index, span, count * sizeof(T));
+					},
+					offset,
+					length
+				);
+
+				return scratch;
+			}
+
 			/// <summary>
 			/// If index is zero, returns first(), otherwise returns second()
 			/// </summary>
@@ -126,6 +160,78 @@ namespace cpl
 				return index ? cursor : bsize - cursor;
 			}
 
+			/// <summary>
+			/// Calls f(span, count, index) for each of the (at most two) contiguous spans covering the biased
+			/// window [offset, offset + length), in order. index is the window position of span[0].
+			/// If the ring is mirrored, there is always exactly one span.
+			/// length is capped at size(). Use this to run vectorized code over the ring without wrapping per element.
+			/// </summary>
+			template<typename Functor>
+			void forEachSpan(Functor&& f, std::size_t offset = 0, std::size_t length = -1) const
+			{
+				spans(static_cast<const T*>(buffer), std::forward<Functor>(f), offset, length);
+			}
+
+			/// <summary>
+			/// Reads count elements of the biased window, starting at offset and skipping stride elements
+			/// at a time (wrapping around size()), into destination. A stride of N decimates by N.
+			/// </summary>
+			void copyStrided(T* destination, std::size_t count, std::size_t stride, std::size_t offset = 0) const noexcept
+			{
+				if (bsize == 0)
+					return;
+
+				auto position = (cursor + offset % bsize) % bsize;
+				stride %= bsize;
+
+				while (count)
+				{
+					// elements left until the position wraps around
+					const auto run = std::min(count, (bsize - 1 - position) / std::max<std::size_t>(stride, 1) + 1);
+					const T* source = buffer + position;
+
+					for (std::size_t i = 0; i < run; ++i)
+						destination[i] = source[i * stride];
+
+					destination += run;
+					count -= run;
+					position = (position + run * stride) % bsize;
+				}
+			}
+
+			/// <summary>
+			/// Returns the dot product of the biased window [offset, offset + length) and the length elements of
+			/// window. length is capped at size().
+			/// </summary>
+			T dot(const T* window, std::size_t length, std::size_t offset = 0) const noexcept
+			{
+				// independent accumulators, so the sum can be vectorized without reassociation
+				T sums[4] = { T(), T(), T(), T() };
+
+				forEachSpan(
+					[&](const T* span, std::size_t count, std::size_t index)
+					{
+						const T* other = window + index;
+						std::size_t i = 0;
+
+						for (; i + 4 <= count; i += 4)
+						{
+							sums[0] += span[i + 0] * other[i + 0];
+							sums[1] += span[i + 1] * other[i + 1];
+							sums[2] += span[i + 2] * other[i + 2];
+							sums[3] += span[i + 3] * other[i + 3];
+						}
+
+						for (; i < count; ++i)
+							sums[0] += span[i] * other[i];
+					},
+					offset,
+					length
+				);
+
+				return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+			}
+
 			/// <summary>
 			/// Alters the cursor position. Capped at size()
 			/// </summary>
@@ -152,12 +258,30 @@ namespace cpl
 
 		protected:
 
+			template<typename Pointer, typename Functor>
+			void spans(Pointer memory, Functor&& f, std::size_t offset, std::size_t length) const
+			{
+				if (bsize == 0)
+					return;
+
+				length = std::min(length, bsize);
+				const auto start = (cursor + offset % bsize) % bsize;
+				const auto first = mirrored ? length : std::min(length, bsize - start);
+
+				if (first)
+					f(memory + start, first, std::size_t(0));
+
+				if (length > first)
+					f(memory, length - first, first);
+			}
+
 			void absorb(IteratorBase && other) noexcept
 			{
 				cursor = other.cursor;
 				bsize = other.bsize;
 				buffer = other.buffer;
 				ncParent = other.ncParent;
+				mirrored = other.mirrored;
 				other.buffer = nullptr; other.ncParent = nullptr;
 			}
 
@@ -168,6 +292,7 @@ namespace cpl
 			T * buffer;
 
 			const CBuf * ncParent;
+			bool mirrored;
 		};
 
 		/// <summary>
@@ -189,6 +314,10 @@ namespace cpl
 		///				for(auto it = start; it != end; ++it)
 		///					*it;
 		///			}
+		///		4.
+		///			proxy.forEachSpan([](const T * span, std::size_t count, std::size_t index) { ... });
+		///		5.
+		///			auto window = proxy.contiguous(0, proxy.size(), scratch); // no copy if the ring is mirrored
 		/// For unbiased access, one can do:
 		///		1.
 		///			for(auto & el : proxy)
@@ -223,10 +352,10 @@ namespace cpl
 			inline const T & operator [] (std::size_t index) const NOEXCEPT_RELEASE
 			{
 				#ifdef _DEBUG
-				if (cursor + index < cursor)
+				if (this->cursor + index < this->cursor)
 					CPL_RUNTIME_EXCEPTION("Overflow error");
 				#endif
-				return this->buffer[(cursor + index) % this->bsize];
+				return this->buffer[(this->cursor + index) % this->bsize];
 			}
 
 			inline T & nonconst(std::size_t index) NOEXCEPT_RELEASE
@@ -236,10 +365,10 @@ namespace cpl
 					CPL_RUNTIME_EXCEPTION("Index out of bounds");
 				#endif
 				#ifdef _DEBUG
-				if (cursor + index < cursor)
+				if (this->cursor + index < this->cursor)
 					CPL_RUNTIME_EXCEPTION("Overflow error");
 				#endif
-				return this->buffer[(cursor + index) % this->bsize];
+				return this->buffer[(this->cursor + index) % this->bsize];
 			}
 			/// <summary>
 			/// Wraps around size, unbiased: index 0 = buffer cursor.
@@ -354,6 +483,15 @@ namespace cpl
 				return this->buffer + (!index) * this->cursor;
 			}
 
+			/// <summary>
+			/// Like IteratorBase::forEachSpan, but the spans are writable.
+			/// </summary>
+			template<typename Functor>
+			void forEachSpan(Functor&& f, std::size_t offset = 0, std::size_t length = -1)
+			{
+				this->spans(this->buffer, std::forward<Functor>(f), offset, length);
+			}
+
 			/// <summary>
 			/// Copies the data from memory into buffer at the head.
 			/// Safe for any bufSize, but it will wrap around.
@@ -411,10 +549,10 @@ namespace cpl
 			inline T & operator [] (std::size_t index) NOEXCEPT_RELEASE
 			{
 				#ifdef _DEBUG
-				if (cursor + index < cursor)
+				if (this->cursor + index < this->cursor)
 					CPL_RUNTIME_EXCEPTION("Overflow error");
 				#endif
-				return this->buffer[(cursor + index) % this->bsize];
+				return this->buffer[(this->cursor + index) % this->bsize];
 			}
 
 			/// <summary>
@@ -448,7 +586,7 @@ namespace cpl
 		};
 
 		CLIFOStream()
-			: cursor(), size(), capacity(), memory(), isUsingOwnBuffer(true), hasReader(), hasWriter()
+			: cursor(), size(), capacity(), memory(), isUsingOwnBuffer(true), readers(0), hasWriter()
 		{
 
 		}
@@ -466,11 +604,12 @@ namespace cpl
 			other.size = other.cursor = other.capacity = 0;
 			other.isUsingOwnBuffer = true;
 
-			if (other.hasReader || other.hasWriter)
+			if (other.readers.load(std::memory_order_relaxed) || other.hasWriter)
 			{
 				CPL_RUNTIME_EXCEPTION("CLIFOStream moved while it has either a reader or a writer");
 			}
-			hasReader = hasWriter = false;
+			readers = 0;
+			hasWriter = false;
 		}
 
 		CLIFOStream & operator = (const CBuf & other) = delete;
@@ -487,7 +626,7 @@ namespace cpl
 			{
 				CPL_RUNTIME_EXCEPTION("Unsafe reader created, while writer exists!");
 			}
-			hasReader = true;
+			readers.fetch_add(1, std::memory_order_relaxed);
 			return *this;
 		}
 
@@ -497,7 +636,7 @@ namespace cpl
 			#ifdef _DEBUG
 			proxyCount++;
 			#endif
-			if (hasReader)
+			if (readers.load(std::memory_order_relaxed))
 			{
 				CPL_RUNTIME_EXCEPTION("Unsafe writer created, while reader exists!");
 			}
@@ -510,7 +649,7 @@ namespace cpl
 		/// </summary>
 		void setCapacity(std::size_t newCapacity)
 		{
-			if (hasReader || hasWriter)
+			if (readers.load(std::memory_order_relaxed) || hasWriter)
 			{
 				CPL_RUNTIME_EXCEPTION("CLIFOStream resized while it is accessed!");
 			}
@@ -539,7 +678,7 @@ namespace cpl
 		/// </param>
 		void setSize(std::size_t newSize, bool modifyDataToFit = true, const T & dataFill = T())
 		{
-			if (hasReader || hasWriter)
+			if (readers.load(std::memory_order_relaxed) || hasWriter)
 			{
 				CPL_RUNTIME_EXCEPTION("CLIFOStream resized while it is accessed!");
 			}
@@ -556,7 +695,7 @@ namespace cpl
 		/// </summary>
 		void setStorageRequirements(std::size_t psize, std::size_t pcapacity, bool modifyDataToFit = true, const T & dataFill = T())
 		{
-			if (hasReader || hasWriter)
+			if (readers.load(std::memory_order_relaxed) || hasWriter)
 			{
 				CPL_RUNTIME_EXCEPTION("CLIFOStream resized while it is accessed!");
 			}
@@ -658,6 +797,17 @@ namespace cpl
 		std::size_t getCapacity() const noexcept { return capacity; }
 		std::size_t getCursor() const noexcept { return cursor; }
 
+		/// <summary>
+		/// Returns true if the storage repeats the ring right after itself, so views never wrap.
+		/// Requires MirroredStorage (where supported), the internal buffer, and a size equal to
+		/// the capacity and a multiple of MirroredStorage::granularity&lt;T&gt;().
+		/// Otherwise, views work on the usual split layout.
+		/// </summary>
+		bool isMirrored() const noexcept
+		{
+			return isUsingOwnBuffer && size != 0 && size == capacity && Storage::template mirrorBytes<T>(capacity) == size * sizeof(T);
+		}
+
 
 	private:
 		/// <summary>
@@ -753,14 +903,14 @@ namespace cpl
 				CPL_RUNTIME_EXCEPTION("Reader released while writer exists!");
 			}
 			#endif
-			hasReader = false;
+			readers.fetch_sub(1, std::memory_order_relaxed);
 		}
 
 		void releaseWriter(Writer & p)
 		{
 			#ifdef _DEBUG
 			proxyCount--;
-			if (hasReader)
+			if (readers.load(std::memory_order_relaxed))
 			{
 				CPL_RUNTIME_EXCEPTION("Writer released while reader exists!");
 			}
@@ -780,7 +930,11 @@ namespace cpl
 
 		T * memory;
 		bool isUsingOwnBuffer;
-		mutable bool hasReader, hasWriter;
+		/// <summary>
+		/// Number of live ProxyViews, which may be created concurrently.
+		/// </summary>
+		mutable std::atomic<int> readers;
+		mutable bool hasWriter;
 		DataBuf internalBuffer;
 
 	};
@@ -102,17 +102,42 @@ namespace cpl
 			return *this;
 		}
 
+		/// <summary>
+		/// Returns false if the message wasn't registered, or is already pending (in which case
+		/// it is delivered once).
+		/// </summary>
 		bool postMessage(CoalescedMessage & m)
 		{
-			auto it = messages.find(&m);
+			if (!setPending(m))
+				return false;
 
-			if (it != messages.end() && it->second.cas(true))
-			{
-				semaphore.signal();
-				return true;
-			}
+			wake();
+			return true;
+		}
+
+		/// <summary>
+		/// Posts several messages, waking the internal thread at most once.
+		/// Returns how many weren't already pending.
+		/// </summary>
+		std::size_t postMessages(CoalescedMessage * const * batch, std::size_t count)
+		{
+			std::size_t posted = 0;
+
+			for (std::size_t i = 0; i < count; ++i)
+				posted += setPending(*batch[i]) ? 1 : 0;
+
+			if (posted)
+				wake();
+
+			return posted;
+		}
 
-			return false;
+		/// <summary>
+		/// Returns how many times the internal thread has been woken to dispatch messages.
+		/// </summary>
+		std::size_t wakeups() const noexcept
+		{
+			return wakeupCount.load(std::memory_order_relaxed);
 		}
 
 		void registerMessageHandler(MessageHandler * handler)
@@ -172,8 +197,22 @@ namespace cpl
 			}
 		}
 
+		bool setPending(CoalescedMessage & m)
+		{
+			auto it = messages.find(&m);
+			return it != messages.end() && it->second.cas(true);
+		}
+
+		void wake()
+		{
+			// the internal thread clears this before scanning, so anything posted later signals again
+			if (!signaled.exchange(true, std::memory_order_acq_rel))
+				semaphore.signal();
+		}
+
 		void signalAsyncStop()
 		{
+			quitFlag.store(true, std::memory_order_release);
 			semaphore.signal();
 		}
 
@@ -187,24 +226,22 @@ namespace cpl
 				if (quitFlag.load(std::memory_order_acquire))
 					return;
 
-				bool hasMessagesBeenPosted = false;
+				wakeupCount.fetch_add(1, std::memory_order_relaxed);
+				signaled.exchange(false, std::memory_order_acq_rel);
 
 				for (auto && mit : messages)
 				{
 					if (mit.second.cas())
 					{
-						hasMessagesBeenPosted = true;
 						mit.first->post();
 					}
 				}
-
-				if (!hasMessagesBeenPosted)
-					return;
 			}
 		}
 
 
-		std::atomic_bool quitFlag;
+		std::atomic_bool quitFlag{ false }, signaled{ false };
+		std::atomic<std::size_t> wakeupCount{ 0 };
 		cpl::CMutex::Lockable listenerMutex;
 		std::set<MessageHandler *> handlers;
 		std::map<CoalescedMessage *, ABoolFlag> messages;
@@ -0,0 +1,271 @@
+/*************************************************************************************
+
+	cpl - cross-platform library - v. 0.1.0.
+
+	Copyright (C) 2023 Janus Lynggaard Thorborg (www.jthorborg.com)
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	See \licenses\ for additional details on licenses associated with this program.
+
+**************************************************************************************
+
+	file:ConcurrentLIFOStream.h
+
+		A history ring like CLIFOStream, with one writer and any number of
+		concurrent, lock-free readers validating what they read afterwards.
+
+*************************************************************************************/
+
+#ifndef CPL_CONCURRENTLIFOSTREAM_H
+#define CPL_CONCURRENTLIFOSTREAM_H
+
+#include "CDataBuffer.h"
+#include "../LibraryOptions.h"
+#include "../MacroConstants.h"
+#include "../Exceptions.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+namespace cpl
+{
+	/// <summary>
+	/// A ring of the latest size() elements written, where a single writer never waits and
+	/// readers never block it. Like a seqlock, the writer announces the range it is about to
+	/// overwrite, writes it and then publishes it; readers copy (or work directly on) a window
+	/// and afterwards check whether the writer reached into it in the meantime. If so, whatever was
+	/// read is discarded and retried.
+	///
+	/// The ring holds headroom elements more than the history, so readers of windows up to size()
+	/// only fail if the writer produces more than headroom elements while they read.
+	///
+	/// With MirroredStorage, and a size() + headroom that fills whole pages, windows are always a single span.
+	///
+	/// Positions are absolute element counts since construction (or resize()). Elements before the first
+	/// write read as T().
+	/// </summary>
+	template<typename T, std::size_t alignment = alignof(T), class Storage = HeapStorage>
+	class CConcurrentLIFOStream
+	{
+	public:
+
+		static_assert(std::is_trivially_copyable<T>::value, "Readers may copy elements while they are written");
+
+		/// <summary>
+		/// A window of published elements, in chronological order. The contents are only trustworthy
+		/// if validate() returns true after they have been read.
+		/// </summary>
+		class View
+		{
+		public:
+
+			/// <summary>
+			/// Calls f(span, count, index) for each of the (at most two) contiguous spans of the window, in order.
+			/// index is the window position of span[0].
+			/// </summary>
+			template<typename Functor>
+			void forEachSpan(Functor&& f) const
+			{
+				parent->spans(parent->storage.data(), start, count, std::forward<Functor>(f));
+			}
+
+			/// <summary>
+			/// Returns true if nothing in the window was overwritten before this call.
+			/// Call it after reading, and discard the results otherwise.
+			/// </summary>
+			bool validate() const noexcept
+			{
+				return parent->isIntact(start);
+			}
+
+			std::size_t size() const noexcept { return count; }
+			std::uint64_t startPosition() const noexcept { return start; }
+			std::uint64_t endPosition() const noexcept { return start + count; }
+
+		private:
+
+			friend class CConcurrentLIFOStream;
+
+			View(const CConcurrentLIFOStream& stream, std::uint64_t startPosition, std::size_t length) noexcept
+				: parent(&stream), start(startPosition), count(length)
+			{
+
+			}
+
+			const CConcurrentLIFOStream* parent;
+			std::uint64_t start;
+			std::size_t count;
+		};
+
+		CConcurrentLIFOStream(std::size_t historySize = 0, std::size_t headroom = 0)
+		{
+			resize(historySize, headroom);
+		}
+
+		CConcurrentLIFOStream(const CConcurrentLIFOStream&) = delete;
+		CConcurrentLIFOStream& operator = (const CConcurrentLIFOStream&) = delete;
+
+		/// <summary>
+		/// Reallocates and clears the ring. Not thread safe: no views or writes may be in progress.
+		/// </summary>
+		void resize(std::size_t historySize, std::size_t headroom = 0)
+		{
+			capacity = historySize + headroom;
+			history = historySize;
+
+			storage.clear();
+			storage.resize(capacity, T());
+
+			mirrored = capacity != 0 && Storage::template mirrorBytes<T>(capacity) == capacity * sizeof(T);
+
+			// start a full ring in, so every window of the history is valid from the beginning
+			writing.store(capacity, std::memory_order_relaxed);
+			written.store(capacity, std::memory_order_release);
+		}
+
+		/// <summary>
+		/// WRITER ONLY.
+		/// Appends count elements. If there are more than the ring holds, only the last ones are kept.
+		/// Wait-free.
+		/// </summary>
+		void write(const T* data, std::size_t count) noexcept
+		{
+			if (capacity == 0 || count == 0)
+				return;
+
+			const auto end = written.load(std::memory_order_relaxed) + count;
+
+			if (count > capacity)
+			{
+				data += count - capacity;
+				count = capacity;
+			}
+
+			// announce the range before touching it, so readers overlapping it fail validation
+			writing.store(end, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			spans(storage.data(), end - count, count,
+				[&](T* span, std::size_t length, std::size_t index)
+				{
+					std::memcpy(span, data + index, length * sizeof(T));
+				}
+			);
+
+			written.store(end, std::memory_order_release);
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// Returns a view of the latest count elements published, capped at size().
+		/// </summary>
+		View latest(std::size_t count) const noexcept
+		{
+			count = std::min(count, history);
+			return View(*this, written.load(std::memory_order_acquire) - count, count);
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// Returns a view of count elements ending at the absolute position end, which can't be
+		/// later than position(). The view may already be invalid, if end is old.
+		/// </summary>
+		View until(std::uint64_t end, std::size_t count) const CPL_NOEXCEPT_IF_RELEASE
+		{
+			#ifdef _DEBUG
+			if (end > written.load(std::memory_order_acquire))
+				CPL_RUNTIME_EXCEPTION("Reading unpublished elements");
+			#endif
+			count = std::min(count, capacity);
+			return View(*this, end - count, count);
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// Copies the latest count elements (capped at size()) into destination in chronological order,
+		/// retrying up to attempts times if the writer overtakes the copy.
+		/// Returns false if every attempt was torn, in which case destination is unspecified.
+		/// </summary>
+		bool copyLatest(T* destination, std::size_t count, int attempts = 4) const noexcept
+		{
+			while (attempts-- > 0)
+			{
+				const auto view = latest(count);
+
+				view.forEachSpan(
+					[&](const T* span, std::size_t length, std::size_t index)
+					{
+						std::memcpy(destination + index, span, length * sizeof(T));
+					}
+				);
+
+				if (view.validate())
+					return true;
+			}
+
+			return false;
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// Returns the absolute position of the end of the latest published element.
+		/// </summary>
+		std::uint64_t position() const noexcept
+		{
+			return written.load(std::memory_order_acquire);
+		}
+
+		/// <summary>
+		/// The longest window readable.
+		/// </summary>
+		std::size_t size() const noexcept { return history; }
+		std::size_t getCapacity() const noexcept { return capacity; }
+		bool isMirrored() const noexcept { return mirrored; }
+
+	private:
+
+		template<typename Pointer, typename Functor>
+		void spans(Pointer memory, std::uint64_t start, std::size_t count, Functor&& f) const
+		{
+			if (count == 0)
+				return;
+
+			const auto index = static_cast<std::size_t>(start % capacity);
+			const auto first = mirrored ? count : std::min(count, capacity - index);
+
+			f(memory + index, first, std::size_t(0));
+
+			if (count > first)
+				f(memory, count - first, first);
+		}
+
+		bool isIntact(std::uint64_t start) const noexcept
+		{
+			// orders the reads of the window before checking how far the writer got
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return writing.load(std::memory_order_relaxed) - start <= capacity;
+		}
+
+		std::size_t capacity, history;
+		bool mirrored;
+		CDataBuffer<T, alignment, Storage> storage;
+
+		alignas(CPL_CACHEALIGNMENT) std::atomic<std::uint64_t> writing;
+		std::atomic<std::uint64_t> written;
+	};
+};
+#endif
@@ -0,0 +1,203 @@
+/*************************************************************************************
+
+	cpl - cross-platform library - v. 0.1.0.
+
+	Copyright (C) 2022 Janus Lynggaard Thorborg (www.jthorborg.com)
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	See \licenses\ for additional details on licenses associated with this program.
+
+**************************************************************************************
+
+	file:LatencyHistogram.h
+
+		A wait-free, fixed-size log-linear (HDR style) histogram for latency samples.
+
+*************************************************************************************/
+
+#ifndef CPL_LATENCYHISTOGRAM_H
+#define CPL_LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <algorithm>
+
+namespace cpl
+{
+	/// <summary>
+	/// Records unsigned values into buckets of roughly constant relative precision (1 / 2^SubBucketBits),
+	/// from 0 up to 2^MaxBits - 1 (larger values are clamped).
+	/// Recording is wait-free and safe from any number of threads, including real-time threads.
+	/// Snapshots can be taken from any thread, concurrently with recording, in which case they may
+	/// be off by the samples being recorded concurrently.
+	/// Never allocates, except for snapshots.
+	/// </summary>
+	template<std::size_t SubBucketBits = 5, std::size_t MaxBits = 40>
+	class CLatencyHistogram
+	{
+		static_assert(SubBucketBits > 0 && MaxBits > SubBucketBits + 1 && MaxBits < 64, "Invalid histogram configuration");
+
+		static constexpr std::uint64_t subBuckets = std::uint64_t(1) << SubBucketBits;
+
+	public:
+
+		static constexpr std::uint64_t maxValue = (std::uint64_t(1) << MaxBits) - 1;
+		static constexpr std::size_t bucketCount = (MaxBits - SubBucketBits + 1) * subBuckets;
+
+		class Snapshot
+		{
+			friend class CLatencyHistogram;
+		public:
+
+			std::uint64_t count() const noexcept { return total; }
+			std::uint64_t max() const noexcept { return maximum; }
+			double mean() const noexcept { return total ? static_cast<double>(sum) / total : 0; }
+
+			/// <summary>
+			/// Returns the lower bound of the bucket holding the percentile (0 - 100) of recorded values.
+			/// </summary>
+			std::uint64_t percentile(double p) const noexcept
+			{
+				if (!total)
+					return 0;
+
+				const auto rank = static_cast<std::uint64_t>(std::clamp(p, 0.0, 100.0) * 0.01 * (total - 1)) + 1;
+
+				std::uint64_t accumulated = 0;
+
+				for (std::size_t i = 0; i < counts.size(); ++i)
+				{
+					accumulated += counts[i];
+
+					if (accumulated >= rank)
+						return std::min(lowerBound(i), maximum);
+				}
+
+				return maximum;
+			}
+
+			/// <summary>
+			/// Writes the summary as a JSON object. Values are multiplied by scale, to e.g. convert units.
+			/// </summary>
+			void writeJson(std::ostream& stream, double scale = 1) const
+			{
+				stream
+					<< "{\"count\":" << total
+					<< ",\"mean\":" << mean() * scale
+					<< ",\"p50\":" << percentile(50) * scale
+					<< ",\"p90\":" << percentile(90) * scale
+					<< ",\"p99\":" << percentile(99) * scale
+					<< ",\"p999\":" << percentile(99.9) * scale
+					<< ",\"max\":" << maximum * scale
+					<< "}";
+			}
+
+		private:
+
+			std::vector<std::uint64_t> counts;
+			std::uint64_t total = 0, sum = 0, maximum = 0;
+		};
+
+		CLatencyHistogram()
+		{
+			reset();
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// </summary>
+		void record(std::uint64_t value) noexcept
+		{
+			value = std::min(value, maxValue);
+
+			buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+			sum.fetch_add(value, std::memory_order_relaxed);
+
+			auto old = maximum.load(std::memory_order_relaxed);
+
+			while (old < value && !maximum.compare_exchange_weak(old, value, std::memory_order_relaxed))
+				;
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// </summary>
+		Snapshot snapshot() const
+		{
+			Snapshot ret;
+			ret.counts.resize(bucketCount);
+
+			for (std::size_t i = 0; i < bucketCount; ++i)
+			{
+				ret.counts[i] = buckets[i].load(std::memory_order_relaxed);
+				ret.total += ret.counts[i];
+			}
+
+			ret.sum = sum.load(std::memory_order_relaxed);
+			ret.maximum = maximum.load(std::memory_order_relaxed);
+
+			return ret;
+		}
+
+		/// <summary>
+		/// Not safe concurrently with record().
+		/// </summary>
+		void reset() noexcept
+		{
+			for (auto& b : buckets)
+				b.store(0, std::memory_order_relaxed);
+
+			sum.store(0, std::memory_order_relaxed);
+			maximum.store(0, std::memory_order_relaxed);
+		}
+
+		static std::size_t bucketIndex(std::uint64_t value) noexcept
+		{
+			if (value < 2 * subBuckets)
+				return static_cast<std::size_t>(value);
+
+			// floor(log2(value))
+			std::size_t magnitude = 0;
+
+			for (std::size_t step = 32; step; step >>= 1)
+			{
+				if (value >> (magnitude + step))
+					magnitude += step;
+			}
+
+			const auto shift = magnitude - SubBucketBits;
+
+			return static_cast<std::size_t>(shift * subBuckets + (value >> shift));
+		}
+
+		static std::uint64_t lowerBound(std::size_t index) noexcept
+		{
+			if (index < 2 * subBuckets)
+				return index;
+
+			const auto shift = index / subBuckets - 1;
+			return (index - shift * subBuckets) << shift;
+		}
+
+	private:
+
+		std::array<std::atomic<std::uint64_t>, bucketCount> buckets;
+		std::atomic<std::uint64_t> sum, maximum;
+	};
+};
+#endif
@@ -0,0 +1,401 @@
+/*************************************************************************************
+
+	cpl - cross-platform library - v. 0.1.0.
+
+	Copyright (C) 2023 Janus Lynggaard Thorborg (www.jthorborg.com)
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	See \licenses\ for additional details on licenses associated with this program.
+
+**************************************************************************************
+
+	file:LockFreeMPMCQueue.h
+
+		A bounded multiple producer, multiple consumer queue.
+		See Dmitry Vyukov's "Bounded MPMC queue", 1024cores.net
+
+*************************************************************************************/
+
+#ifndef CPL_LOCKFREEMPMCQUEUE_H
+#define CPL_LOCKFREEMPMCQUEUE_H
+
+#include <atomic>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <cstdint>
+#include <type_traits>
+#include <algorithm>
+#include "../LibraryOptions.h"
+
+namespace cpl
+{
+	/// <summary>
+	/// The MPMC counterpart of CLockFreeQueue, with the same interface, except every operation is safe from any thread.
+	///
+	/// Each slot carries a sequence number, so producers and consumers only contend on their own
+	/// (cache line separated) position counter, and the queue never allocates unless grown.
+	///
+	/// Growing closes the current ring and swaps in a bigger one. Producers that already claimed a slot in the
+	/// old ring still complete into it, so retired rings are kept (and drained first) until destruction - memory
+	/// stays bounded by maxSize.
+	/// Elements from one producer are dequeued in the order they were pushed. To keep that across growth,
+	/// consumers don't move on from a retired ring while a claimed slot in it is unpublished, so a producer
+	/// stalled inside pushElement() can delay consumers until it completes (as it can within a single ring).
+	/// </summary>
+	template<typename T>
+	class CLockFreeMPMCQueue
+	{
+		class Ring
+		{
+			struct Cell
+			{
+				std::atomic<std::size_t> sequence;
+				typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+				T* get() noexcept { return std::launder(reinterpret_cast<T*>(&storage)); }
+			};
+
+		public:
+
+			Ring(std::size_t capacity)
+				: mask(capacity - 1), cells(new Cell[capacity])
+			{
+				for (std::size_t i = 0; i < capacity; ++i)
+					cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+
+			~Ring()
+			{
+				const auto tail = enqueuePosition.load(std::memory_order_acquire) & ~closedBit;
+
+				for (auto position = dequeuePosition.load(std::memory_order_acquire); position != tail; ++position)
+				{
+					auto& cell = cells[position & mask];
+
+					if (cell.sequence.load(std::memory_order_acquire) == position + 1)
+						cell.get()->~T();
+				}
+			}
+
+			template<typename U>
+			bool tryPush(U&& data)
+			{
+				auto position = enqueuePosition.load(std::memory_order_relaxed);
+				Cell* cell;
+
+				for (;;)
+				{
+					if (position & closedBit)
+						return false;
+
+					cell = &cells[position & mask];
+					const auto sequence = cell->sequence.load(std::memory_order_acquire);
+					const auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+
+					if (difference == 0)
+					{
+						if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+							break;
+					}
+					// the slot still holds an element from the previous lap: full
+					else if (difference < 0)
+					{
+						return false;
+					}
+					else
+					{
+						position = enqueuePosition.load(std::memory_order_relaxed);
+					}
+				}
+
+				new (&cell->storage) T(std::forward<U>(data));
+				cell->sequence.store(position + 1, std::memory_order_release);
+
+				return true;
+			}
+
+			bool tryPop(T& data)
+			{
+				auto position = dequeuePosition.load(std::memory_order_relaxed);
+				Cell* cell;
+
+				for (;;)
+				{
+					cell = &cells[position & mask];
+					const auto sequence = cell->sequence.load(std::memory_order_acquire);
+					const auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1);
+
+					if (difference == 0)
+					{
+						if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+							break;
+					}
+					// the slot hasn't been written in this lap yet: empty
+					else if (difference < 0)
+					{
+						return false;
+					}
+					else
+					{
+						position = dequeuePosition.load(std::memory_order_relaxed);
+					}
+				}
+
+				auto element = cell->get();
+				data = std::move(*element);
+				element->~T();
+				cell->sequence.store(position + mask + 1, std::memory_order_release);
+
+				return true;
+			}
+
+			/// <summary>
+			/// Fails every later tryPush(). Slots claimed before this are still completed.
+			/// </summary>
+			void close() noexcept
+			{
+				enqueuePosition.fetch_or(closedBit, std::memory_order_acq_rel);
+			}
+
+			bool isClosed() const noexcept
+			{
+				return (enqueuePosition.load(std::memory_order_acquire) & closedBit) != 0;
+			}
+
+			/// <summary>
+			/// Returns true if a closed ring has handed out every slot claimed in it.
+			/// </summary>
+			bool isDrained() const noexcept
+			{
+				const auto tail = enqueuePosition.load(std::memory_order_acquire) & ~closedBit;
+				return dequeuePosition.load(std::memory_order_acquire) >= tail;
+			}
+
+			std::size_t sizeApprox() const noexcept
+			{
+				const auto tail = enqueuePosition.load(std::memory_order_relaxed) & ~closedBit;
+				const auto head = dequeuePosition.load(std::memory_order_relaxed);
+
+				return tail > head ? tail - head : 0;
+			}
+
+			std::size_t capacity() const noexcept { return mask + 1; }
+
+		private:
+
+			/// <summary>
+			/// Set in enqueuePosition when closed, which positions never reach.
+			/// </summary>
+			static constexpr std::size_t closedBit = ~(~std::size_t(0) >> 1);
+
+			const std::size_t mask;
+			std::unique_ptr<Cell[]> cells;
+
+			alignas(CPL_CACHEALIGNMENT) std::atomic<std::size_t> enqueuePosition{ 0 };
+			alignas(CPL_CACHEALIGNMENT) std::atomic<std::size_t> dequeuePosition{ 0 };
+		};
+
+		static std::size_t roundCapacity(std::size_t size) noexcept
+		{
+			std::size_t capacity = 2;
+			while (capacity < size)
+				capacity <<= 1;
+
+			return capacity;
+		}
+
+	public:
+
+		/// <param name="initialSize">Rounded up to a power of two, as is every size the queue grows to.</param>
+		CLockFreeMPMCQueue(std::size_t initialSize, std::size_t maxSize)
+			: maxElements(roundCapacity(std::max(initialSize, maxSize)))
+		{
+			rings[0] = new Ring(roundCapacity(initialSize));
+			ringCount.store(1, std::memory_order_release);
+		}
+
+		CLockFreeMPMCQueue(const CLockFreeMPMCQueue&) = delete;
+		CLockFreeMPMCQueue& operator = (const CLockFreeMPMCQueue&) = delete;
+
+		/// <summary>
+		/// ANY THREAD.
+		/// Tries to enqueue the input data.
+		/// if allocOnFail is false, it will never allocate memory and the complexity is deterministic (lock-free).
+		/// If allocOnFail is set and the queue is full, it is grown (locking and allocating) as long as it is below the maximum size.
+		/// If enqueueNewAllocations is set, a later call to grow() will increase the size, if this call fails.
+		/// </summary>
+		template<bool allocOnFail = false, bool enqueueNewAllocations = true>
+		bool pushElement(const T& data)
+		{
+			return push<allocOnFail, enqueueNewAllocations>(data);
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// See pushElement(const T&)
+		/// </summary>
+		template<bool allocOnFail = false, bool enqueueNewAllocations = true>
+		bool pushElement(T&& data)
+		{
+			return push<allocOnFail, enqueueNewAllocations>(std::move(data));
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// If true is returned, input data is filled with the firstly enqueued data of some producer.
+		/// </summary>
+		bool popElement(T& data)
+		{
+			const auto count = ringCount.load(std::memory_order_acquire);
+
+			// drain retired rings first, preserving the order of each producer
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				if (rings[i]->tryPop(data))
+					return true;
+
+				// a claimed slot is still being written: later elements of the same producer may already be
+				// in the next ring, and must not overtake it
+				if (i + 1 < count && !rings[i]->isDrained())
+					return false;
+			}
+
+			return false;
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// If any operations has failed and signaled the need for more allocations, this might be done now.
+		/// May lock and allocate memory.
+		///
+		/// Will grow the queue to minimumSize at least. If growth is set, then:
+		///		if space_used > total_space * growthRequirement then grow(max(minimumSize, size() * growthFactor)
+		///
+		/// returns true if the queue was grown, otherwise false.
+		/// </summary>
+		bool grow(std::size_t minimumSize = 0, bool growth = false, float growthRequirement = 1.0f, int growthFactor = 2)
+		{
+			std::lock_guard<std::mutex> lock(growMutex);
+
+			const auto count = ringCount.load(std::memory_order_relaxed);
+			const auto current = rings[count - 1]->capacity();
+
+			std::size_t newSize(current);
+
+			if ((growth && rings[count - 1]->sizeApprox() > current * growthRequirement) || enqueuedDataAllocations.load(std::memory_order_relaxed))
+			{
+				newSize *= growthFactor;
+			}
+
+			newSize = std::min(maxElements, roundCapacity(std::max(newSize, minimumSize)));
+
+			if (newSize > current && count < rings.size())
+			{
+				rings[count] = new Ring(newSize);
+				// sealed before the new ring is published, so consumers that see the new ring also see the final end of the old
+				rings[count - 1]->close();
+				ringCount.store(count + 1, std::memory_order_release);
+				enqueuedDataAllocations.store(false, std::memory_order_relaxed);
+				return true;
+			}
+
+			return false;
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// Returns the current capacity
+		/// </summary>
+		std::size_t size() const noexcept
+		{
+			return rings[ringCount.load(std::memory_order_acquire) - 1]->capacity();
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// Returns the current amount of enqueued elements (estimated)
+		/// </summary>
+		std::size_t enqueuededElements() const noexcept
+		{
+			const auto count = ringCount.load(std::memory_order_acquire);
+			std::size_t elements = 0;
+
+			for (std::size_t i = 0; i < count; ++i)
+				elements += rings[i]->sizeApprox();
+
+			return elements;
+		}
+
+		~CLockFreeMPMCQueue()
+		{
+			const auto count = ringCount.load(std::memory_order_acquire);
+
+			for (std::size_t i = 0; i < count; ++i)
+				delete rings[i];
+		}
+
+	private:
+
+		template<typename U>
+		bool pushCurrent(U&& data)
+		{
+			for (;;)
+			{
+				auto ring = rings[ringCount.load(std::memory_order_acquire) - 1];
+
+				if (ring->tryPush(std::forward<U>(data)))
+					return true;
+
+				// closed by a concurrent grow(), which is about to publish the next ring
+				if (!ring->isClosed())
+					return false;
+			}
+		}
+
+		template<bool allocOnFail, bool enqueueNewAllocations, typename U>
+		bool push(U&& data)
+		{
+			if (pushCurrent(std::forward<U>(data)))
+				return true;
+
+			if (allocOnFail && grow(size() * 2))
+			{
+				if (pushCurrent(std::forward<U>(data)))
+					return true;
+			}
+
+			if (enqueueNewAllocations)
+				enqueuedDataAllocations.store(true, std::memory_order_relaxed);
+
+			return false;
+		}
+
+		/// <summary>
+		/// All rings ever used, oldest first; the last is the current. Doubling from 2 elements can never exceed this.
+		/// </summary>
+		std::array<Ring*, sizeof(std::size_t) * 8> rings{};
+		std::atomic<std::size_t> ringCount{ 0 };
+		const std::size_t maxElements;
+
+		/// <summary>
+		/// If set, try to grow the queue
+		/// </summary>
+		std::atomic<bool> enqueuedDataAllocations{ false };
+		std::mutex growMutex;
+	};
+};
+#endif
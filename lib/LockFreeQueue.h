@@ -30,7 +30,7 @@
 #ifndef _SLOCKFREE_DATAQUEUE_H
 #define _SLOCKFREE_DATAQUEUE_H
 
-#include "readerwriterqueue/readerwriterqueue.h"
+#include "SegmentedQueue.h"
 #include <vector>
 #include "../CMutex.h"
 #include "../Utility.h"
@@ -57,6 +57,8 @@ namespace cpl
 	/// 
 	/// This queue relies on objects being easy to copy & move construct, thus objects are not allocated on the heap.
 	/// Use CLockFreeDataQueue if you only want your objects to be constructed and destructed once.
+	///
+	/// Storage is a chain of chunks (see CSegmentedQueue), so growing never causes pushes to fail.
 	/// </summary>
 	template<typename T>
 	class CLockFreeQueue
@@ -66,13 +68,7 @@ namespace cpl
 		friend struct ElementAccess;
 
 		CLockFreeQueue(std::size_t initialSize, std::size_t maxSize)
-			:
-			queue(new moodycamel::ReaderWriterQueue<T>(initialSize)),
-			oldQueue(nullptr),
-			currentNumElements(initialSize),
-			enqueuedDataAllocations(false),
-			enqueuedQueueAllocations(false),
-			maxElements(maxSize)
+			: queue(initialSize, maxSize)
 		{
 
 		}
@@ -86,25 +82,7 @@ namespace cpl
 		template<bool allocOnFail = false, bool enqueueNewAllocations = true>
 		bool pushElement(const T & data)
 		{
-			if (allocOnFail)
-			{
-				if (queue.load()->enqueue(data))
-				{
-					return true;
-				}
-			}
-			else
-			{
-				if (queue.load()->try_enqueue(data))
-				{
-					return true;
-				}
-			}
-			if (enqueueNewAllocations)
-			{
-				enqueuedDataAllocations = true;
-			}
-			return false;
+			return queue.template pushElement<allocOnFail, enqueueNewAllocations>(data);
 		}
 
 		/// <summary>
@@ -115,28 +93,7 @@ namespace cpl
 		/// <returns></returns>
 		bool popElement(T & data)
 		{
-			if (oldQueue)
-			{
-				if (oldQueue->try_dequeue(data))
-				{
-					return true;
-				}
-
-			}
-			// note that if the old queue is empty, and the new has an enqueued element, we can conclusively
-			// prove that it is safe to delete the old queue since it is (a) empty and (b) the thread state 
-			// for the producer is updated such that it uses all the new entities and will never use the old again.
-			// if we successfully dequeue an element, we can delete the old (if it exists).
-			if (queue.load()->try_dequeue(data))
-			{
-				if (oldQueue)
-				{
-					delete oldQueue;
-					oldQueue = nullptr;
-				}
-				return true;
-			}
-			return false;
+			return queue.popElement(data);
 		}
 
 		/// <summary>
@@ -149,78 +106,28 @@ namespace cpl
 		/// 
 		/// Thus you can use this function to automatically grow the queue if it begins to fill up, thereby
 		/// avoiding a full queue. This will NOT delete any enqueued elements, issue locks or in any way mess up 
-		/// ordering of concurrently enqueued elements.
+		/// ordering of concurrently enqueued elements, nor cause concurrent pushes to fail.
 		/// 
 		/// returns true if the queue was grown, otherwise false.
-		/// 
-		/// Note: You should always grow the queue preemptively, that is, before you dequeue it fully.
 		/// </summary>
 		/// <returns></returns>
 		bool grow(std::size_t minimumSize = 0, bool growth = false, float growthRequirement = 1.0f, int growthFactor = 2)
 		{
-			// old resize not done yet!
-			if (oldQueue)
-				return false;
-
-			auto currentSpaceFilled = queue.load()->size_approx();
-			bool doRealloc(false);
-
-			std::size_t newSize(currentNumElements);
-
-			if ((growth && currentSpaceFilled > currentNumElements * growthRequirement) || enqueuedDataAllocations || enqueuedQueueAllocations)
-			{
-				newSize *= growthFactor;
-			}
-
-			newSize = std::min(maxElements, std::max(newSize, minimumSize));
-
-			if (newSize > currentNumElements)
-			{
-				oldQueue = queue.exchange(new moodycamel::ReaderWriterQueue<T>(newSize));
-				enqueuedDataAllocations = enqueuedQueueAllocations = false;
-				currentNumElements = newSize;
-				return true;
-			}
-			return false;
+			return queue.grow(minimumSize, growth, growthRequirement, growthFactor);
 		}
 
 		std::size_t size() const noexcept
 		{
-			return currentNumElements;
+			return queue.size();
 		}
 
 		std::size_t enqueuededElements() const noexcept
 		{
-			return queue.load()->size_approx();
-		}
-
-		~CLockFreeQueue()
-		{
-			auto * q = queue.load();
-			if (oldQueue)
-			{
-				delete oldQueue;
-			}
-			delete q;
-
-
+			return queue.enqueuededElements();
 		}
 
 	private:
-		moodycamel::spsc_sema::Semaphore s;
-		std::atomic<moodycamel::ReaderWriterQueue<T> *> queue;
-		moodycamel::ReaderWriterQueue<T> * oldQueue;
-
-		std::size_t currentNumElements, maxElements;
-
-		/// <summary>
-		/// If set, try to grow the freeElements queue
-		/// </summary>
-		volatile bool enqueuedDataAllocations;
-		/// <summary>
-		/// If set, try to grow the queue.
-		/// </summary>
-		volatile bool enqueuedQueueAllocations;
+		CSegmentedQueue<T> queue;
 	};
 };
 #endif
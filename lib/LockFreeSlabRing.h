@@ -0,0 +1,134 @@
+/*************************************************************************************
+
+	cpl - cross-platform library - v. 0.1.0.
+
+	Copyright (C) 2022 Janus Lynggaard Thorborg (www.jthorborg.com)
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	See \licenses\ for additional details on licenses associated with this program.
+
+**************************************************************************************
+
+	file:LockFreeSlabRing.h
+
+		A pre-allocated SPSC ring, handing out contiguous variable-sized slabs
+		to a producer that a consumer can read in place and release in order.
+
+*************************************************************************************/
+
+#ifndef CPL_LOCKFREE_SLABRING_H
+#define CPL_LOCKFREE_SLABRING_H
+
+#include "CDataBuffer.h"
+#include "../LibraryOptions.h"
+#include <atomic>
+#include <cstdint>
+
+namespace cpl
+{
+	/// <summary>
+	/// A single-producer, single-consumer ring of T's, where the producer reserves contiguous
+	/// regions ("slabs") of any size up to the capacity. If a slab doesn't fit before the end of
+	/// the ring, the remainder is skipped and the slab starts at the beginning.
+	///
+	/// The ring itself doesn't transfer anything: the producer is expected to hand the slab over
+	/// through some other synchronizing channel (like a queue), after which the consumer can read
+	/// the data in place and release it. Slabs must be released in the order they were acquired.
+	///
+	/// Never allocates memory after construction.
+	/// </summary>
+	template<typename T, std::size_t alignment = alignof(T)>
+	class CLockFreeSlabRing
+	{
+	public:
+
+		struct Slab
+		{
+			T* data;
+			/// <summary>
+			/// The absolute position of the end of this slab in the ring.
+			/// </summary>
+			std::uint64_t end;
+			std::size_t size;
+
+			bool isValid() const noexcept { return data != nullptr; }
+		};
+
+		CLockFreeSlabRing(std::size_t capacityInElements)
+			: storage(capacityInElements), capacity(capacityInElements)
+		{
+
+		}
+
+		/// <summary>
+		/// PRODUCER ONLY.
+		/// Tries to reserve a contiguous region of elements. Returns an invalid slab if there
+		/// isn't enough released space in the ring. Wait-free.
+		/// </summary>
+		Slab acquire(std::size_t elements) noexcept
+		{
+			if (elements == 0 || elements > capacity)
+				return { nullptr, writePosition, 0 };
+
+			const auto index = static_cast<std::size_t>(writePosition % capacity);
+			const std::uint64_t pad = index + elements > capacity ? capacity - index : 0;
+			const auto end = writePosition + pad + elements;
+
+			if (end - readPosition.load(std::memory_order_acquire) > capacity)
+				return { nullptr, writePosition, 0 };
+
+			previousWritePosition = writePosition;
+			writePosition = end;
+
+			return { storage.data() + (pad ? 0 : index), end, elements };
+		}
+
+		/// <summary>
+		/// PRODUCER ONLY.
+		/// Gives back the most recently acquired slab, in case it could not be handed over to the consumer.
+		/// </summary>
+		void revert(const Slab& slab) CPL_NOEXCEPT_IF_RELEASE
+		{
+			#ifdef _DEBUG
+			CPL_RUNTIME_ASSERTION(slab.end == writePosition);
+			#else
+			(void)slab;
+			#endif
+			writePosition = previousWritePosition;
+		}
+
+		/// <summary>
+		/// CONSUMER ONLY.
+		/// Releases the slab (and any previously acquired slabs) back to the producer.
+		/// </summary>
+		void release(const Slab& slab) noexcept
+		{
+			readPosition.store(slab.end, std::memory_order_release);
+		}
+
+		std::size_t size() const noexcept
+		{
+			return capacity;
+		}
+
+	private:
+
+		CDataBuffer<T, alignment> storage;
+		const std::size_t capacity;
+		std::uint64_t writePosition = 0, previousWritePosition = 0;
+		alignas(CPL_CACHEALIGNMENT) std::atomic<std::uint64_t> readPosition{};
+	};
+};
+#endif
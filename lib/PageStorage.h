@@ -0,0 +1,387 @@
+/*************************************************************************************
+
+	cpl - cross-platform library - v. 0.1.0.
+
+	Copyright (C) 2023 Janus Lynggaard Thorborg (www.jthorborg.com)
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	See \licenses\ for additional details on licenses associated with this program.
+
+**************************************************************************************
+
+	file:PageStorage.h
+
+		Storage policies for CDataBuffer, CAlignedAllocator and CLIFOStream.
+		HeapStorage is the default aligned heap; HugePageStorage backs large
+		buffers with huge pages, to reduce TLB misses on long histories.
+		MirroredStorage maps memory twice in a row, so rings never wrap.
+
+*************************************************************************************/
+
+#ifndef CPL_PAGESTORAGE_H
+#define CPL_PAGESTORAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "../Misc.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+#define CPL_HAS_MIRRORED_STORAGE
+#endif
+
+namespace cpl
+{
+	/// <summary>
+	/// Memory from the aligned heap (see Misc::alignedMalloc).
+	/// </summary>
+	struct HeapStorage
+	{
+		template<typename T, std::size_t alignment>
+		static T* allocate(std::size_t numObjects)
+		{
+			return Misc::alignedMalloc<T, alignment>(numObjects);
+		}
+
+		/// <summary>
+		/// Same behaviour as std::realloc, preserving contents.
+		/// </summary>
+		template<typename T, std::size_t alignment>
+		static T* reallocate(T* memory, std::size_t, std::size_t numObjects)
+		{
+			return Misc::alignedRealloc<T, alignment>(memory, numObjects);
+		}
+
+		template<typename T>
+		static void release(T* memory, std::size_t) noexcept
+		{
+			Misc::alignedFree(memory);
+		}
+
+		/// <summary>
+		/// If non-zero, the memory of numObjects is repeated after this many bytes (see MirroredStorage).
+		/// </summary>
+		template<typename T>
+		static std::size_t mirrorBytes(std::size_t) noexcept
+		{
+			return 0;
+		}
+	};
+
+	/// <summary>
+	/// Allocations of at least minimumBytes are mapped directly as huge pages on Linux - explicit (MAP_HUGETLB) pages
+	/// if any are reserved, otherwise transparent ones (MADV_HUGEPAGE) on a huge page aligned mapping.
+	/// Smaller allocations, and all allocations on other systems, use HeapStorage.
+	///
+	/// Pages are placed on the NUMA node of the thread first touching them. If prefault is set, all pages
+	/// are touched by the allocating thread; otherwise the thread first writing to each page decides, which
+	/// is what you want if the buffer is filled by a different (pinned) thread.
+	/// </summary>
+	template<bool prefault = false>
+	struct HugePageStorage
+	{
+		static constexpr std::size_t hugePageSize = 1 << 21;
+		static constexpr std::size_t minimumBytes = hugePageSize;
+
+		template<typename T, std::size_t alignment>
+		static T* allocate(std::size_t numObjects)
+		{
+			static_assert(alignment <= 4096, "Mapped memory is only page aligned");
+
+			const auto bytes = numObjects * sizeof(T);
+
+			if (!mapped(bytes))
+				return HeapStorage::allocate<T, alignment>(numObjects);
+
+			return static_cast<T*>(map(bytes));
+		}
+
+		template<typename T, std::size_t alignment>
+		static T* reallocate(T* memory, std::size_t oldObjects, std::size_t numObjects)
+		{
+			const auto oldBytes = oldObjects * sizeof(T), bytes = numObjects * sizeof(T);
+
+			if (!memory)
+				return allocate<T, alignment>(numObjects);
+
+			if (!numObjects)
+			{
+				release(memory, oldObjects);
+				return nullptr;
+			}
+
+			if (!mapped(oldBytes) && !mapped(bytes))
+				return HeapStorage::reallocate<T, alignment>(memory, oldObjects, numObjects);
+
+			if (mapped(oldBytes) && mapped(bytes) && mappingLength(oldBytes) == mappingLength(bytes))
+				return memory;
+
+			auto fresh = allocate<T, alignment>(numObjects);
+
+			if (fresh)
+			{
+				std::memcpy(fresh, memory, std::min(oldBytes, bytes));
+				release(memory, oldObjects);
+			}
+
+			return fresh;
+		}
+
+		template<typename T>
+		static void release(T* memory, std::size_t numObjects) noexcept
+		{
+			const auto bytes = numObjects * sizeof(T);
+
+			if (!mapped(bytes))
+				return HeapStorage::release(memory, numObjects);
+
+#ifdef __linux__
+			if (memory)
+				munmap(memory, mappingLength(bytes));
+#endif
+		}
+
+		template<typename T>
+		static std::size_t mirrorBytes(std::size_t) noexcept
+		{
+			return 0;
+		}
+
+	private:
+
+		static bool mapped(std::size_t bytes) noexcept
+		{
+#ifdef __linux__
+			return bytes >= minimumBytes;
+#else
+			return false;
+#endif
+		}
+
+		static std::size_t mappingLength(std::size_t bytes) noexcept
+		{
+			return (bytes + hugePageSize - 1) & ~(hugePageSize - 1);
+		}
+
+#ifdef __linux__
+		static void* map(std::size_t bytes) noexcept
+		{
+			const auto length = mappingLength(bytes);
+			const int protection = PROT_READ | PROT_WRITE, flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+			auto memory = mmap(nullptr, length, protection, flags | MAP_HUGETLB, -1, 0);
+
+			if (memory == MAP_FAILED)
+			{
+				// no reserved huge pages, so align a normal mapping for transparent ones to take over
+				auto region = static_cast<char*>(mmap(nullptr, length + hugePageSize, protection, flags, -1, 0));
+
+				if (region == MAP_FAILED)
+					return nullptr;
+
+				const auto head = (hugePageSize - (reinterpret_cast<std::uintptr_t>(region) & (hugePageSize - 1))) & (hugePageSize - 1);
+
+				if (head)
+					munmap(region, head);
+
+				munmap(region + head + length, hugePageSize - head);
+
+				memory = region + head;
+				madvise(memory, length, MADV_HUGEPAGE);
+			}
+
+			if (prefault)
+			{
+				volatile char* pages = static_cast<char*>(memory);
+
+				for (std::size_t i = 0; i < length; i += 4096)
+					pages[i] = 0;
+			}
+
+			return memory;
+		}
+#else
+		static void* map(std::size_t) noexcept { return nullptr; }
+#endif
+	};
+
+	/// <summary>
+	/// Maps the pages of an allocation twice in a row (a memfd mapped two times on Linux), so element i + n
+	/// aliases element i, where n * sizeof(T) = mirrorBytes(n). A ring of exactly that size can then read or write
+	/// any window of up to its size through a single pointer.
+	///
+	/// Mappings are rounded up to whole pages; CLIFOStream only uses the mirror if its size fills them exactly.
+	/// Where mirroring isn't available, this is HeapStorage and mirrorBytes() is zero.
+	/// </summary>
+	struct MirroredStorage
+	{
+		template<typename T, std::size_t alignment>
+		static T* allocate(std::size_t numObjects)
+		{
+			static_assert(alignment <= 4096, "Mapped memory is only page aligned");
+
+			const auto bytes = numObjects * sizeof(T);
+
+			if (!mapped(bytes))
+				return HeapStorage::allocate<T, alignment>(numObjects);
+
+			return static_cast<T*>(map(mappingLength(bytes)));
+		}
+
+		template<typename T, std::size_t alignment>
+		static T* reallocate(T* memory, std::size_t oldObjects, std::size_t numObjects)
+		{
+			const auto oldBytes = oldObjects * sizeof(T), bytes = numObjects * sizeof(T);
+
+			if (!memory)
+				return allocate<T, alignment>(numObjects);
+
+			if (!numObjects)
+			{
+				release(memory, oldObjects);
+				return nullptr;
+			}
+
+			if (!mapped(oldBytes) && !mapped(bytes))
+				return HeapStorage::reallocate<T, alignment>(memory, oldObjects, numObjects);
+
+			if (mapped(oldBytes) && mapped(bytes) && mappingLength(oldBytes) == mappingLength(bytes))
+				return memory;
+
+			auto fresh = allocate<T, alignment>(numObjects);
+
+			if (fresh)
+			{
+				std::memcpy(fresh, memory, std::min(oldBytes, bytes));
+				release(memory, oldObjects);
+			}
+
+			return fresh;
+		}
+
+		template<typename T>
+		static void release(T* memory, std::size_t numObjects) noexcept
+		{
+			const auto bytes = numObjects * sizeof(T);
+
+			if (!mapped(bytes))
+				return HeapStorage::release(memory, numObjects);
+
+#ifdef CPL_HAS_MIRRORED_STORAGE
+			if (memory)
+				munmap(memory, 2 * mappingLength(bytes));
+#endif
+		}
+
+		template<typename T>
+		static std::size_t mirrorBytes(std::size_t numObjects) noexcept
+		{
+			const auto bytes = numObjects * sizeof(T);
+			return mapped(bytes) ? mappingLength(bytes) : 0;
+		}
+
+		/// <summary>
+		/// Returns the granularity of mirrored mappings, in elements. Zero if mirroring isn't available.
+		/// </summary>
+		template<typename T>
+		static std::size_t granularity() noexcept
+		{
+			return available() ? pageSize() / sizeof(T) : 0;
+		}
+
+	private:
+
+		static bool mapped(std::size_t bytes) noexcept
+		{
+			return bytes != 0 && available();
+		}
+
+#ifdef CPL_HAS_MIRRORED_STORAGE
+		static std::size_t pageSize() noexcept
+		{
+			static const std::size_t size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+			return size;
+		}
+
+		static std::size_t mappingLength(std::size_t bytes) noexcept
+		{
+			return (bytes + pageSize() - 1) / pageSize() * pageSize();
+		}
+
+		/// <summary>
+		/// Decided once, so allocations and releases always agree on how memory was obtained.
+		/// </summary>
+		static bool available() noexcept
+		{
+			static const bool works = []
+			{
+				auto memory = static_cast<volatile char*>(map(pageSize()));
+
+				if (!memory)
+					return false;
+
+				memory[0] = 1;
+				const bool mirrors = memory[pageSize()] == 1;
+				munmap(const_cast<char*>(memory), 2 * pageSize());
+
+				return mirrors;
+			}();
+
+			return works;
+		}
+
+		static void* map(std::size_t length) noexcept
+		{
+			const int fd = memfd_create("cpl-mirror", MFD_CLOEXEC);
+
+			if (fd == -1)
+				return nullptr;
+
+			void* result = nullptr;
+
+			if (ftruncate(fd, static_cast<off_t>(length)) == 0)
+			{
+				// reserve the whole range first, so nothing else can end up in between
+				auto region = static_cast<char*>(mmap(nullptr, 2 * length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+
+				if (region != MAP_FAILED)
+				{
+					const int protection = PROT_READ | PROT_WRITE, flags = MAP_SHARED | MAP_FIXED;
+
+					if (mmap(region, length, protection, flags, fd, 0) != MAP_FAILED && mmap(region + length, length, protection, flags, fd, 0) != MAP_FAILED)
+						result = region;
+					else
+						munmap(region, 2 * length);
+				}
+			}
+
+			close(fd);
+			return result;
+		}
+#else
+		static std::size_t pageSize() noexcept { return 0; }
+		static std::size_t mappingLength(std::size_t) noexcept { return 0; }
+		static bool available() noexcept { return false; }
+		static void* map(std::size_t) noexcept { return nullptr; }
+#endif
+	};
+};
+#endif
@@ -0,0 +1,358 @@
+/*************************************************************************************
+
+	cpl - cross-platform library - v. 0.1.0.
+
+	Copyright (C) 2023 Janus Lynggaard Thorborg (www.jthorborg.com)
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	See \licenses\ for additional details on licenses associated with this program.
+
+**************************************************************************************
+
+	file:PoolAllocator.h
+
+		A thread-caching size-class allocator, for small allocations with
+		arbitrary lifetimes. Unlike ThreadAllocator, blocks may be freed in any
+		order and from any thread.
+
+*************************************************************************************/
+
+#ifndef CPL_POOL_ALLOCATOR_H
+#define CPL_POOL_ALLOCATOR_H
+
+#include <atomic>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <assert.h>
+#include <algorithm>
+#include "../Misc.h"
+
+namespace cpl
+{
+	/// <summary>
+	/// Every thread owns a cache of free lists, one per size class, carved out of slabs.
+	/// Allocating and freeing on the owning thread is a few non-atomic pointer operations.
+	/// Freeing a block owned by another thread pushes it onto that thread's remote list,
+	/// which the owner reclaims once its local free list runs dry.
+	///
+	/// Allocations larger than maxPooledSize or aligned to more than maxPooledAlignment
+	/// go to the heap. Like sized delete, free() takes the size and alignment the block was allocated with.
+	/// A cache outlives its thread until the last block it handed out is freed.
+	/// </summary>
+	class PoolAllocator
+	{
+	public:
+
+		static constexpr std::size_t slabSize = 1 << 16;
+		static constexpr std::size_t slabsPerArena = 16;
+		static constexpr std::size_t maxPooledSize = 2048;
+		static constexpr std::size_t maxPooledAlignment = 64;
+
+		/// <summary>
+		/// Returns the calling thread's cache.
+		/// </summary>
+		static PoolAllocator& get()
+		{
+			thread_local Owner owner;
+			return *owner.cache;
+		}
+
+		void* alloc(std::size_t align, std::size_t bytes)
+		{
+			assert((align & (align - 1)) == 0 && "Alignment must be a power of two");
+
+			if (!pooled(align, bytes))
+				return cpl::Misc::alignedBytesMalloc(bytes, align);
+
+			// blocks are aligned to the largest power of two dividing their size class, up to 64.
+			auto index = classIndex(std::max(bytes, align));
+
+			while (classAlignment(index) < align)
+				index++;
+
+			auto& list = freeLists[index];
+
+			if (!list && !reclaimRemote(index))
+				carve(index);
+
+			auto block = list;
+			list = block->next;
+			live++;
+
+			return block;
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// Frees a block allocated by any PoolAllocator, with the same alignment and size.
+		/// </summary>
+		static void free(void* p, std::size_t align, std::size_t bytes) noexcept
+		{
+			if (!pooled(align, bytes))
+			{
+				cpl::Misc::alignedFree(p);
+				return;
+			}
+
+			if (!p)
+				return;
+
+			auto slab = Slab::fromBlock(p);
+			auto owner = slab->owner;
+			auto block = static_cast<Block*>(p);
+
+			if (owner == current())
+			{
+				block->next = owner->freeLists[slab->sizeClass];
+				owner->freeLists[slab->sizeClass] = block;
+				owner->live--;
+			}
+			else
+			{
+				owner->freeRemote(block);
+			}
+		}
+
+		/// <summary>
+		/// Bytes reserved in slabs by this cache, whether in use or not.
+		/// </summary>
+		std::size_t reservedBytes() const noexcept
+		{
+			return arenas.size() * slabsPerArena * slabSize;
+		}
+
+		PoolAllocator(const PoolAllocator&) = delete;
+		PoolAllocator(PoolAllocator&&) = delete;
+		PoolAllocator& operator = (const PoolAllocator&) = delete;
+		PoolAllocator& operator = (PoolAllocator&&) = delete;
+
+	private:
+
+		static constexpr std::size_t numClasses = 14;
+		static constexpr std::size_t classSizes[numClasses] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048 };
+
+		/// <summary>
+		/// Remote frees count down from here; a cache is destroyed once both its thread
+		/// has exited and the remaining blocks have been freed.
+		/// </summary>
+		static constexpr std::ptrdiff_t liveBias = PTRDIFF_MAX / 2;
+
+		struct Block
+		{
+			Block* next;
+		};
+
+		/// <summary>
+		/// Headers sit at the start of slabSize-aligned memory, so any block finds its slab by masking.
+		/// </summary>
+		struct alignas(maxPooledAlignment) Slab
+		{
+			PoolAllocator* owner;
+			std::size_t sizeClass;
+
+			char* begin() noexcept { return reinterpret_cast<char*>(this) + sizeof(Slab); }
+			char* end() noexcept { return reinterpret_cast<char*>(this) + slabSize; }
+
+			static Slab* fromBlock(void* p) noexcept
+			{
+				return reinterpret_cast<Slab*>(reinterpret_cast<std::uintptr_t>(p) & ~static_cast<std::uintptr_t>(slabSize - 1));
+			}
+		};
+
+		struct Owner
+		{
+			Owner() : cache(new PoolAllocator()) {}
+			~Owner() { cache->threadExited(); }
+
+			PoolAllocator* cache;
+		};
+
+		PoolAllocator()
+		{
+			currentCache() = this;
+		}
+
+		~PoolAllocator()
+		{
+			for (auto arena : arenas)
+				cpl::Misc::alignedFree(arena);
+		}
+
+		static PoolAllocator*& currentCache() noexcept
+		{
+			thread_local PoolAllocator* cache = nullptr;
+			return cache;
+		}
+
+		static PoolAllocator* current() noexcept
+		{
+			return currentCache();
+		}
+
+		static bool pooled(std::size_t align, std::size_t bytes) noexcept
+		{
+			return bytes <= maxPooledSize && align <= maxPooledAlignment;
+		}
+
+		static std::size_t classIndex(std::size_t bytes) noexcept
+		{
+			std::size_t index = 0;
+			while (classSizes[index] < bytes)
+				index++;
+
+			return index;
+		}
+
+		static std::size_t classAlignment(std::size_t index) noexcept
+		{
+			const auto size = classSizes[index];
+			return std::min(size & (~size + 1), maxPooledAlignment);
+		}
+
+		/// <summary>
+		/// Splits a new slab into blocks of the size class.
+		/// </summary>
+		void carve(std::size_t index)
+		{
+			if (arenaSlabs == slabsPerArena)
+			{
+				// aligned allocations over-allocate by the alignment, so amortize it over an arena of slabs.
+				auto arena = static_cast<char*>(cpl::Misc::alignedBytesMalloc(slabsPerArena * slabSize, slabSize));
+
+				if (!arena)
+					throw std::bad_alloc();
+
+				arenas.push_back(arena);
+				arenaSlabs = 0;
+			}
+
+			auto slab = reinterpret_cast<Slab*>(arenas.back() + arenaSlabs++ * slabSize);
+
+			slab->owner = this;
+			slab->sizeClass = index;
+
+			const auto size = classSizes[index];
+			Block* list = nullptr;
+
+			// push in reverse, so blocks are handed out in address order
+			for (auto i = static_cast<std::size_t>(slab->end() - slab->begin()) / size; i-- > 0; )
+			{
+				auto block = reinterpret_cast<Block*>(slab->begin() + i * size);
+				block->next = list;
+				list = block;
+			}
+
+			freeLists[index] = list;
+		}
+
+		/// <summary>
+		/// Moves every block freed by other threads into the local free lists.
+		/// Returns whether the list of the size class got any.
+		/// </summary>
+		bool reclaimRemote(std::size_t index)
+		{
+			auto block = remoteFrees.exchange(nullptr, std::memory_order_acquire);
+
+			if (!block)
+				return false;
+
+			std::ptrdiff_t reclaimed = 0;
+
+			while (block)
+			{
+				auto next = block->next;
+				auto sizeClass = Slab::fromBlock(block)->sizeClass;
+				block->next = freeLists[sizeClass];
+				freeLists[sizeClass] = block;
+				block = next;
+				reclaimed++;
+			}
+
+			live -= reclaimed;
+			remoteLive.fetch_add(reclaimed, std::memory_order_relaxed);
+
+			return freeLists[index] != nullptr;
+		}
+
+		void freeRemote(Block* block) noexcept
+		{
+			auto top = remoteFrees.load(std::memory_order_relaxed);
+
+			do
+			{
+				block->next = top;
+			} while (!remoteFrees.compare_exchange_weak(top, block, std::memory_order_release, std::memory_order_relaxed));
+
+			if (remoteLive.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				delete this;
+		}
+
+		void threadExited() noexcept
+		{
+			currentCache() = nullptr;
+
+			// hand over the count of blocks still out there; remote frees finish the job.
+			const auto outstanding = live;
+
+			if (remoteLive.fetch_add(outstanding - liveBias, std::memory_order_acq_rel) == liveBias - outstanding)
+				delete this;
+		}
+
+		std::array<Block*, numClasses> freeLists{};
+		std::vector<char*> arenas;
+		std::size_t arenaSlabs = slabsPerArena;
+		/// <summary>
+		/// Blocks handed out and not freed locally or reclaimed.
+		/// </summary>
+		std::ptrdiff_t live = 0;
+
+		alignas(CPL_CACHEALIGNMENT) std::atomic<Block*> remoteFrees{ nullptr };
+		std::atomic<std::ptrdiff_t> remoteLive{ liveBias };
+	};
+
+	/// <summary>
+	/// A std allocator drawing from the PoolAllocator of the allocating thread.
+	/// Memory can be freed by any thread.
+	/// </summary>
+	template<typename T>
+	class pool_allocator
+	{
+	public:
+		typedef T value_type;
+
+		pool_allocator() noexcept = default;
+		template<typename U>
+		pool_allocator(const pool_allocator<U>&) noexcept {}
+
+		T* allocate(std::size_t n)
+		{
+			return static_cast<T*>(PoolAllocator::get().alloc(alignof(T), n * sizeof(T)));
+		}
+
+		void deallocate(T* p, std::size_t n) noexcept
+		{
+			PoolAllocator::free(p, alignof(T), n * sizeof(T));
+		}
+
+		template<typename U>
+		bool operator == (const pool_allocator<U>&) const noexcept { return true; }
+		template<typename U>
+		bool operator != (const pool_allocator<U>&) const noexcept { return false; }
+	};
+};
+#endif
@@ -0,0 +1,213 @@
+/*************************************************************************************
+
+	cpl - cross-platform library - v. 0.1.0.
+
+	Copyright (C) 2023 Janus Lynggaard Thorborg (www.jthorborg.com)
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	See \licenses\ for additional details on licenses associated with this program.
+
+**************************************************************************************
+
+	file:RealtimeMemoryResource.h
+
+		A pre-sized, lock-free std::pmr::memory_resource, that never calls
+		into the system after construction.
+
+*************************************************************************************/
+
+#ifndef CPL_REALTIMEMEMORYRESOURCE_H
+#define CPL_REALTIMEMEMORYRESOURCE_H
+
+#if __has_include(<memory_resource>)
+
+#define CPL_HAS_MEMORY_RESOURCE
+
+#include <memory_resource>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "../Misc.h"
+#include "../Exceptions.h"
+
+namespace cpl
+{
+	/// <summary>
+	/// Blocks of power-of-two size classes, from 16 bytes up to largestBlock, are all allocated
+	/// when constructed. Every class is a lock-free stack, so allocation and deallocation are safe
+	/// and wait-free in practice from any thread, including realtime ones.
+	///
+	/// A request is served from the smallest class that fits its size and alignment, or the next
+	/// that has any blocks left. If everything is exhausted (or the request is too large), it falls through
+	/// to the upstream resource, which by default is std::pmr::null_memory_resource() - throwing std::bad_alloc
+	/// instead of calling into the system.
+	/// </summary>
+	class RealtimeMemoryResource : public std::pmr::memory_resource
+	{
+	public:
+
+		static constexpr std::size_t smallestBlock = 16;
+
+		/// <param name="blocksPerClass">How many blocks to reserve of each size class.</param>
+		/// <param name="largestBlock">Rounded up to a power of two.</param>
+		RealtimeMemoryResource(std::size_t blocksPerClass, std::size_t largestBlock = 4096, std::pmr::memory_resource* upstreamResource = std::pmr::null_memory_resource())
+			: upstream(upstreamResource)
+		{
+			CPL_RUNTIME_ASSERTION(blocksPerClass > 0 && blocksPerClass < UINT32_MAX);
+
+			for (std::size_t size = smallestBlock; ; size <<= 1)
+			{
+				classes.emplace_back(std::make_unique<SizeClass>(size, blocksPerClass));
+
+				if (size >= largestBlock)
+					break;
+			}
+		}
+
+		RealtimeMemoryResource(const RealtimeMemoryResource&) = delete;
+		RealtimeMemoryResource& operator = (const RealtimeMemoryResource&) = delete;
+
+		/// <summary>
+		/// Returns how many requests were passed on to the upstream resource.
+		/// </summary>
+		std::size_t upstreamAllocations() const noexcept
+		{
+			return upstreamCount.load(std::memory_order_relaxed);
+		}
+
+	protected:
+
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override
+		{
+			const auto request = std::max(bytes, alignment);
+
+			for (auto& sizeClass : classes)
+			{
+				if (sizeClass->size < request)
+					continue;
+
+				if (auto p = sizeClass->pop())
+					return p;
+			}
+
+			upstreamCount.fetch_add(1, std::memory_order_relaxed);
+			return upstream->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+		{
+			// the block may have come from a larger class than requested, so search by address
+			for (auto& sizeClass : classes)
+			{
+				if (sizeClass->owns(p))
+				{
+					sizeClass->push(p);
+					return;
+				}
+			}
+
+			upstream->deallocate(p, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+
+	private:
+
+		/// <summary>
+		/// A Treiber stack of block indices. The head is tagged with a counter to avoid ABA,
+		/// and links are kept outside of the blocks, so a stale reader never touches user memory.
+		/// </summary>
+		struct SizeClass
+		{
+			SizeClass(std::size_t blockSize, std::size_t blockCount)
+				: size(blockSize)
+				, count(blockCount)
+				// every block is aligned to its (power of two) size, so requests are served by alignment as well
+				, memory(static_cast<char*>(cpl::Misc::alignedBytesMalloc(blockSize * blockCount, blockSize)))
+				, next(new std::atomic<std::uint32_t>[blockCount])
+			{
+				// index + 1, as zero is the empty stack
+				for (std::size_t i = 0; i < count; ++i)
+					next[i].store(static_cast<std::uint32_t>(i + 1 < count ? i + 2 : 0), std::memory_order_relaxed);
+
+				head.store(1, std::memory_order_release);
+			}
+
+			~SizeClass()
+			{
+				auto blocks = memory;
+				cpl::Misc::alignedFree(blocks);
+			}
+
+			void* pop() noexcept
+			{
+				auto current = head.load(std::memory_order_acquire);
+
+				for (;;)
+				{
+					const auto index = static_cast<std::uint32_t>(current);
+
+					if (!index)
+						return nullptr;
+
+					const std::uint64_t replacement = ((current >> 32) + 1) << 32 | next[index - 1].load(std::memory_order_relaxed);
+
+					if (head.compare_exchange_weak(current, replacement, std::memory_order_acquire, std::memory_order_acquire))
+						return memory + (index - 1) * size;
+				}
+			}
+
+			void push(void* p) noexcept
+			{
+				const auto index = static_cast<std::uint32_t>((static_cast<char*>(p) - memory) / size + 1);
+				auto current = head.load(std::memory_order_relaxed);
+
+				for (;;)
+				{
+					next[index - 1].store(static_cast<std::uint32_t>(current), std::memory_order_relaxed);
+
+					const std::uint64_t replacement = ((current >> 32) + 1) << 32 | index;
+
+					if (head.compare_exchange_weak(current, replacement, std::memory_order_release, std::memory_order_relaxed))
+						return;
+				}
+			}
+
+			bool owns(const void* p) const noexcept
+			{
+				auto location = static_cast<const char*>(p);
+				return location >= memory && location < memory + size * count;
+			}
+
+			const std::size_t size, count;
+			char* const memory;
+			std::unique_ptr<std::atomic<std::uint32_t>[]> next;
+			alignas(CPL_CACHEALIGNMENT) std::atomic<std::uint64_t> head{ 0 };
+		};
+
+		std::vector<std::unique_ptr<SizeClass>> classes;
+		std::pmr::memory_resource* upstream;
+		std::atomic<std::size_t> upstreamCount{ 0 };
+	};
+};
+
+#endif
+#endif
@@ -0,0 +1,357 @@
+/*************************************************************************************
+
+	cpl - cross-platform library - v. 0.1.0.
+
+	Copyright (C) 2023 Janus Lynggaard Thorborg (www.jthorborg.com)
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	See \licenses\ for additional details on licenses associated with this program.
+
+**************************************************************************************
+
+	file:SegmentedQueue.h
+
+		A single producer, single consumer queue of linked chunks, that grows
+		without ever swapping out storage the producer is using.
+
+*************************************************************************************/
+
+#ifndef CPL_SEGMENTEDQUEUE_H
+#define CPL_SEGMENTEDQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <type_traits>
+#include <algorithm>
+#include "../LibraryOptions.h"
+
+namespace cpl
+{
+	/// <summary>
+	/// The producer appends into a chain of chunks, and the consumer follows behind.
+	/// When the producer fills a chunk, it links a spare chunk to the chain. Spares are
+	/// allocated by the consumer in grow(), and drained chunks are recycled into spares as well,
+	/// so the producer never allocates (unless allowed to) and growing never invalidates anything
+	/// the producer may be writing to - a push only fails if every chunk really is in use.
+	/// </summary>
+	template<typename T>
+	class CSegmentedQueue
+	{
+		struct Chunk
+		{
+			typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+			Chunk(std::size_t size)
+				: capacity(size), slots(new Slot[size])
+			{
+
+			}
+
+			T* get(std::size_t index) noexcept { return std::launder(reinterpret_cast<T*>(&slots[index])); }
+
+			/// <summary>
+			/// Number of constructed elements, written by the producer.
+			/// </summary>
+			std::atomic<std::size_t> committed{ 0 };
+			/// <summary>
+			/// The following chunk, linked by the producer when this one is full.
+			/// </summary>
+			std::atomic<Chunk*> next{ nullptr };
+			/// <summary>
+			/// Link while in a list of spares.
+			/// </summary>
+			Chunk* nextSpare = nullptr;
+			const std::size_t capacity;
+			std::unique_ptr<Slot[]> slots;
+		};
+
+	public:
+
+		CSegmentedQueue(std::size_t initialSize, std::size_t maxSize)
+			: maxElements(std::max(initialSize, maxSize))
+		{
+			// round up like the ring this queue replaced, so existing fifo sizes keep their headroom
+			std::size_t roundedSize = 2;
+			while (roundedSize < initialSize)
+				roundedSize <<= 1;
+
+			initialSize = roundedSize;
+
+			// the chunk in use is partially consumed, so give an empty queue room for all of initialSize
+			const auto chunkSize = addCapacity(initialSize);
+			tail = head = new Chunk(chunkSize);
+			capacity.fetch_add(chunkSize, std::memory_order_relaxed);
+		}
+
+		CSegmentedQueue(const CSegmentedQueue&) = delete;
+		CSegmentedQueue& operator = (const CSegmentedQueue&) = delete;
+
+		/// <summary>
+		/// PRODUCER ONLY.
+		/// Tries to enqueue the input data.
+		/// if allocOnFail is false, it will never allocate memory and the complexity is deterministic (wait-free).
+		/// If enqueueNewAllocations is set, the consumer thread might increase the size at another time, if this call fails.
+		/// </summary>
+		template<bool allocOnFail = false, bool enqueueNewAllocations = true, typename U>
+		bool pushElement(U&& data)
+		{
+			if (tailIndex == tail->capacity)
+			{
+				auto fresh = takeSpare();
+
+				if (!fresh && allocOnFail)
+				{
+					fresh = new Chunk(tail->capacity);
+					capacity.fetch_add(fresh->capacity, std::memory_order_relaxed);
+				}
+
+				if (!fresh)
+				{
+					if (enqueueNewAllocations)
+						needsAllocations.store(true, std::memory_order_relaxed);
+
+					return false;
+				}
+
+				tail->next.store(fresh, std::memory_order_release);
+				tail = fresh;
+				tailIndex = 0;
+			}
+
+			new (&tail->slots[tailIndex]) T(std::forward<U>(data));
+			tail->committed.store(++tailIndex, std::memory_order_release);
+			pushed.store(pushed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+			return true;
+		}
+
+		/// <summary>
+		/// CONSUMER ONLY.
+		/// If true is returned, input data is filled with the firstly enqueued data.
+		/// </summary>
+		bool popElement(T& data)
+		{
+			return popElements(&data, 1) == 1;
+		}
+
+		/// <summary>
+		/// CONSUMER ONLY.
+		/// Moves up to maxElements of the firstly enqueued data into elements, returning how many.
+		/// Costs one acquire per chunk, not per element.
+		/// </summary>
+		std::size_t popElements(T* elements, std::size_t maxElements)
+		{
+			std::size_t count = 0;
+
+			while (count < maxElements)
+			{
+				const auto committed = head->committed.load(std::memory_order_acquire);
+
+				if (headIndex < committed)
+				{
+					const auto end = std::min(committed, headIndex + (maxElements - count));
+
+					for (; headIndex < end; ++headIndex)
+					{
+						auto element = head->get(headIndex);
+						elements[count++] = std::move(*element);
+						element->~T();
+					}
+
+					continue;
+				}
+
+				if (headIndex < head->capacity)
+					break;
+
+				// the producer has left a full chunk once it links the next one
+				auto next = head->next.load(std::memory_order_acquire);
+
+				if (!next)
+					break;
+
+				recycle(head);
+				head = next;
+				headIndex = 0;
+			}
+
+			if (count)
+				popped.store(popped.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+
+			return count;
+		}
+
+		/// <summary>
+		/// CONSUMER ONLY.
+		/// If any operations has failed and signaled the need for more allocations, this might be done now.
+		/// May allocate memory.
+		///
+		/// Will grow the queue to minimumSize at least. If growth is set, then:
+		///		if space_used > total_space * growthRequirement then grow(max(minimumSize, size() * growthFactor)
+		///
+		/// New capacity is added as spare chunks the producer picks up, so no enqueued or concurrently
+		/// enqueued elements are ever affected.
+		///
+		/// returns true if the queue was grown, otherwise false.
+		/// </summary>
+		bool grow(std::size_t minimumSize = 0, bool growth = false, float growthRequirement = 1.0f, int growthFactor = 2)
+		{
+			const auto current = size();
+			std::size_t newSize(current);
+
+			if ((growth && enqueuededElements() > current * growthRequirement) || needsAllocations.load(std::memory_order_relaxed))
+			{
+				newSize *= growthFactor;
+			}
+
+			newSize = std::min(maxElements, std::max(newSize, minimumSize));
+
+			if (newSize > current)
+			{
+				addCapacity(newSize - current);
+				needsAllocations.store(false, std::memory_order_relaxed);
+				return true;
+			}
+
+			return false;
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// Returns the current capacity
+		/// </summary>
+		std::size_t size() const noexcept
+		{
+			return capacity.load(std::memory_order_relaxed);
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// Returns the current amount of enqueued elements (estimated)
+		/// </summary>
+		std::size_t enqueuededElements() const noexcept
+		{
+			const auto out = popped.load(std::memory_order_relaxed);
+			const auto in = pushed.load(std::memory_order_relaxed);
+
+			return in > out ? in - out : 0;
+		}
+
+		~CSegmentedQueue()
+		{
+			for (auto chunk = head; chunk; )
+			{
+				const auto committed = chunk->committed.load(std::memory_order_acquire);
+
+				for (auto i = chunk == head ? headIndex : 0; i < committed; ++i)
+					chunk->get(i)->~T();
+
+				auto next = chunk->next.load(std::memory_order_acquire);
+				delete chunk;
+				chunk = next;
+			}
+
+			freeSpares(spares.exchange(nullptr, std::memory_order_acquire));
+			freeSpares(producerSpares);
+		}
+
+	private:
+
+		/// <summary>
+		/// A chunk is only reused once fully drained, so capacity is split into this many chunks
+		/// to keep at least (chunksPerAllocation - 1) / chunksPerAllocation of it available.
+		/// </summary>
+		static constexpr std::size_t chunksPerAllocation = 8;
+
+		/// <summary>
+		/// CONSUMER ONLY.
+		/// Returns the size of the added chunks.
+		/// </summary>
+		std::size_t addCapacity(std::size_t elements)
+		{
+			const auto chunkSize = (elements + chunksPerAllocation - 1) / chunksPerAllocation;
+
+			for (std::size_t added = 0; added < elements; added += chunkSize)
+				addSpare(new Chunk(std::min(chunkSize, elements - added)));
+
+			capacity.fetch_add(elements, std::memory_order_relaxed);
+			return chunkSize;
+		}
+
+		/// <summary>
+		/// CONSUMER ONLY.
+		/// </summary>
+		void addSpare(Chunk* chunk)
+		{
+			auto top = spares.load(std::memory_order_relaxed);
+
+			do
+			{
+				chunk->nextSpare = top;
+			} while (!spares.compare_exchange_weak(top, chunk, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		void recycle(Chunk* chunk)
+		{
+			chunk->committed.store(0, std::memory_order_relaxed);
+			chunk->next.store(nullptr, std::memory_order_relaxed);
+			addSpare(chunk);
+		}
+
+		/// <summary>
+		/// PRODUCER ONLY.
+		/// Takes every published spare at once, so there is no ABA problem against addSpare().
+		/// </summary>
+		Chunk* takeSpare() noexcept
+		{
+			if (!producerSpares)
+				producerSpares = spares.exchange(nullptr, std::memory_order_acquire);
+
+			auto ret = producerSpares;
+
+			if (ret)
+				producerSpares = ret->nextSpare;
+
+			return ret;
+		}
+
+		static void freeSpares(Chunk* list)
+		{
+			while (list)
+			{
+				auto next = list->nextSpare;
+				delete list;
+				list = next;
+			}
+		}
+
+		const std::size_t maxElements;
+		std::atomic<std::size_t> capacity{ 0 };
+		std::atomic<bool> needsAllocations{ false };
+		std::atomic<Chunk*> spares{ nullptr };
+
+		alignas(CPL_CACHEALIGNMENT) Chunk* tail;
+		std::size_t tailIndex = 0;
+		Chunk* producerSpares = nullptr;
+		std::atomic<std::size_t> pushed{ 0 };
+
+		alignas(CPL_CACHEALIGNMENT) Chunk* head;
+		std::size_t headIndex = 0;
+		std::atomic<std::size_t> popped{ 0 };
+	};
+};
+#endif
@@ -0,0 +1,204 @@
+/*************************************************************************************
+
+	cpl - cross-platform library - v. 0.1.0.
+
+	Copyright (C) 2023 Janus Lynggaard Thorborg (www.jthorborg.com)
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	See \licenses\ for additional details on licenses associated with this program.
+
+**************************************************************************************
+
+	file:WorkStealingDeque.h
+
+		A Chase-Lev work stealing deque of pointers.
+		See "Correct and Efficient Work-Stealing for Weak Memory Models", Lê et al. 2013
+
+*************************************************************************************/
+
+#ifndef CPL_WORKSTEALINGDEQUE_H
+#define CPL_WORKSTEALINGDEQUE_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "../LibraryOptions.h"
+
+namespace cpl
+{
+	/// <summary>
+	/// A lock-free deque where a single owner thread pushes and pops at the bottom (LIFO),
+	/// while any other thread may steal from the top (FIFO).
+	/// The owner grows the deque when full, old storage is retained until destruction
+	/// as thieves may still be reading from it.
+	/// </summary>
+	template<typename T>
+	class CWorkStealingDeque
+	{
+		static_assert(std::is_pointer<T>::value, "CWorkStealingDeque only stores pointers");
+
+		struct Array
+		{
+			Array(std::int64_t capacity)
+				: capacity(capacity), mask(capacity - 1), storage(new std::atomic<T>[capacity])
+			{
+
+			}
+
+			T get(std::int64_t index) const noexcept
+			{
+				return storage[index & mask].load(std::memory_order_relaxed);
+			}
+
+			void put(std::int64_t index, T element) noexcept
+			{
+				storage[index & mask].store(element, std::memory_order_relaxed);
+			}
+
+			std::int64_t capacity, mask;
+			std::unique_ptr<std::atomic<T>[]> storage;
+		};
+
+	public:
+
+		/// <param name="initialCapacity">Rounded up to a power of two</param>
+		CWorkStealingDeque(std::size_t initialCapacity = 256)
+		{
+			std::int64_t capacity = 2;
+			while (capacity < static_cast<std::int64_t>(initialCapacity))
+				capacity <<= 1;
+
+			arrays.emplace_back(std::make_unique<Array>(capacity));
+			array.store(arrays.back().get(), std::memory_order_relaxed);
+		}
+
+		CWorkStealingDeque(const CWorkStealingDeque&) = delete;
+		CWorkStealingDeque& operator = (const CWorkStealingDeque&) = delete;
+
+		/// <summary>
+		/// OWNER ONLY.
+		/// Pushes an element at the bottom, possibly growing the deque.
+		/// </summary>
+		void push(T element)
+		{
+			const auto b = bottom.load(std::memory_order_relaxed);
+			const auto t = top.load(std::memory_order_acquire);
+			auto a = array.load(std::memory_order_relaxed);
+
+			if (b - t > a->capacity - 1)
+				a = grow(a, b, t);
+
+			a->put(b, element);
+			// publishes the element (and whatever it points to) to thieves acquiring bottom.
+			// a release store, rather than a fence and a relaxed store, so thread sanitizers see the pairing as well.
+			bottom.store(b + 1, std::memory_order_release);
+		}
+
+		/// <summary>
+		/// OWNER ONLY.
+		/// Pops the most recently pushed element, or nullptr if empty.
+		/// </summary>
+		T pop() noexcept
+		{
+			const auto b = bottom.load(std::memory_order_relaxed) - 1;
+			auto a = array.load(std::memory_order_relaxed);
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			auto t = top.load(std::memory_order_relaxed);
+
+			T ret = nullptr;
+
+			if (t <= b)
+			{
+				ret = a->get(b);
+
+				if (t == b)
+				{
+					// last element, race against thieves
+					if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+						ret = nullptr;
+
+					bottom.store(b + 1, std::memory_order_relaxed);
+				}
+			}
+			else
+			{
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+
+			return ret;
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// Steals the oldest element, or returns nullptr if empty or if the steal lost a race.
+		/// </summary>
+		T steal() noexcept
+		{
+			auto t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const auto b = bottom.load(std::memory_order_acquire);
+
+			if (t < b)
+			{
+				// pairs with the release store in grow(), so a bigger array is seen with the elements copied into it.
+				// this is what consume would give, but compilers promote consume to acquire anyway.
+				auto a = array.load(std::memory_order_acquire);
+				T ret = a->get(t);
+
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					return nullptr;
+
+				return ret;
+			}
+
+			return nullptr;
+		}
+
+		/// <summary>
+		/// ANY THREAD.
+		/// Returns whether the deque was empty at some point during the call.
+		/// </summary>
+		bool empty() const noexcept
+		{
+			const auto t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const auto b = bottom.load(std::memory_order_acquire);
+			return b <= t;
+		}
+
+	private:
+
+		Array* grow(Array* old, std::int64_t b, std::int64_t t)
+		{
+			auto bigger = std::make_unique<Array>(old->capacity * 2);
+
+			for (auto i = t; i < b; ++i)
+				bigger->put(i, old->get(i));
+
+			arrays.emplace_back(std::move(bigger));
+			auto ret = arrays.back().get();
+			array.store(ret, std::memory_order_release);
+			return ret;
+		}
+
+		alignas(CPL_CACHEALIGNMENT) std::atomic<std::int64_t> top{ 0 };
+		alignas(CPL_CACHEALIGNMENT) std::atomic<std::int64_t> bottom{ 0 };
+		std::atomic<Array*> array;
+		std::vector<std::unique_ptr<Array>> arrays;
+	};
+};
+#endif
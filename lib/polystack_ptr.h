@@ -27,13 +27,18 @@
 		It is simply just created through make_polystack.
 		Allocation is done through a stack-based thread allocator. 
 
+		polypool_ptr is the same, created through make_polypool, but allocated 
+		through the PoolAllocator, so lifetimes needn't be nested.
+
 *************************************************************************************/
 
 #ifndef CPL_POLYSTACK_PTR_H
 #define CPL_POLYSTACK_PTR_H
 
 #include "ThreadAllocator.h"
+#include "PoolAllocator.h"
 #include <memory>
+#include <type_traits>
 
 namespace cpl
 {
@@ -62,6 +67,59 @@ namespace cpl
 		ptr.reset(static_cast<T*>(block.release()));
 		return ptr;
 	}
+
+	template<typename T>
+	class PoolDeleter
+	{
+	public:
+		PoolDeleter() noexcept = default;
+
+		/// <summary>
+		/// Keeps the size of the most derived type, so a polypool_ptr can be converted to one of a base.
+		/// </summary>
+		template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+		PoolDeleter(const PoolDeleter<U>& other) noexcept
+			: align(other.align), size(other.size)
+		{
+
+		}
+
+		void operator()(T* el)
+		{
+			void* memory = el;
+
+			if constexpr (std::is_polymorphic<T>::value)
+				memory = dynamic_cast<void*>(el);
+
+			el->~T();
+			PoolAllocator::free(memory, align, size);
+		}
+
+	private:
+		template<typename U>
+		friend class PoolDeleter;
+
+		std::size_t align = alignof(T), size = sizeof(T);
+	};
+
+	template<typename T>
+	using polypool_ptr = std::unique_ptr<T, PoolDeleter<T>>;
+
+	template<typename T, typename... Args>
+	inline polypool_ptr<T> make_polypool(Args&&... args)
+	{
+		auto memory = PoolAllocator::get().alloc(alignof(T), sizeof(T));
+
+		try
+		{
+			return polypool_ptr<T>(new (memory) T(std::forward<Args>(args)...));
+		}
+		catch (...)
+		{
+			PoolAllocator::free(memory, alignof(T), sizeof(T));
+			throw;
+		}
+	}
 }
 
 
@@ -36,6 +36,8 @@
 #include "simd/simd_consts.h"
 #include "simd/simd_math.h"
 #include "simd/simd_cast.h"
-#include "simd/simd_isa.h"
+#include "simd/simd_isa.h"
+#include "simd/simd_interleave.h"
+#include "simd/simd_half.h"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,301 @@
+/*************************************************************************************
+
+	cpl - cross-platform library - v. 0.1.0.
+
+	Copyright (C) 2023 Janus Lynggaard Thorborg (www.jthorborg.com)
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	See \licenses\ for additional details on licenses associated with this program.
+
+**************************************************************************************
+
+	file:simd_half.h
+
+		16-bit floating point storage types (IEEE binary16 and bfloat16),
+		with bulk conversions from and to float. binary16 uses F16C when
+		available at runtime, bfloat16 is converted with SSE2.
+
+*************************************************************************************/
+
+#ifndef CPL_SIMD_HALF_H
+#define CPL_SIMD_HALF_H
+
+#include "../Types.h"
+#include "../MacroConstants.h"
+#include "../system/SysStats.h"
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace cpl
+{
+	namespace simd
+	{
+		namespace detail
+		{
+			inline std::uint32_t float_bits(float value) noexcept
+			{
+				std::uint32_t bits;
+				std::memcpy(&bits, &value, sizeof(bits));
+				return bits;
+			}
+
+			inline float bits_float(std::uint32_t bits) noexcept
+			{
+				float value;
+				std::memcpy(&value, &bits, sizeof(value));
+				return value;
+			}
+
+			/// <summary>
+			/// Rounds to nearest even. Out of range values become infinity, NaNs stay (quiet) NaNs.
+			/// </summary>
+			inline std::uint16_t to_float16(float value) noexcept
+			{
+				std::uint32_t bits = float_bits(value);
+				const std::uint32_t sign = bits & 0x80000000u;
+				bits ^= sign;
+
+				std::uint32_t result;
+
+				if (bits >= (127u + 16) << 23)
+				{
+					// 65536 or above (or inf / nan)
+					result = bits > 0x7F800000u ? 0x7E00 : 0x7C00;
+				}
+				else if (bits < 113u << 23)
+				{
+					// subnormal or zero: adding a magic number aligns the 10 mantissa bits at the bottom,
+					// rounded by the fpu
+					const std::uint32_t magic = ((127 - 15) + (23 - 10) + 1) << 23;
+					result = float_bits(bits_float(bits) + bits_float(magic)) - magic;
+				}
+				else
+				{
+					const std::uint32_t odd = (bits >> 13) & 1;
+					// rebias the exponent, and round
+					bits += ((15u - 127) << 23) + 0xFFF + odd;
+					result = bits >> 13;
+				}
+
+				return static_cast<std::uint16_t>(result | (sign >> 16));
+			}
+
+			inline float from_float16(std::uint16_t half) noexcept
+			{
+				const std::uint32_t exponentMask = 0x7C00u << 13;
+
+				std::uint32_t bits = (half & 0x7FFFu) << 13;
+				const std::uint32_t exponent = bits & exponentMask;
+
+				bits += (127u - 15) << 23;
+
+				if (exponent == exponentMask)
+				{
+					// inf / nan
+					bits += (128u - 16) << 23;
+				}
+				else if (exponent == 0)
+				{
+					// zero / subnormal, renormalize
+					bits += 1 << 23;
+					bits = float_bits(bits_float(bits) - bits_float(113u << 23));
+				}
+
+				return bits_float(bits | (std::uint32_t)(half & 0x8000u) << 16);
+			}
+
+			/// <summary>
+			/// Rounds to nearest even, NaNs stay (quiet) NaNs.
+			/// </summary>
+			inline std::uint16_t to_bfloat16(float value) noexcept
+			{
+				const std::uint32_t bits = float_bits(value);
+
+				if ((bits & 0x7FFFFFFFu) > 0x7F800000u)
+					return static_cast<std::uint16_t>((bits >> 16) | 0x40);
+
+				return static_cast<std::uint16_t>((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+			}
+
+			inline float from_bfloat16(std::uint16_t half) noexcept
+			{
+				return bits_float((std::uint32_t)half << 16);
+			}
+		}
+
+		/// <summary>
+		/// IEEE 754 binary16: 11 significant bits (a relative error of at most 2^-11), normal from 6.1e-5 to 65504.
+		/// Values down to 6e-8 are kept as subnormals, with decreasing precision.
+		/// </summary>
+		struct float16
+		{
+			float16() = default;
+			float16(float value) noexcept : bits(detail::to_float16(value)) {}
+			operator float() const noexcept { return detail::from_float16(bits); }
+
+			std::uint16_t bits;
+		};
+
+		/// <summary>
+		/// The upper half of a float: 8 significant bits (a relative error of at most 2^-8), with the full range of float.
+		/// </summary>
+		struct bfloat16
+		{
+			bfloat16() = default;
+			bfloat16(float value) noexcept : bits(detail::to_bfloat16(value)) {}
+			operator float() const noexcept { return detail::from_bfloat16(bits); }
+
+			std::uint16_t bits;
+		};
+
+		template<typename T>
+		struct is_half_float : std::integral_constant<bool, std::is_same<T, float16>::value || std::is_same<T, bfloat16>::value> {};
+
+		namespace detail
+		{
+			struct half_kernels
+			{
+				// 4 floats to bfloat16 in the lower halves of 32-bit lanes, rounded to nearest even
+				static inline __m128i bfloat16x4(__m128 values) noexcept
+				{
+					const __m128i bits = _mm_castps_si128(values);
+					const __m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(1));
+					const __m128i rounded = _mm_add_epi32(bits, _mm_add_epi32(odd, _mm_set1_epi32(0x7FFF)));
+
+					const __m128i nan = _mm_castps_si128(_mm_cmpunord_ps(values, values));
+					const __m128i quiet = _mm_or_si128(bits, _mm_set1_epi32(0x400000));
+
+					// arithmetic shift, so the upper halves survive the signed saturation when packing
+					return _mm_srai_epi32(_mm_or_si128(_mm_and_si128(nan, quiet), _mm_andnot_si128(nan, rounded)), 16);
+				}
+
+				static void compressBF16(const float* source, bfloat16* destination, std::size_t n) noexcept
+				{
+					for (std::size_t i = 0; i < n; i += 8)
+					{
+						const __m128i lo = bfloat16x4(_mm_loadu_ps(source + i));
+						const __m128i hi = bfloat16x4(_mm_loadu_ps(source + i + 4));
+
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_packs_epi32(lo, hi));
+					}
+				}
+
+				static void expandBF16(const bfloat16* source, float* destination, std::size_t n) noexcept
+				{
+					const __m128i zero = _mm_setzero_si128();
+
+					for (std::size_t i = 0; i < n; i += 8)
+					{
+						const __m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+
+						_mm_storeu_ps(destination + i, _mm_castsi128_ps(_mm_unpacklo_epi16(zero, halves)));
+						_mm_storeu_ps(destination + i + 4, _mm_castsi128_ps(_mm_unpackhi_epi16(zero, halves)));
+					}
+				}
+
+#ifdef CPL_COMPILER_SUPPORTS_AVX
+				static CPL_F16C_TARGET void compressF16C(const float* source, float16* destination, std::size_t n) noexcept
+				{
+					for (std::size_t i = 0; i < n; i += 8)
+					{
+						const __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT);
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), halves);
+					}
+				}
+
+				static CPL_F16C_TARGET void expandF16C(const float16* source, float* destination, std::size_t n) noexcept
+				{
+					for (std::size_t i = 0; i < n; i += 8)
+					{
+						const __m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+						_mm256_storeu_ps(destination + i, _mm256_cvtph_ps(halves));
+					}
+				}
+#endif
+			};
+
+			inline bool half_has_f16c() noexcept
+			{
+#ifdef CPL_COMPILER_SUPPORTS_AVX
+				return system::CProcessor::test(system::CProcessor::F16C);
+#else
+				return false;
+#endif
+			}
+		}
+
+		/// <summary>
+		/// Converts n floats to float16 or bfloat16, rounding to nearest even.
+		/// </summary>
+		template<typename Half>
+		void compress(const float* source, Half* destination, std::size_t n)
+		{
+			static_assert(is_half_float<Half>::value, "Half must be float16 or bfloat16");
+
+			// whole tiles of 8 are done by the kernels
+			const std::size_t tiled = n & ~std::size_t(7);
+
+			if constexpr (std::is_same<Half, bfloat16>::value)
+			{
+				detail::half_kernels::compressBF16(source, destination, tiled);
+			}
+			else
+			{
+#ifdef CPL_COMPILER_SUPPORTS_AVX
+				if (detail::half_has_f16c())
+					detail::half_kernels::compressF16C(source, destination, tiled);
+				else
+#endif
+					for (std::size_t i = 0; i < tiled; ++i)
+						destination[i] = source[i];
+			}
+
+			for (std::size_t i = tiled; i < n; ++i)
+				destination[i] = source[i];
+		}
+
+		/// <summary>
+		/// Converts n float16 or bfloat16 back to floats, exactly.
+		/// </summary>
+		template<typename Half>
+		void expand(const Half* source, float* destination, std::size_t n)
+		{
+			static_assert(is_half_float<Half>::value, "Half must be float16 or bfloat16");
+
+			const std::size_t tiled = n & ~std::size_t(7);
+
+			if constexpr (std::is_same<Half, bfloat16>::value)
+			{
+				detail::half_kernels::expandBF16(source, destination, tiled);
+			}
+			else
+			{
+#ifdef CPL_COMPILER_SUPPORTS_AVX
+				if (detail::half_has_f16c())
+					detail::half_kernels::expandF16C(source, destination, tiled);
+				else
+#endif
+					for (std::size_t i = 0; i < tiled; ++i)
+						destination[i] = source[i];
+			}
+
+			for (std::size_t i = tiled; i < n; ++i)
+				destination[i] = source[i];
+		}
+	};
+};
+
+#endif
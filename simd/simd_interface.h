@@ -481,6 +481,93 @@ namespace cpl
 		{
 			*in = out;
 		}
+
+		#ifdef CPL_COMPILER_SUPPORTS_AVX512
+		// only usable from code compiled for (or dispatched to) avx512, see dynamic_isa_dispatch()
+		#define CPL_SIMD512_FUNC CPL_AVX512_TARGET inline
+
+		template<>
+		CPL_SIMD512_FUNC v16sf zero()
+		{
+			return _mm512_setzero_ps();
+		}
+
+		template<>
+		CPL_SIMD512_FUNC v8sd zero()
+		{
+			return _mm512_setzero_pd();
+		}
+
+		template<>
+		CPL_SIMD512_FUNC v16sf set1(const float in)
+		{
+			return _mm512_set1_ps(in);
+		}
+
+		template<>
+		CPL_SIMD512_FUNC v8sd set1(const double in)
+		{
+			return _mm512_set1_pd(in);
+		}
+
+		template<>
+		CPL_SIMD512_FUNC v16sf load(const float * in)
+		{
+			return _mm512_load_ps(in);
+		}
+
+		template<>
+		CPL_SIMD512_FUNC v16sf loadu(const float * in)
+		{
+			return _mm512_loadu_ps(in);
+		}
+
+		template<>
+		CPL_SIMD512_FUNC v8sd load(const double * in)
+		{
+			return _mm512_load_pd(in);
+		}
+
+		template<>
+		CPL_SIMD512_FUNC v8sd loadu(const double * in)
+		{
+			return _mm512_loadu_pd(in);
+		}
+
+		template<>
+		CPL_SIMD512_FUNC v16sf broadcast(const float * _in)
+		{
+			return _mm512_set1_ps(*_in);
+		}
+
+		template<>
+		CPL_SIMD512_FUNC v8sd broadcast(const double * _in)
+		{
+			return _mm512_set1_pd(*_in);
+		}
+
+		CPL_SIMD512_FUNC void store(float * in, const v16sf zmm)
+		{
+			_mm512_store_ps(in, zmm);
+		}
+
+		CPL_SIMD512_FUNC void storeu(float * in, const v16sf zmm)
+		{
+			_mm512_storeu_ps(in, zmm);
+		}
+
+		CPL_SIMD512_FUNC void store(double * in, const v8sd zmm)
+		{
+			_mm512_store_pd(in, zmm);
+		}
+
+		CPL_SIMD512_FUNC void storeu(double * in, const v8sd zmm)
+		{
+			_mm512_storeu_pd(in, zmm);
+		}
+
+		#undef CPL_SIMD512_FUNC
+		#endif
 		#ifndef CPL_MSVC
 		#define _mm256_set_m128i(hi, lo) (_mm256_inserti128_si256(_mm256_castsi128_si256(hi), lo, 1))
 		#define _mm256_set_m128(hi, lo) (_mm256_insertf128_ps(_mm256_castps128_ps256(hi), lo, 1))
@@ -571,6 +658,12 @@ namespace cpl
 		{
 			const auto factor = 8 / sizeof(Scalar);
 			using namespace cpl::system;
+			#ifdef CPL_COMPILER_SUPPORTS_AVX512
+			if (CProcessor::test(CProcessor::AVX512F))
+			{
+				return factor * 8;
+			}
+			#endif
 			if (CProcessor::test(CProcessor::AVX))
 			{
 				return factor * 4;
@@ -0,0 +1,364 @@
+/*************************************************************************************
+
+	cpl - cross-platform library - v. 0.1.0.
+
+	Copyright (C) 2023 Janus Lynggaard Thorborg (www.jthorborg.com)
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	See \licenses\ for additional details on licenses associated with this program.
+
+**************************************************************************************
+
+	file:simd_interleave.h
+
+		Conversion between interleaved and separate (planar) channel layouts.
+		Float data is transposed in 2, 4 and 8 channel tiles with SSE / AVX,
+		selected at runtime; everything else falls back to scalar code.
+
+*************************************************************************************/
+
+#ifndef CPL_SIMD_INTERLEAVE_H
+#define CPL_SIMD_INTERLEAVE_H
+
+#include "../Types.h"
+#include "simd_traits.h"
+#include "simd_interface.h"
+#include <cstring>
+#include <type_traits>
+
+namespace cpl
+{
+	namespace simd
+	{
+		namespace detail
+		{
+			/// <summary>
+			/// Planar channels, viewed as rows of a matrix.
+			/// Interleaved data is the same matrix transposed, with a row stride of the total channel count.
+			/// </summary>
+			struct interleave_kernels
+			{
+				// 4 samples of 4 channels, starting at channel offset, and row / column 'n'
+				static inline void deinterleave4(const float* source, std::size_t stride, float* const* dest, std::size_t n) noexcept
+				{
+					__m128 r0 = _mm_loadu_ps(source);
+					__m128 r1 = _mm_loadu_ps(source + stride);
+					__m128 r2 = _mm_loadu_ps(source + stride * 2);
+					__m128 r3 = _mm_loadu_ps(source + stride * 3);
+
+					_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+					_mm_storeu_ps(dest[0] + n, r0);
+					_mm_storeu_ps(dest[1] + n, r1);
+					_mm_storeu_ps(dest[2] + n, r2);
+					_mm_storeu_ps(dest[3] + n, r3);
+				}
+
+				static inline void interleave4(const float* const* source, std::size_t n, float* dest, std::size_t stride) noexcept
+				{
+					__m128 r0 = _mm_loadu_ps(source[0] + n);
+					__m128 r1 = _mm_loadu_ps(source[1] + n);
+					__m128 r2 = _mm_loadu_ps(source[2] + n);
+					__m128 r3 = _mm_loadu_ps(source[3] + n);
+
+					_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+					_mm_storeu_ps(dest, r0);
+					_mm_storeu_ps(dest + stride, r1);
+					_mm_storeu_ps(dest + stride * 2, r2);
+					_mm_storeu_ps(dest + stride * 3, r3);
+				}
+
+				// 4 stereo samples
+				static inline void deinterleave2(const float* source, float* left, float* right) noexcept
+				{
+					const __m128 a = _mm_loadu_ps(source);
+					const __m128 b = _mm_loadu_ps(source + 4);
+
+					_mm_storeu_ps(left, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+					_mm_storeu_ps(right, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+				}
+
+				static inline void interleave2(const float* left, const float* right, float* dest) noexcept
+				{
+					const __m128 l = _mm_loadu_ps(left);
+					const __m128 r = _mm_loadu_ps(right);
+
+					_mm_storeu_ps(dest, _mm_unpacklo_ps(l, r));
+					_mm_storeu_ps(dest + 4, _mm_unpackhi_ps(l, r));
+				}
+
+#ifdef CPL_COMPILER_SUPPORTS_AVX
+
+				static CPL_VECTOR_TARGET inline void transpose8(__m256 (&r)[8]) noexcept
+				{
+					const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+					const __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+					const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+					const __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+					const __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+					const __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+					const __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+					const __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+					const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+					const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+					const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+					const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+					const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+					const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+					const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+					const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+					r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+					r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+					r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+					r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+					r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+					r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+					r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+					r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+				}
+
+				static CPL_VECTOR_TARGET inline void deinterleave8(const float* source, std::size_t stride, float* const* dest, std::size_t n) noexcept
+				{
+					__m256 r[8];
+
+					for (std::size_t k = 0; k < 8; ++k)
+						r[k] = _mm256_loadu_ps(source + stride * k);
+
+					transpose8(r);
+
+					for (std::size_t k = 0; k < 8; ++k)
+						_mm256_storeu_ps(dest[k] + n, r[k]);
+				}
+
+				static CPL_VECTOR_TARGET inline void interleave8(const float* const* source, std::size_t n, float* dest, std::size_t stride) noexcept
+				{
+					__m256 r[8];
+
+					for (std::size_t k = 0; k < 8; ++k)
+						r[k] = _mm256_loadu_ps(source[k] + n);
+
+					transpose8(r);
+
+					for (std::size_t k = 0; k < 8; ++k)
+						_mm256_storeu_ps(dest + stride * k, r[k]);
+				}
+
+				// 8 stereo samples
+				static CPL_VECTOR_TARGET inline void deinterleave2x8(const float* source, float* left, float* right) noexcept
+				{
+					const __m256 a = _mm256_loadu_ps(source);
+					const __m256 b = _mm256_loadu_ps(source + 8);
+					const __m256 lo = _mm256_permute2f128_ps(a, b, 0x20);
+					const __m256 hi = _mm256_permute2f128_ps(a, b, 0x31);
+
+					_mm256_storeu_ps(left, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+					_mm256_storeu_ps(right, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+				}
+
+				static CPL_VECTOR_TARGET inline void interleave2x8(const float* left, const float* right, float* dest) noexcept
+				{
+					const __m256 l = _mm256_loadu_ps(left);
+					const __m256 r = _mm256_loadu_ps(right);
+					const __m256 lo = _mm256_unpacklo_ps(l, r);
+					const __m256 hi = _mm256_unpackhi_ps(l, r);
+
+					_mm256_storeu_ps(dest, _mm256_permute2f128_ps(lo, hi, 0x20));
+					_mm256_storeu_ps(dest + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+				}
+
+				// full 8 sample tiles of the channels given by interleave_tiled_channels(channels, 8)
+				static CPL_VECTOR_TARGET void deinterleaveAVX(const float* source, std::size_t channels, std::size_t samples, float* const* dest, std::size_t offset)
+				{
+					if (channels == 2)
+					{
+						for (std::size_t n = 0; n + 8 <= samples; n += 8)
+							deinterleave2x8(source + n * 2, dest[0] + offset + n, dest[1] + offset + n);
+
+						return;
+					}
+
+					float* shifted[8];
+
+					for (std::size_t c = 0; c + 8 <= channels; c += 8)
+					{
+						for (std::size_t k = 0; k < 8; ++k)
+							shifted[k] = dest[c + k] + offset;
+
+						for (std::size_t n = 0; n + 8 <= samples; n += 8)
+							deinterleave8(source + n * channels + c, channels, shifted, n);
+					}
+				}
+
+				static CPL_VECTOR_TARGET void interleaveAVX(const float* const* source, std::size_t channels, std::size_t samples, float* dest)
+				{
+					if (channels == 2)
+					{
+						for (std::size_t n = 0; n + 8 <= samples; n += 8)
+							interleave2x8(source[0] + n, source[1] + n, dest + n * 2);
+
+						return;
+					}
+
+					for (std::size_t c = 0; c + 8 <= channels; c += 8)
+					{
+						for (std::size_t n = 0; n + 8 <= samples; n += 8)
+							interleave8(source + c, n, dest + n * channels + c, channels);
+					}
+				}
+#endif
+			};
+
+			inline bool interleave_has_avx() noexcept
+			{
+#ifdef CPL_COMPILER_SUPPORTS_AVX
+				return system::CProcessor::test(system::CProcessor::AVX);
+#else
+				return false;
+#endif
+			}
+
+			/// <summary>
+			/// Channels that are transposed in tiles: 2 channels, or the leading multiple of 4 (8 for AVX).
+			/// </summary>
+			inline std::size_t interleave_tiled_channels(std::size_t channels, std::size_t tile) noexcept
+			{
+				return channels == 2 ? 2 : channels & ~(tile - 1);
+			}
+		}
+
+		/// <summary>
+		/// Splits numSamples interleaved frames of numChannels from source into separate channels,
+		/// written at destinations[c] + offset.
+		/// </summary>
+		template<typename T>
+		void deinterleave(const T* source, std::size_t numChannels, std::size_t numSamples, T* const* destinations, std::size_t offset = 0)
+		{
+			if (numChannels == 1)
+			{
+				std::memcpy(destinations[0] + offset, source, numSamples * sizeof(T));
+				return;
+			}
+
+			// channels [0, tiledChannels) are done for samples [0, tiledSamples)
+			std::size_t tiledChannels = 0, tiledSamples = 0;
+
+			if constexpr (std::is_same<T, float>::value)
+			{
+				using detail::interleave_kernels;
+
+				// samples [0, avxSamples) are done for channels [0, avxChannels)
+				std::size_t avxChannels = 0, avxSamples = 0;
+
+#ifdef CPL_COMPILER_SUPPORTS_AVX
+				if (detail::interleave_has_avx())
+				{
+					avxChannels = detail::interleave_tiled_channels(numChannels, 8);
+					avxSamples = numSamples & ~std::size_t(7);
+					interleave_kernels::deinterleaveAVX(source, numChannels, numSamples, destinations, offset);
+				}
+#endif
+				tiledChannels = detail::interleave_tiled_channels(numChannels, 4);
+				tiledSamples = numSamples & ~std::size_t(3);
+
+				if (numChannels == 2)
+				{
+					for (std::size_t n = avxChannels ? avxSamples : 0; n < tiledSamples; n += 4)
+						interleave_kernels::deinterleave2(source + n * 2, destinations[0] + offset + n, destinations[1] + offset + n);
+				}
+				else
+				{
+					float* shifted[4];
+
+					for (std::size_t t = 0; t < tiledChannels; t += 4)
+					{
+						for (std::size_t k = 0; k < 4; ++k)
+							shifted[k] = destinations[t + k] + offset;
+
+						for (std::size_t n = t < avxChannels ? avxSamples : 0; n < tiledSamples; n += 4)
+							interleave_kernels::deinterleave4(source + n * numChannels + t, numChannels, shifted, n);
+					}
+				}
+			}
+
+			for (std::size_t c = 0; c < numChannels; ++c)
+			{
+				T* destination = destinations[c] + offset;
+
+				for (std::size_t n = c < tiledChannels ? tiledSamples : 0; n < numSamples; ++n)
+					destination[n] = source[n * numChannels + c];
+			}
+		}
+
+		/// <summary>
+		/// Merges numSamples of numChannels separate channels into interleaved frames at destination.
+		/// </summary>
+		template<typename T>
+		void interleave(const T* const* sources, std::size_t numChannels, std::size_t numSamples, T* destination)
+		{
+			if (numChannels == 1)
+			{
+				std::memcpy(destination, sources[0], numSamples * sizeof(T));
+				return;
+			}
+
+			std::size_t tiledChannels = 0, tiledSamples = 0;
+
+			if constexpr (std::is_same<T, float>::value)
+			{
+				using detail::interleave_kernels;
+
+				std::size_t avxChannels = 0, avxSamples = 0;
+
+#ifdef CPL_COMPILER_SUPPORTS_AVX
+				if (detail::interleave_has_avx())
+				{
+					avxChannels = detail::interleave_tiled_channels(numChannels, 8);
+					avxSamples = numSamples & ~std::size_t(7);
+					interleave_kernels::interleaveAVX(sources, numChannels, numSamples, destination);
+				}
+#endif
+				tiledChannels = detail::interleave_tiled_channels(numChannels, 4);
+				tiledSamples = numSamples & ~std::size_t(3);
+
+				if (numChannels == 2)
+				{
+					for (std::size_t n = avxChannels ? avxSamples : 0; n < tiledSamples; n += 4)
+						interleave_kernels::interleave2(sources[0] + n, sources[1] + n, destination + n * 2);
+				}
+				else
+				{
+					for (std::size_t t = 0; t < tiledChannels; t += 4)
+					{
+						for (std::size_t n = t < avxChannels ? avxSamples : 0; n < tiledSamples; n += 4)
+							interleave_kernels::interleave4(sources + t, n, destination + n * numChannels + t, numChannels);
+					}
+				}
+			}
+
+			for (std::size_t c = 0; c < numChannels; ++c)
+			{
+				const T* source = sources[c];
+
+				for (std::size_t n = c < tiledChannels ? tiledSamples : 0; n < numSamples; ++n)
+					destination[n * numChannels + c] = source[n];
+			}
+		}
+	};
+};
+
+#endif
@@ -47,32 +47,53 @@ namespace cpl
 			struct isa_fma_impl<T, typename std::enable_if<!is_simd<T>::value>::type >
 			{
 				static inline T fma(T a, T b, T c) noexcept { return a * b + c; }
+				static inline T fnma(T a, T b, T c) noexcept { return c - a * b; }
 			};
 
 			template<>
 			struct isa_fma_impl<Types::v4sf>
 			{
-				static inline Types::v4sf fma(Types::v4sf a, Types::v4sf b, Types::v4sf c) noexcept { return _mm_fmadd_ps(a, b, c); }
+				CPL_FMA_TARGET static inline Types::v4sf fma(Types::v4sf a, Types::v4sf b, Types::v4sf c) noexcept { return _mm_fmadd_ps(a, b, c); }
+				CPL_FMA_TARGET static inline Types::v4sf fnma(Types::v4sf a, Types::v4sf b, Types::v4sf c) noexcept { return _mm_fnmadd_ps(a, b, c); }
 			};
 
 			template<>
 			struct isa_fma_impl<Types::v8sf>
 			{
-				static inline Types::v8sf fma(Types::v8sf a, Types::v8sf b, Types::v8sf c) noexcept { return _mm256_fmadd_ps(a, b, c); }
+				CPL_FMA_TARGET static inline Types::v8sf fma(Types::v8sf a, Types::v8sf b, Types::v8sf c) noexcept { return _mm256_fmadd_ps(a, b, c); }
+				CPL_FMA_TARGET static inline Types::v8sf fnma(Types::v8sf a, Types::v8sf b, Types::v8sf c) noexcept { return _mm256_fnmadd_ps(a, b, c); }
 			};
 
 			template<>
 			struct isa_fma_impl<Types::v2sd>
 			{
-				static inline Types::v2sd fma(Types::v2sd a, Types::v2sd b, Types::v2sd c) noexcept { return _mm_fmadd_pd(a, b, c); }
+				CPL_FMA_TARGET static inline Types::v2sd fma(Types::v2sd a, Types::v2sd b, Types::v2sd c) noexcept { return _mm_fmadd_pd(a, b, c); }
+				CPL_FMA_TARGET static inline Types::v2sd fnma(Types::v2sd a, Types::v2sd b, Types::v2sd c) noexcept { return _mm_fnmadd_pd(a, b, c); }
 			};
 
 			template<>
 			struct isa_fma_impl<Types::v4sd>
 			{
-				static inline Types::v4sd fma(Types::v4sd a, Types::v4sd b, Types::v4sd c) noexcept { return _mm256_fmadd_pd(a, b, c); }
+				CPL_FMA_TARGET static inline Types::v4sd fma(Types::v4sd a, Types::v4sd b, Types::v4sd c) noexcept { return _mm256_fmadd_pd(a, b, c); }
+				CPL_FMA_TARGET static inline Types::v4sd fnma(Types::v4sd a, Types::v4sd b, Types::v4sd c) noexcept { return _mm256_fnmadd_pd(a, b, c); }
 			};
 
+			#ifdef CPL_COMPILER_SUPPORTS_AVX512
+			template<>
+			struct isa_fma_impl<Types::v16sf>
+			{
+				CPL_AVX512_TARGET static inline Types::v16sf fma(Types::v16sf a, Types::v16sf b, Types::v16sf c) noexcept { return _mm512_fmadd_ps(a, b, c); }
+				CPL_AVX512_TARGET static inline Types::v16sf fnma(Types::v16sf a, Types::v16sf b, Types::v16sf c) noexcept { return _mm512_fnmadd_ps(a, b, c); }
+			};
+
+			template<>
+			struct isa_fma_impl<Types::v8sd>
+			{
+				CPL_AVX512_TARGET static inline Types::v8sd fma(Types::v8sd a, Types::v8sd b, Types::v8sd c) noexcept { return _mm512_fmadd_pd(a, b, c); }
+				CPL_AVX512_TARGET static inline Types::v8sd fnma(Types::v8sd a, Types::v8sd b, Types::v8sd c) noexcept { return _mm512_fnmadd_pd(a, b, c); }
+			};
+			#endif
+
 		};
 
 		template<typename T>
@@ -97,12 +118,21 @@ namespace cpl
 			{
 				return a * b + c;
 			}
+
+			/// <summary>
+			/// c - a * b
+			/// </summary>
+			inline static V fnma(V a, V b, V c) noexcept
+			{
+				return c - a * b;
+			}
 		};
 
 		template<typename V>
-		struct isa_fma<V, true> : public isa_fma_base<false>, detail::isa_fma_impl<V>
+		struct isa_fma<V, true> : public isa_fma_base<true>, detail::isa_fma_impl<V>
 		{
 			using detail::isa_fma_impl<V>::fma;
+			using detail::isa_fma_impl<V>::fnma;
 		};
 
 		template<typename Type, bool has_fma>
@@ -113,6 +143,22 @@ namespace cpl
 
 		namespace detail
 		{
+			/// <summary>
+			/// Compiles the dispatched code path for FMA, regardless of the flags the rest is compiled with.
+			/// </summary>
+			template<class ClassDispatcher, class ISA, typename... Args>
+			CPL_FMA_TARGET CPL_FLATTEN auto dispatch_fma(Args&&... args)
+			{
+				return ClassDispatcher::template dispatch<ISA>(std::forward<Args>(args)...);
+			}
+
+			#ifdef CPL_COMPILER_SUPPORTS_AVX512
+			template<class ClassDispatcher, class ISA, typename... Args>
+			CPL_AVX512_TARGET CPL_FLATTEN auto dispatch_avx512(Args&&... args)
+			{
+				return ClassDispatcher::template dispatch<ISA>(std::forward<Args>(args)...);
+			}
+			#endif
 
 			template<typename Scalar, class ClassDispatcher, typename... Args>
 			auto dynamic_isa_dispatch_impl(typename std::enable_if<std::is_same<Scalar, float>::value, float>::type *, Args&&... args)
@@ -123,12 +169,15 @@ namespace cpl
 					{
 						case 32:
 						case 16:
+							#ifdef CPL_COMPILER_SUPPORTS_AVX512
+							return dispatch_avx512<ClassDispatcher, isa_traits<Types::v16sf, true>>(std::forward<Args>(args)...);
+							#endif
 						case 8:
 							#ifdef CPL_COMPILER_SUPPORTS_AVX
-							return ClassDispatcher::template dispatch<isa_traits<Types::v8sf, true>>(std::forward<Args>(args)...);
+							return dispatch_fma<ClassDispatcher, isa_traits<Types::v8sf, true>>(std::forward<Args>(args)...);
 							#endif
 						case 4:
-							return ClassDispatcher::template dispatch<isa_traits<Types::v4sf, true>>(std::forward<Args>(args)...);
+							return dispatch_fma<ClassDispatcher, isa_traits<Types::v4sf, true>>(std::forward<Args>(args)...);
 							break;
 						default:
 							return ClassDispatcher::template dispatch<isa_traits<float, true>>(std::forward<Args>(args)...);
@@ -167,13 +216,16 @@ namespace cpl
 						case 32:
 						case 16:
 						case 8:
+							#ifdef CPL_COMPILER_SUPPORTS_AVX512
+							return dispatch_avx512<ClassDispatcher, isa_traits<Types::v8sd, true>>(std::forward<Args>(args)...);
+							#endif
 						case 4:
 							#ifdef CPL_COMPILER_SUPPORTS_AVX
-							return ClassDispatcher::template dispatch<isa_traits<Types::v4sd, true>>(std::forward<Args>(args)...);
+							return dispatch_fma<ClassDispatcher, isa_traits<Types::v4sd, true>>(std::forward<Args>(args)...);
 							break;
 							#endif
 						case 2:
-							return ClassDispatcher::template dispatch<isa_traits<Types::v2sd, true>>(std::forward<Args>(args)...);
+							return dispatch_fma<ClassDispatcher, isa_traits<Types::v2sd, true>>(std::forward<Args>(args)...);
 							break;
 						default:
 							return ClassDispatcher::template dispatch<isa_traits<double, true>>(std::forward<Args>(args)...);
@@ -188,6 +240,7 @@ namespace cpl
 						case 32:
 						case 16:
 						case 8:
+						case 4:
 							#ifdef CPL_COMPILER_SUPPORTS_AVX
 							return ClassDispatcher::template dispatch<isa_traits<Types::v4sd, false>>(std::forward<Args>(args)...);
 							break;
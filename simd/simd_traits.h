@@ -60,6 +60,14 @@ namespace cpl
 		template<>
 		struct is_simd<v256si> : public std::true_type {};
 
+		#ifdef CPL_COMPILER_SUPPORTS_AVX512
+		template<>
+		struct is_simd<v16sf> : public std::true_type {};
+
+		template<>
+		struct is_simd<v8sd> : public std::true_type {};
+		#endif
+
 #else
 	
 	template<class T>
@@ -136,6 +144,20 @@ namespace cpl
 			typedef float type;
 		};
 
+		#ifdef CPL_COMPILER_SUPPORTS_AVX512
+		template<>
+		struct vector_of<float, 16>
+		{
+			typedef v16sf type;
+		};
+
+		template<>
+		struct vector_of<double, 8>
+		{
+			typedef v8sd type;
+		};
+		#endif
+
 		template<>
 		struct vector_of<double, 2>
 		{
@@ -190,6 +212,14 @@ namespace cpl
 		template<>
 		struct scalar_of<v2sd> { typedef double type; };
 
+		#ifdef CPL_COMPILER_SUPPORTS_AVX512
+		template<>
+		struct scalar_of<v16sf> { typedef float type; };
+
+		template<>
+		struct scalar_of<v8sd> { typedef double type; };
+		#endif
+
 		template<>
 		struct scalar_of<float> { typedef float type; };
 
@@ -282,6 +312,22 @@ namespace cpl
 		AddOperatorForArchs(mul, *);
 		AddOperatorForArchs(div, / );
 		AddOperatorForArchs(sub, -);
+
+		#ifdef CPL_COMPILER_SUPPORTS_AVX512
+		// bitwise operations on these need AVX512DQ, so only arithmetic is provided
+		#define AddOperatorFor512(name, op) \
+					AddSimdOperatorps(name, op, __m512, _mm512); \
+					AddSimdCOperatorps(name, op, __m512, _mm512); \
+					AddSimdOperatorpd(name, op, __m512d, _mm512); \
+					AddSimdCOperatorpd(name, op, __m512d, _mm512);
+
+		AddOperatorFor512(add, +);
+		AddOperatorFor512(mul, *);
+		AddOperatorFor512(div, / );
+		AddOperatorFor512(sub, -);
+
+		#undef AddOperatorFor512
+		#endif
 		AddOperatorForArchs(or , | );
 		AddOperatorForArchs(and, &);
 		AddOperatorForArchs(xor, ^);
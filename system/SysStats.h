@@ -62,7 +62,15 @@ namespace cpl
 				SSE4 = 1 << 4,
 				AVX = 1 << 5,
 				AVX2 = 1 << 6,
-				FMA = 1 << 7
+				FMA = 1 << 7,
+				/// <summary>
+				/// Only set if the OS also preserves the 512-bit registers.
+				/// </summary>
+				AVX512F = 1 << 8,
+				/// <summary>
+				/// Half precision conversions (requires AVX).
+				/// </summary>
+				F16C = 1 << 9
 			};
 
 			/*
@@ -150,6 +158,10 @@ namespace cpl
 					narchs |= Archs::SSE4;
 				if (msdn::InstructionSet::MMX())
 					narchs |= Archs::MMX;
+				if (msdn::InstructionSet::AVX512F() && msdn::InstructionSet::OSXSAVE() && osSavesAVX512State())
+					narchs |= Archs::AVX512F;
+				if (msdn::InstructionSet::F16C() && msdn::InstructionSet::AVX())
+					narchs |= Archs::F16C;
 
 
 				#ifdef CPL_WINDOWS
@@ -197,6 +209,19 @@ namespace cpl
 				#endif
 			}
 
+			static bool osSavesAVX512State()
+			{
+				// XCR0 needs SSE, AVX, opmask and both halves of the upper ZMM state enabled
+				const std::uint64_t required = 0xE6;
+				#ifdef CPL_MSVC
+				return (_xgetbv(0) & required) == required;
+				#else
+				std::uint32_t low, high;
+				__asm__ volatile ("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+				return (low & required) == required;
+				#endif
+			}
+
 			std::size_t narchs;
 			double frequency;
 